@@ -0,0 +1,617 @@
+/// Benchmarks of RedBlackTree against std::map, std::unordered_map, BTreeMap, CompactRedBlackTree,
+/// TopDownRedBlackTree and FrozenMap.
+/// Every combination of container, key type, key pattern and size is filled from empty and
+/// measured for insert, find, find-many, iterate, range-scan and remove. FrozenMap is immutable,
+/// so it is measured for build by RedBlackTree::freeze() and the read operations. Reported per operation are
+/// time, allocations and, where perf_event is available, cache misses; bytes per entry
+/// are live heap bytes after the fill divided by the size.
+///
+/// Usage: RBTreeBenchmarks [--sizes=1000,10000,...] [--patterns=sequential,random,zipfian,clustered]
+///        [--keys=int,string] [--containers=RedBlackTree,std::map,std::unordered_map,BTreeMap,
+///        CompactRedBlackTree,TopDownRedBlackTree,FrozenMap]
+///        [--seed=N] [--csv]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "../RedBlackTree/BTreeMap.h"
+#include "../RedBlackTree/CompactRedBlackTree.h"
+#include "../RedBlackTree/RedBlackTree.h"
+#include "../RedBlackTree/TopDownRedBlackTree.h"
+
+//ALLOCATION COUNTING
+/// Every allocation of the process is counted; the block is prefixed by its size so frees
+/// can be subtracted from live bytes.
+namespace
+{
+	const size_t AllocationHeader = 16;
+	size_t gAllocations = 0;
+	size_t gLiveBytes = 0;
+
+	void* countedAllocate(size_t aSize)
+	{
+		char* block = static_cast<char*>(std::malloc(aSize + AllocationHeader));
+		if (block == NULL)
+			throw std::bad_alloc();
+		*reinterpret_cast<size_t*>(block) = aSize;
+		gAllocations++;
+		gLiveBytes += aSize;
+		return block + AllocationHeader;
+	}
+
+	void countedFree(void* aPointer)
+	{
+		if (aPointer == NULL)
+			return;
+		char* block = static_cast<char*>(aPointer) - AllocationHeader;
+		gLiveBytes -= *reinterpret_cast<size_t*>(block);
+		std::free(block);
+	}
+}
+
+void* operator new(size_t aSize) { return countedAllocate(aSize); }
+void* operator new[](size_t aSize) { return countedAllocate(aSize); }
+void operator delete(void* aPointer) noexcept { countedFree(aPointer); }
+void operator delete[](void* aPointer) noexcept { countedFree(aPointer); }
+void operator delete(void* aPointer, size_t) noexcept { countedFree(aPointer); }
+void operator delete[](void* aPointer, size_t) noexcept { countedFree(aPointer); }
+
+//CACHE MISS COUNTER
+/// Hardware cache miss counter of the calling thread, unavailable outside Linux or when perf_event is not permitted.
+class CacheMissCounter
+{
+public:
+	CacheMissCounter() : mFile(-1)
+	{
+#ifdef __linux__
+		perf_event_attr attributes;
+		std::memset(&attributes, 0, sizeof(attributes));
+		attributes.type = PERF_TYPE_HARDWARE;
+		attributes.size = sizeof(attributes);
+		attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		mFile = int(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+	}
+	~CacheMissCounter()
+	{
+#ifdef __linux__
+		if (mFile >= 0)
+			close(mFile);
+#endif
+	}
+	bool isAvailable() const { return mFile >= 0; }
+	void start()
+	{
+#ifdef __linux__
+		if (mFile < 0)
+			return;
+		ioctl(mFile, PERF_EVENT_IOC_RESET, 0);
+		ioctl(mFile, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+	}
+	uint64_t stop()
+	{
+		uint64_t count = 0;
+#ifdef __linux__
+		if (mFile < 0)
+			return 0;
+		ioctl(mFile, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(mFile, &count, sizeof(count)) != ssize_t(sizeof(count)))
+			count = 0;
+#endif
+		return count;
+	}
+private:
+	int mFile;
+
+	CacheMissCounter(const CacheMissCounter&);
+	void operator = (const CacheMissCounter&);
+};
+
+//MEASUREMENT
+struct Result
+{
+	std::string Container;
+	std::string Key;
+	std::string Pattern;
+	size_t Size;
+	std::string Operation;
+	double NsPerOp;
+	double AllocationsPerOp;
+	double CacheMissesPerOp;
+	double BytesPerEntry;
+};
+
+class Measurement
+{
+public:
+	explicit Measurement(CacheMissCounter& aCounter) : mCounter(aCounter), mAllocations(0) {}
+	void start()
+	{
+		mAllocations = gAllocations;
+		mCounter.start();
+		mStart = std::chrono::steady_clock::now();
+	}
+	void stop(Result& aResult, size_t aOperations)
+	{
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		uint64_t cacheMisses = mCounter.stop();
+		double operations = double(std::max<size_t>(aOperations, 1));
+		aResult.NsPerOp = std::chrono::duration<double, std::nano>(end - mStart).count() / operations;
+		aResult.AllocationsPerOp = double(gAllocations - mAllocations) / operations;
+		aResult.CacheMissesPerOp = mCounter.isAvailable() ? double(cacheMisses) / operations : -1;
+	}
+private:
+	CacheMissCounter& mCounter;
+	size_t mAllocations;
+	std::chrono::steady_clock::time_point mStart;
+};
+
+//KEY PATTERNS
+/// Zipfian ranks with exponent 0.99 as generated by YCSB, rank 0 is the most frequent.
+class ZipfianGenerator
+{
+public:
+	ZipfianGenerator(size_t aCount, double aTheta = 0.99) : mCount(aCount), mTheta(aTheta), mZetaN(0)
+	{
+		for (size_t i = 1; i <= aCount; i++)
+			mZetaN += 1 / std::pow(double(i), aTheta);
+		double zeta2 = 1 + 1 / std::pow(2.0, aTheta);
+		mAlpha = 1 / (1 - aTheta);
+		mEta = (1 - std::pow(2.0 / double(aCount), 1 - aTheta)) / (1 - zeta2 / mZetaN);
+	}
+	template<typename RANDOM>
+	size_t next(RANDOM& aRandom)
+	{
+		double u = std::uniform_real_distribution<double>(0, 1)(aRandom);
+		double uz = u * mZetaN;
+		if (uz < 1)
+			return 0;
+		if (uz < 1 + std::pow(0.5, mTheta))
+			return std::min<size_t>(1, mCount - 1);
+		return std::min(size_t(double(mCount) * std::pow(mEta * u - mEta + 1, mAlpha)), mCount - 1);
+	}
+private:
+	size_t mCount;
+	double mTheta;
+	double mZetaN;
+	double mAlpha;
+	double mEta;
+};
+
+/// Order of inserted key indexes and sequence of looked up key indexes of one pattern.
+/// sequential - ascending, random - uniform permutation, clustered - runs of 256 ascending
+/// indexes in random order, zipfian - random insert order and skewed lookups of hot keys.
+struct Workload
+{
+	std::vector<size_t> InsertOrder;
+	std::vector<size_t> Lookups;
+	std::vector<size_t> RemoveOrder;
+};
+
+Workload makeWorkload(const std::string& aPattern, size_t aSize, size_t aLookups, std::mt19937_64& aRandom)
+{
+	Workload workload;
+	workload.InsertOrder.resize(aSize);
+	for (size_t i = 0; i < aSize; i++)
+		workload.InsertOrder[i] = i;
+	if (aPattern == "random" || aPattern == "zipfian")
+		std::shuffle(workload.InsertOrder.begin(), workload.InsertOrder.end(), aRandom);
+	else if (aPattern == "clustered")
+	{
+		const size_t clusterSize = 256;
+		std::vector<size_t> clusters;
+		for (size_t i = 0; i < aSize; i += clusterSize)
+			clusters.push_back(i);
+		std::shuffle(clusters.begin(), clusters.end(), aRandom);
+		workload.InsertOrder.clear();
+		for (size_t cluster : clusters)
+		{
+			for (size_t i = cluster; i < std::min(cluster + clusterSize, aSize); i++)
+				workload.InsertOrder.push_back(i);
+		}
+	}
+	workload.Lookups.resize(aLookups);
+	if (aPattern == "zipfian")
+	{
+		//hot ranks are spread over the key space by the random insert order
+		ZipfianGenerator zipfian(aSize);
+		for (size_t i = 0; i < aLookups; i++)
+			workload.Lookups[i] = workload.InsertOrder[zipfian.next(aRandom)];
+	}
+	else
+	{
+		for (size_t i = 0; i < aLookups; i++)
+			workload.Lookups[i] = workload.InsertOrder[i % aSize];
+	}
+	workload.RemoveOrder = workload.InsertOrder;
+	return workload;
+}
+
+//KEY TYPES
+/// key of index, keys ascend with indexes; strings are longer than the small string buffer
+template<typename KEY>
+KEY makeKey(size_t aIndex);
+
+template<>
+int64_t makeKey<int64_t>(size_t aIndex) { return int64_t(aIndex) * 2; }
+
+template<>
+std::string makeKey<std::string>(size_t aIndex)
+{
+	char buffer[48];
+	std::snprintf(buffer, sizeof(buffer), "benchmark_key_%012zu", aIndex * 2);
+	return buffer;
+}
+
+template<typename KEY>
+const char* keyName();
+template<>
+const char* keyName<int64_t>() { return "int"; }
+template<>
+const char* keyName<std::string>() { return "string"; }
+
+//CONTAINER OPERATIONS
+typedef uint64_t Value;
+
+template<typename KEY>
+void insertItem(RedBlackTree<KEY, Value>& aContainer, const KEY& aKey, Value aValue) { aContainer.insert(aKey, aValue); }
+template<typename KEY>
+void insertItem(BTreeMap<KEY, Value>& aContainer, const KEY& aKey, Value aValue) { aContainer.insert(aKey, aValue); }
+template<typename KEY>
+void insertItem(CompactRedBlackTree<KEY, Value>& aContainer, const KEY& aKey, Value aValue) { aContainer.insert(aKey, aValue); }
+template<typename KEY>
+void insertItem(TopDownRedBlackTree<KEY, Value>& aContainer, const KEY& aKey, Value aValue) { aContainer.insert(aKey, aValue); }
+template<typename MAP>
+void insertItem(MAP& aContainer, const typename MAP::key_type& aKey, Value aValue) { aContainer.emplace(aKey, aValue); }
+
+template<typename KEY>
+void removeItem(RedBlackTree<KEY, Value>& aContainer, const KEY& aKey) { aContainer.remove(aKey); }
+template<typename KEY>
+void removeItem(BTreeMap<KEY, Value>& aContainer, const KEY& aKey) { aContainer.remove(aKey); }
+template<typename KEY>
+void removeItem(CompactRedBlackTree<KEY, Value>& aContainer, const KEY& aKey) { aContainer.remove(aKey); }
+template<typename KEY>
+void removeItem(TopDownRedBlackTree<KEY, Value>& aContainer, const KEY& aKey) { aContainer.remove(aKey); }
+template<typename MAP>
+void removeItem(MAP& aContainer, const typename MAP::key_type& aKey) { aContainer.erase(aKey); }
+
+/// sum of values of given count of items from the first key not less than given one
+template<typename MAP>
+bool scanRange(const MAP& aContainer, const typename MAP::key_type& aKey, size_t aCount, Value& aSum)
+{
+	typename MAP::const_iterator it = aContainer.lower_bound(aKey);
+	for (size_t i = 0; i < aCount && it != aContainer.end(); i++, ++it)
+		aSum += it->second;
+	return true;
+}
+
+template<typename KEY>
+bool scanRange(const std::unordered_map<KEY, Value>& aContainer, const KEY& aKey, size_t aCount, Value& aSum)
+{
+	(void)aContainer;
+	(void)aKey;
+	(void)aCount;
+	(void)aSum;
+	return false;
+}
+
+/// keys of the lookup workload as a forward range, so a batch of lookups copies no keys
+template<typename KEY>
+class LookupKeyIterator : public std::iterator<std::forward_iterator_tag, KEY, std::ptrdiff_t, const KEY*, const KEY&>
+{
+public:
+	LookupKeyIterator() : mKeys(NULL), mIndex(NULL) {}
+	LookupKeyIterator(const std::vector<KEY>& aKeys, const size_t* aIndex) : mKeys(&aKeys), mIndex(aIndex) {}
+	const KEY& operator*() const { return (*mKeys)[*mIndex]; }
+	LookupKeyIterator& operator++() { ++mIndex; return *this; }
+	bool operator==(const LookupKeyIterator& aOther) const { return mIndex == aOther.mIndex; }
+	bool operator!=(const LookupKeyIterator& aOther) const { return mIndex != aOther.mIndex; }
+private:
+	const std::vector<KEY>* mKeys;
+	const size_t* mIndex;
+};
+
+/// sum of values of lookup keys found in batches by find_many, false for containers without it
+template<typename MAP, typename KEY>
+bool findMany(const MAP& aContainer, const std::vector<KEY>& aKeys, const std::vector<size_t>& aLookups, Value& aSum)
+{
+	(void)aContainer;
+	(void)aKeys;
+	(void)aLookups;
+	(void)aSum;
+	return false;
+}
+
+template<typename KEY>
+bool findMany(const RedBlackTree<KEY, Value>& aContainer, const std::vector<KEY>& aKeys, const std::vector<size_t>& aLookups, Value& aSum)
+{
+	const size_t batchSize = 1024;
+	std::vector<typename RedBlackTree<KEY, Value>::const_iterator> found(batchSize);
+	for (size_t start = 0; start < aLookups.size(); start += batchSize)
+	{
+		size_t count = std::min(batchSize, aLookups.size() - start);
+		const size_t* indices = aLookups.data() + start;
+		aContainer.find_many(LookupKeyIterator<KEY>(aKeys, indices), LookupKeyIterator<KEY>(aKeys, indices + count), found.begin());
+		for (size_t i = 0; i < count; i++)
+			if (found[i] != aContainer.end())
+				aSum += found[i]->second;
+	}
+	return true;
+}
+
+//BENCHMARK
+struct Options
+{
+	std::vector<size_t> Sizes;
+	std::vector<std::string> Patterns;
+	std::vector<std::string> Keys;
+	std::vector<std::string> Containers;
+	uint64_t Seed;
+	bool IsCsv;
+};
+
+/// sink which keeps results of measured loops from being optimized away
+volatile Value gSink;
+
+/// measures find, find-many, iterate and range-scan of a filled container
+template<typename MAP, typename KEY>
+void benchmarkReads(const MAP& aContainer, const std::vector<KEY>& aKeys, const Workload& aWorkload,
+	Measurement& aMeasurement, Result& aResult, Value& aSum, std::vector<Result>& aResults)
+{
+	aResult.Operation = "find";
+	aMeasurement.start();
+	for (size_t index : aWorkload.Lookups)
+	{
+		typename MAP::const_iterator found = aContainer.find(aKeys[index]);
+		if (found != aContainer.end())
+			aSum += found->second;
+	}
+	aMeasurement.stop(aResult, aWorkload.Lookups.size());
+	aResults.push_back(aResult);
+
+	aResult.Operation = "find-many";
+	aMeasurement.start();
+	bool isFound = findMany(aContainer, aKeys, aWorkload.Lookups, aSum);
+	aMeasurement.stop(aResult, aWorkload.Lookups.size());
+	if (isFound)
+		aResults.push_back(aResult);
+
+	aResult.Operation = "iterate";
+	aMeasurement.start();
+	for (typename MAP::const_iterator it = aContainer.begin(); it != aContainer.end(); ++it)
+		aSum += it->second;
+	aMeasurement.stop(aResult, aKeys.size());
+	aResults.push_back(aResult);
+
+	//scans start at lookup keys, so zipfian scans are skewed as well
+	const size_t scanLength = 100;
+	const size_t scans = std::max<size_t>(1, std::min(aWorkload.Lookups.size(), size_t(100000)));
+	aResult.Operation = "range-scan";
+	aMeasurement.start();
+	bool isScanned = true;
+	for (size_t i = 0; i < scans && isScanned; i++)
+		isScanned = scanRange(aContainer, aKeys[aWorkload.Lookups[i]], scanLength, aSum);
+	aMeasurement.stop(aResult, scans * scanLength);
+	if (isScanned)
+		aResults.push_back(aResult);
+}
+
+template<typename MAP, typename KEY>
+void benchmarkContainer(const std::string& aName, const std::vector<KEY>& aKeys, const Workload& aWorkload,
+	const std::string& aPattern, CacheMissCounter& aCounter, std::vector<Result>& aResults)
+{
+	const size_t size = aKeys.size();
+	Measurement measurement(aCounter);
+	Result result;
+	result.Container = aName;
+	result.Key = keyName<KEY>();
+	result.Pattern = aPattern;
+	result.Size = size;
+	result.BytesPerEntry = 0;
+	Value sum = 0;
+	size_t liveBytes = gLiveBytes;
+	{
+		MAP container;
+		result.Operation = "insert";
+		measurement.start();
+		for (size_t index : aWorkload.InsertOrder)
+			insertItem(container, aKeys[index], Value(index));
+		measurement.stop(result, size);
+		result.BytesPerEntry = double(gLiveBytes - liveBytes) / double(size);
+		aResults.push_back(result);
+		double bytesPerEntry = result.BytesPerEntry;
+
+		benchmarkReads(static_cast<const MAP&>(container), aKeys, aWorkload, measurement, result, sum, aResults);
+
+		result.Operation = "remove";
+		measurement.start();
+		for (size_t index : aWorkload.RemoveOrder)
+			removeItem(container, aKeys[index]);
+		measurement.stop(result, size);
+		result.BytesPerEntry = bytesPerEntry;
+		aResults.push_back(result);
+	}
+	gSink = sum;
+}
+
+/// FrozenMap is built from a RedBlackTree filled outside of the measurement, build bytes per entry
+/// are those of the frozen arrays
+template<typename KEY>
+void benchmarkFrozenMap(const std::vector<KEY>& aKeys, const Workload& aWorkload,
+	const std::string& aPattern, CacheMissCounter& aCounter, std::vector<Result>& aResults)
+{
+	const size_t size = aKeys.size();
+	Measurement measurement(aCounter);
+	Result result;
+	result.Container = "FrozenMap";
+	result.Key = keyName<KEY>();
+	result.Pattern = aPattern;
+	result.Size = size;
+	Value sum = 0;
+	{
+		RedBlackTree<KEY, Value> tree;
+		for (size_t index : aWorkload.InsertOrder)
+			tree.insert(aKeys[index], Value(index));
+		size_t liveBytes = gLiveBytes;
+		result.Operation = "build";
+		measurement.start();
+		typename RedBlackTree<KEY, Value>::frozen_map_type container = tree.freeze();
+		measurement.stop(result, size);
+		result.BytesPerEntry = double(gLiveBytes - liveBytes) / double(size);
+		aResults.push_back(result);
+
+		benchmarkReads(container, aKeys, aWorkload, measurement, result, sum, aResults);
+	}
+	gSink = sum;
+}
+
+bool isSelected(const std::vector<std::string>& aSelection, const std::string& aName)
+{
+	return std::find(aSelection.begin(), aSelection.end(), aName) != aSelection.end();
+}
+
+template<typename KEY>
+void benchmarkKey(const Options& aOptions, CacheMissCounter& aCounter, std::vector<Result>& aResults)
+{
+	std::mt19937_64 random(aOptions.Seed);
+	for (size_t size : aOptions.Sizes)
+	{
+		std::vector<KEY> keys;
+		keys.reserve(size);
+		for (size_t i = 0; i < size; i++)
+			keys.push_back(makeKey<KEY>(i));
+		//lookup count is bounded, so the largest sizes finish in reasonable time
+		size_t lookups = std::min(size, size_t(10000000));
+		for (const std::string& pattern : aOptions.Patterns)
+		{
+			Workload workload = makeWorkload(pattern, size, lookups, random);
+			if (isSelected(aOptions.Containers, "RedBlackTree"))
+				benchmarkContainer<RedBlackTree<KEY, Value> >("RedBlackTree", keys, workload, pattern, aCounter, aResults);
+			if (isSelected(aOptions.Containers, "std::map"))
+				benchmarkContainer<std::map<KEY, Value> >("std::map", keys, workload, pattern, aCounter, aResults);
+			if (isSelected(aOptions.Containers, "std::unordered_map"))
+				benchmarkContainer<std::unordered_map<KEY, Value> >("std::unordered_map", keys, workload, pattern, aCounter, aResults);
+			if (isSelected(aOptions.Containers, "BTreeMap"))
+				benchmarkContainer<BTreeMap<KEY, Value> >("BTreeMap", keys, workload, pattern, aCounter, aResults);
+			if (isSelected(aOptions.Containers, "CompactRedBlackTree"))
+				benchmarkContainer<CompactRedBlackTree<KEY, Value> >("CompactRedBlackTree", keys, workload, pattern, aCounter, aResults);
+			if (isSelected(aOptions.Containers, "TopDownRedBlackTree"))
+				benchmarkContainer<TopDownRedBlackTree<KEY, Value> >("TopDownRedBlackTree", keys, workload, pattern, aCounter, aResults);
+			if (isSelected(aOptions.Containers, "FrozenMap"))
+				benchmarkFrozenMap(keys, workload, pattern, aCounter, aResults);
+			std::fflush(stdout);
+		}
+	}
+}
+
+std::vector<std::string> splitList(const std::string& aList)
+{
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (start <= aList.size())
+	{
+		size_t end = aList.find(',', start);
+		if (end == std::string::npos)
+			end = aList.size();
+		if (end > start)
+			items.push_back(aList.substr(start, end - start));
+		start = end + 1;
+	}
+	return items;
+}
+
+bool parseOptions(int argc, char** argv, Options& aOptions)
+{
+	aOptions.Sizes = { 1000, 10000, 100000, 1000000 };
+	aOptions.Patterns = { "sequential", "random", "zipfian", "clustered" };
+	aOptions.Keys = { "int", "string" };
+	aOptions.Containers = { "RedBlackTree", "std::map", "std::unordered_map", "BTreeMap", "CompactRedBlackTree", "TopDownRedBlackTree", "FrozenMap" };
+	aOptions.Seed = 42;
+	aOptions.IsCsv = false;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument(argv[i]);
+		size_t separator = argument.find('=');
+		std::string name = argument.substr(0, separator);
+		std::string value = separator == std::string::npos ? std::string() : argument.substr(separator + 1);
+		if (name == "--sizes")
+		{
+			aOptions.Sizes.clear();
+			for (const std::string& size : splitList(value))
+				aOptions.Sizes.push_back(size_t(std::strtod(size.c_str(), NULL)));
+		}
+		else if (name == "--patterns")
+			aOptions.Patterns = splitList(value);
+		else if (name == "--keys")
+			aOptions.Keys = splitList(value);
+		else if (name == "--containers")
+			aOptions.Containers = splitList(value);
+		else if (name == "--seed")
+			aOptions.Seed = std::strtoull(value.c_str(), NULL, 10);
+		else if (name == "--csv")
+			aOptions.IsCsv = true;
+		else
+		{
+			std::fprintf(stderr, "Unknown option %s\n", argv[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+void printResults(const std::vector<Result>& aResults, bool aIsCsv)
+{
+	if (aIsCsv)
+		std::printf("container,key,pattern,size,operation,ns_per_op,allocations_per_op,bytes_per_entry,cache_misses_per_op\n");
+	else
+		std::printf("%-20s %-7s %-11s %10s %-11s %10s %10s %10s %12s\n",
+			"container", "key", "pattern", "size", "operation", "ns/op", "allocs/op", "bytes/item", "misses/op");
+	for (const Result& result : aResults)
+	{
+		char misses[32] = "n/a";
+		if (result.CacheMissesPerOp >= 0)
+			std::snprintf(misses, sizeof(misses), "%.2f", result.CacheMissesPerOp);
+		if (aIsCsv)
+			std::printf("%s,%s,%s,%zu,%s,%.2f,%.3f,%.1f,%s\n", result.Container.c_str(), result.Key.c_str(), result.Pattern.c_str(),
+				result.Size, result.Operation.c_str(), result.NsPerOp, result.AllocationsPerOp, result.BytesPerEntry, misses);
+		else
+			std::printf("%-20s %-7s %-11s %10zu %-11s %10.2f %10.3f %10.1f %12s\n", result.Container.c_str(), result.Key.c_str(), result.Pattern.c_str(),
+				result.Size, result.Operation.c_str(), result.NsPerOp, result.AllocationsPerOp, result.BytesPerEntry, misses);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+		return 1;
+	CacheMissCounter counter;
+	std::vector<Result> results;
+	if (isSelected(options.Keys, "int"))
+		benchmarkKey<int64_t>(options, counter, results);
+	if (isSelected(options.Keys, "string"))
+		benchmarkKey<std::string>(options, counter, results);
+	printResults(results, options.IsCsv);
+	return 0;
+}
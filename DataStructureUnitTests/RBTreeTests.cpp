@@ -1,6 +1,21 @@
 #include <gtest\gtest.h>
 #include <RedBlackTree\RedBlackTree.h>
+#include <RedBlackTree\BTreeMap.h>
+#include <RedBlackTree\CompactRedBlackTree.h>
+#include <RedBlackTree\ConcurrentRedBlackTree.h>
+#include <RedBlackTree\PersistentRedBlackTree.h>
+#include <RedBlackTree\SeqLockRedBlackTree.h>
+#include <RedBlackTree\TopDownRedBlackTree.h>
+#include <Headers\NodePool.h>
 #include <list>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #define DEFAULT_START_IDX 0
 #define DEFAULT_END_IDX 10
@@ -116,6 +131,57 @@ TEST(RED_BLACK_TREE, ReverseRangeIteratorTest)
 	ASSERT_EQ(rbTree.size(), counter);
 }
 
+TEST(RED_BLACK_TREE, BackwardIterationTest)
+{
+	IntStringRBTree rbTree;
+	fillIntStringRBTreeWithAscendingRange(rbTree, DEFAULT_START_IDX, DEFAULT_END_IDX);
+	IntStringRBTree::iterator it = rbTree.end();
+	for (int expectedKey = DEFAULT_END_IDX - 1; expectedKey >= DEFAULT_START_IDX; expectedKey--)
+		ASSERT_EQ(expectedKey, (--it)->first);
+	ASSERT_EQ(rbTree.begin(), it);
+	EXPECT_THROW(--it, std::out_of_range);
+	EXPECT_EQ(rbTree.begin(), it);
+	IntStringRBTree::iterator endIt = rbTree.end();
+	EXPECT_THROW(++endIt, std::out_of_range);
+	EXPECT_THROW(*endIt, std::runtime_error);
+}
+
+TEST(RED_BLACK_TREE, ConstIteratorTest)
+{
+	IntStringRBTree rbTree;
+	fillIntStringRBTreeWithAscendingRange(rbTree, DEFAULT_START_IDX, DEFAULT_END_IDX);
+	const IntStringRBTree& constTree = rbTree;
+	int expectedKey = DEFAULT_START_IDX;
+	for (IntStringRBTree::const_iterator it = constTree.begin(); it != constTree.end(); it++, expectedKey++)
+		ASSERT_EQ(expectedKey, it->first);
+	ASSERT_EQ(DEFAULT_END_IDX, expectedKey);
+	IntStringRBTree::const_iterator foundIt = constTree.find(3);
+	IntStringRBTree::iterator mutableIt = rbTree.find(3);
+	EXPECT_TRUE(foundIt == mutableIt);
+	EXPECT_TRUE(mutableIt == foundIt);
+	EXPECT_TRUE(constTree.find(-1) == rbTree.cend());
+}
+
+TEST(RED_BLACK_TREE, BeginAndEndFollowRemovedBoundsTest)
+{
+	IntStringRBTree rbTree;
+	fillIntStringRBTreeWithAscendingRange(rbTree, DEFAULT_START_IDX, DEFAULT_END_IDX);
+	for (int i = DEFAULT_START_IDX; i < DEFAULT_END_IDX / 2; i++)
+	{
+		rbTree.remove(i);
+		rbTree.remove(DEFAULT_END_IDX - 1 - i);
+		if (rbTree.isEmpty())
+			break;
+		ASSERT_EQ(i + 1, rbTree.begin()->first);
+		ASSERT_EQ(DEFAULT_END_IDX - 2 - i, (--rbTree.end())->first);
+	}
+	EXPECT_TRUE(rbTree.begin() == rbTree.end());
+	rbTree.insert(DEFAULT_END_IDX, "last");
+	rbTree.insert(DEFAULT_START_IDX - 1, "first");
+	EXPECT_EQ(DEFAULT_START_IDX - 1, rbTree.begin()->first);
+	EXPECT_EQ(DEFAULT_END_IDX, (--rbTree.end())->first);
+}
+
 TEST(RED_BLACK_TREE, RemoveSingletonTest)
 {
 	IntStringRBTree rbTree;
@@ -209,6 +275,28 @@ TEST(RED_BLACK_TREE, MultipleRemoveItemsTest)
 	EXPECT_EQ(0, rbTree.size());
 }
 
+TEST(RED_BLACK_TREE, RemoveDoesntMoveOtherItemsTest)
+{
+	IntStringRBTree rbTree;
+	fillIntStringRBTreeWithAscendingRange(rbTree, DEFAULT_START_IDX, DEFAULT_END_IDX);
+	std::map<int, const IntStringRBTree::value_type*> addresses;
+	for (IntStringRBTree::iterator it = rbTree.begin(); it != rbTree.end(); ++it)
+		addresses[it->first] = &*it;
+	int removedKeys[] = { 3, 7, 0, 5 };
+	for (int key : removedKeys)
+	{
+		ASSERT_EQ(1, rbTree.remove(key));
+		addresses.erase(key);
+		for (const auto& address : addresses)
+		{
+			IntStringRBTree::iterator foundIt = rbTree.find(address.first);
+			ASSERT_FALSE(foundIt == rbTree.end());
+			ASSERT_EQ(address.second, &*foundIt) << "Item with key " << address.first << " was moved.";
+		}
+	}
+	EXPECT_EQ(addresses.size(), rbTree.size());
+}
+
 TEST(RED_BLACK_TREE, NotFoundItemTest)
 {
 	IntStringRBTree rbTree;
@@ -248,4 +336,1561 @@ TEST(RED_BLACK_TREE, UseStdFunctionOnTreeTest)
 	ASSERT_FALSE(foundIt == endIt);
 	ASSERT_FALSE(stdFoundIt == endIt);
 	ASSERT_EQ(foundIt, stdFoundIt);
-}
\ No newline at end of file
+}
+
+typedef RedBlackTree<int, std::string, std::less<int>, PoolAllocator<IntStringRBTree::value_type> > IntStringPoolRBTree;
+
+TEST(RED_BLACK_TREE, PoolAllocatorRecyclesNodesTest)
+{
+	NodePool pool(16);
+	{
+		IntStringPoolRBTree rbTree(pool);
+		EXPECT_EQ(1, pool.usedBlocks());
+		for (int i = 0; i < 100; i++)
+			rbTree.insert(i, std::to_string(i));
+		EXPECT_EQ(101, pool.usedBlocks());
+		for (int i = 0; i < 100; i += 2)
+			rbTree.remove(i);
+		EXPECT_EQ(51, pool.usedBlocks());
+		for (int i = 0; i < 100; i += 2)
+			rbTree.insert(i, std::to_string(i));
+		EXPECT_EQ(101, pool.usedBlocks());
+		int expectedKey = 0;
+		for (IntStringPoolRBTree::iterator it = rbTree.begin(); it != rbTree.end(); ++it, ++expectedKey)
+		{
+			ASSERT_EQ(expectedKey, it->first);
+			ASSERT_EQ(std::to_string(expectedKey), it->second);
+		}
+		rbTree.clear();
+		EXPECT_TRUE(rbTree.isEmpty());
+		EXPECT_EQ(1, pool.usedBlocks());
+	}
+	EXPECT_EQ(0, pool.usedBlocks());
+	pool.release();
+}
+
+TEST(RED_BLACK_TREE, PoolAllocatorServesContiguousChunksTest)
+{
+	NodePool pool(64);
+	IntStringPoolRBTree rbTree(pool);
+	for (int i = 0; i < 32; i++)
+		rbTree.insert(i, std::to_string(i));
+	char* lowest = reinterpret_cast<char*>(&*rbTree.begin());
+	char* highest = lowest;
+	for (IntStringPoolRBTree::iterator it = rbTree.begin(); it != rbTree.end(); ++it)
+	{
+		char* address = reinterpret_cast<char*>(&*it);
+		lowest = std::min(lowest, address);
+		highest = std::max(highest, address);
+	}
+	EXPECT_LT(static_cast<size_t>(highest - lowest), 64 * pool.blockSize());
+}
+
+typedef RedBlackTree<int, std::string, std::less<int>, std::allocator<IntStringRBTree::value_type>, RefCountedOwnership> IntStringRefCountedRBTree;
+
+TEST(RED_BLACK_TREE, RefCountedIteratorKeepsRemovedItemTest)
+{
+	IntStringRefCountedRBTree rbTree;
+	for (int i = 0; i < DEFAULT_END_IDX; i++)
+		rbTree.insert(i, std::to_string(i));
+	IntStringRefCountedRBTree::iterator removedIt = rbTree.find(5);
+	ASSERT_EQ(1, rbTree.remove(5));
+	EXPECT_EQ(DEFAULT_END_IDX - 1, rbTree.size());
+	EXPECT_TRUE(rbTree.find(5) == rbTree.end());
+	EXPECT_EQ(5, removedIt->first);
+	EXPECT_EQ("5", removedIt->second);
+	rbTree.clear();
+	EXPECT_EQ(5, removedIt->first);
+}
+
+TEST(RED_BLACK_TREE, ExclusiveNodeIsSmallerThanRefCountedTest)
+{
+	NodePool exclusivePool, refCountedPool;
+	RedBlackTree<int, int, std::less<int>, PoolAllocator<std::pair<const int, int> >, ExclusiveOwnership> exclusiveTree(exclusivePool);
+	RedBlackTree<int, int, std::less<int>, PoolAllocator<std::pair<const int, int> >, RefCountedOwnership> refCountedTree(refCountedPool);
+	EXPECT_LT(exclusivePool.blockSize(), refCountedPool.blockSize());
+}
+
+template<typename TREE>
+void checkTreeCopyIsIndependent()
+{
+	TREE rbTree;
+	for (int i = 0; i < DEFAULT_END_IDX; i++)
+		rbTree.insert(i, std::to_string(i));
+	TREE copy(rbTree);
+	ASSERT_EQ(rbTree.size(), copy.size());
+	copy.remove(0);
+	copy.find(1)->second = "changed";
+	copy.insert(DEFAULT_END_IDX, "new");
+	EXPECT_EQ(DEFAULT_END_IDX, rbTree.size());
+	EXPECT_EQ("0", rbTree.find(0)->second);
+	EXPECT_EQ("1", rbTree.find(1)->second);
+	EXPECT_TRUE(rbTree.find(DEFAULT_END_IDX) == rbTree.end());
+	rbTree = copy;
+	EXPECT_EQ(copy.size(), rbTree.size());
+	EXPECT_EQ("changed", rbTree.find(1)->second);
+	EXPECT_TRUE(std::equal(rbTree.begin(), rbTree.end(), copy.begin()));
+}
+
+TEST(RED_BLACK_TREE, CopyTreeTest)
+{
+	checkTreeCopyIsIndependent<IntStringRBTree>();
+	checkTreeCopyIsIndependent<IntStringRefCountedRBTree>();
+}
+
+TEST(RED_BLACK_TREE, AssignSortedBuildsValidTreeTest)
+{
+	for (int count = 0; count < 130; count++)
+	{
+		std::vector<std::pair<int, std::string> > items;
+		for (int i = 0; i < count; i++)
+			items.push_back(std::make_pair(i * 2, std::to_string(i)));
+		IntStringRBTree rbTree;
+		rbTree.insert(-1, "replaced");
+		rbTree.assignSorted(items.begin(), items.end());
+		ASSERT_TRUE(rbTree.isValid()) << "Invalid tree for " << count << " items.";
+		ASSERT_EQ(static_cast<size_t>(count), rbTree.size());
+		ASSERT_TRUE(std::equal(items.begin(), items.end(), rbTree.begin(),
+			[](const std::pair<int, std::string>& item, const IntStringRBTree::value_type& value)
+				{ return item.first == value.first && item.second == value.second; }));
+		rbTree.insert(count * 2 + 1, "inserted");
+		rbTree.remove(0);
+		ASSERT_TRUE(rbTree.isValid());
+	}
+}
+
+TEST(RED_BLACK_TREE, AssignSortedRejectsUnsortedRangeTest)
+{
+	std::vector<std::pair<int, std::string> > items;
+	items.push_back(std::make_pair(1, "1"));
+	items.push_back(std::make_pair(1, "1"));
+	IntStringRBTree rbTree;
+	rbTree.insert(0, "kept");
+	EXPECT_THROW(rbTree.assignSorted(items.begin(), items.end()), std::invalid_argument);
+	EXPECT_EQ(1, rbTree.size());
+}
+
+TEST(RED_BLACK_TREE, RangeConstructorTest)
+{
+	std::list<std::pair<int, std::string> > sortedItems;
+	for (int i = 0; i < DEFAULT_END_IDX; i++)
+		sortedItems.push_back(std::make_pair(i, std::to_string(i)));
+	IntStringRBTree sortedTree(sortedItems.begin(), sortedItems.end());
+	EXPECT_TRUE(sortedTree.isValid());
+	EXPECT_EQ(sortedItems.size(), sortedTree.size());
+	std::vector<std::pair<int, std::string> > unsortedItems(sortedItems.rbegin(), sortedItems.rend());
+	unsortedItems.push_back(std::make_pair(0, "duplicate"));
+	IntStringRBTree unsortedTree(unsortedItems.begin(), unsortedItems.end());
+	EXPECT_TRUE(unsortedTree.isValid());
+	EXPECT_EQ(sortedItems.size(), unsortedTree.size());
+	EXPECT_EQ(DEFAULT_START_IDX, unsortedTree.begin()->first);
+}
+
+struct CountedValue
+{
+	static int Constructions;
+	int Value;
+	CountedValue(int value = 0) : Value(value) { Constructions++; }
+	CountedValue(const CountedValue& other) : Value(other.Value) { Constructions++; }
+};
+int CountedValue::Constructions = 0;
+
+TEST(RED_BLACK_TREE, TryEmplaceConstructsOnlyNewItemsTest)
+{
+	RedBlackTree<int, CountedValue> rbTree;
+	CountedValue::Constructions = 0;
+	std::pair<RedBlackTree<int, CountedValue>::iterator, bool> result = rbTree.try_emplace(1, 10);
+	EXPECT_TRUE(result.second);
+	EXPECT_EQ(10, result.first->second.Value);
+	EXPECT_EQ(1, CountedValue::Constructions);
+	result = rbTree.try_emplace(1, 20);
+	EXPECT_FALSE(result.second);
+	EXPECT_EQ(10, result.first->second.Value);
+	EXPECT_EQ(1, CountedValue::Constructions);
+	rbTree.insert(1, CountedValue(30));
+	EXPECT_EQ(2, CountedValue::Constructions);
+	EXPECT_EQ(10, rbTree.find(1)->second.Value);
+	EXPECT_EQ(1, rbTree.size());
+}
+
+TEST(RED_BLACK_TREE, EmplaceDuplicateKeyTest)
+{
+	IntStringRBTree rbTree;
+	EXPECT_TRUE(rbTree.emplace(1, "first").second);
+	std::pair<IntStringRBTree::iterator, bool> result = rbTree.emplace(1, "second");
+	EXPECT_FALSE(result.second);
+	EXPECT_EQ("first", result.first->second);
+	EXPECT_TRUE(rbTree.emplace(std::piecewise_construct, std::forward_as_tuple(2), std::forward_as_tuple(3, 'x')).second);
+	EXPECT_EQ("xxx", rbTree.find(2)->second);
+	EXPECT_EQ(2, rbTree.size());
+	EXPECT_TRUE(rbTree.isValid());
+}
+
+TEST(RED_BLACK_TREE, InsertOrAssignTest)
+{
+	IntStringRBTree rbTree;
+	EXPECT_TRUE(rbTree.insert_or_assign(1, "first").second);
+	std::pair<IntStringRBTree::iterator, bool> result = rbTree.insert_or_assign(1, "second");
+	EXPECT_FALSE(result.second);
+	EXPECT_EQ("second", result.first->second);
+	EXPECT_EQ(1, rbTree.size());
+}
+
+TEST(RED_BLACK_TREE, SubscriptOperatorTest)
+{
+	IntStringRBTree rbTree;
+	EXPECT_TRUE(rbTree[1].empty());
+	EXPECT_EQ(1, rbTree.size());
+	rbTree[1] = "assigned";
+	rbTree[2].append("appended");
+	EXPECT_EQ("assigned", rbTree.find(1)->second);
+	EXPECT_EQ("appended", rbTree[2]);
+	EXPECT_EQ(2, rbTree.size());
+}
+
+TEST(RED_BLACK_TREE, InsertMoveOnlyValueTest)
+{
+	RedBlackTree<int, std::unique_ptr<int> > rbTree;
+	rbTree.insert(1, std::unique_ptr<int>(new int(10)));
+	std::unique_ptr<int> value(new int(20));
+	rbTree.try_emplace(2, std::move(value));
+	EXPECT_FALSE(value);
+	EXPECT_EQ(10, *rbTree.find(1)->second);
+	EXPECT_EQ(20, *rbTree[2]);
+}
+
+TEST(RED_BLACK_TREE, CustomComparatorTest)
+{
+	RedBlackTree<int, std::string, std::greater<int> > rbTree;
+	for (int i = 0; i < DEFAULT_END_IDX; i++)
+		rbTree.insert(i, std::to_string(i));
+	EXPECT_TRUE(rbTree.isValid());
+	int expectedKey = DEFAULT_END_IDX - 1;
+	for (RedBlackTree<int, std::string, std::greater<int> >::iterator it = rbTree.begin(); it != rbTree.end(); ++it, --expectedKey)
+		ASSERT_EQ(expectedKey, it->first);
+	EXPECT_EQ("3", rbTree.find(3)->second);
+	EXPECT_EQ(1, rbTree.remove(3));
+	EXPECT_TRUE(rbTree.find(3) == rbTree.end());
+}
+
+TEST(RED_BLACK_TREE, TransparentLookupTest)
+{
+	RedBlackTree<std::string, int, std::less<> > rbTree;
+	rbTree.insert("alpha", 1);
+	rbTree.insert("beta", 2);
+	rbTree.insert("gamma", 3);
+	const char* key = "beta";
+	EXPECT_EQ(2, rbTree.find(key)->second);
+	EXPECT_TRUE(rbTree.find("delta") == rbTree.end());
+	EXPECT_EQ(1, rbTree.remove("alpha"));
+	EXPECT_EQ(0, rbTree.remove("alpha"));
+	EXPECT_EQ(2, rbTree.size());
+}
+
+struct CountingLess
+{
+	static size_t Comparisons;
+	bool operator()(int left, int right) const { Comparisons++; return left < right; }
+};
+size_t CountingLess::Comparisons = 0;
+
+TEST(RED_BLACK_TREE, SingleComparisonPerLevelTest)
+{
+	const int itemsCount = 1023;
+	RedBlackTree<int, int, CountingLess> rbTree;
+	for (int i = 0; i < itemsCount; i++)
+		rbTree.insert(i, i);
+	for (int i = 0; i < itemsCount; i++)
+	{
+		CountingLess::Comparisons = 0;
+		ASSERT_EQ(i, rbTree.find(i)->second);
+		//red-black tree height is at most 2 * log2(n + 1)
+		ASSERT_LE(CountingLess::Comparisons, static_cast<size_t>(2 * 10 + 1));
+	}
+}
+TEST(RED_BLACK_TREE, BoundsTest)
+{
+	IntStringRBTree rbTree;
+	for (int i = 0; i < 20; i += 2)
+		rbTree.insert(i, std::to_string(i));
+	EXPECT_EQ(4, rbTree.lower_bound(4)->first);
+	EXPECT_EQ(6, rbTree.lower_bound(5)->first);
+	EXPECT_EQ(6, rbTree.upper_bound(4)->first);
+	EXPECT_EQ(0, rbTree.lower_bound(-1)->first);
+	EXPECT_TRUE(rbTree.lower_bound(19) == rbTree.end());
+	EXPECT_TRUE(rbTree.upper_bound(18) == rbTree.end());
+	auto range = rbTree.equal_range(8);
+	EXPECT_EQ(8, range.first->first);
+	EXPECT_EQ(10, range.second->first);
+	const IntStringRBTree& constTree = rbTree;
+	auto missing = constTree.equal_range(9);
+	EXPECT_TRUE(missing.first == missing.second);
+	EXPECT_EQ(10, missing.first->first);
+}
+
+TEST(RED_BLACK_TREE, EraseRangeTest)
+{
+	IntStringRBTree rbTree;
+	for (int i = 0; i < 100; i++)
+		rbTree.insert(i, std::to_string(i));
+	auto outside = rbTree.find(70);
+	auto next = rbTree.erase(rbTree.lower_bound(20), rbTree.lower_bound(60));
+	EXPECT_EQ(60, next->first);
+	EXPECT_EQ(60, rbTree.size());
+	EXPECT_TRUE(rbTree.isValid());
+	EXPECT_EQ("70", outside->second);
+	EXPECT_TRUE(rbTree.find(20) == rbTree.end());
+	EXPECT_TRUE(rbTree.find(59) == rbTree.end());
+	EXPECT_EQ(60, rbTree.erase(rbTree.find(19))->first);
+	EXPECT_EQ(59, rbTree.size());
+	EXPECT_TRUE(rbTree.erase(rbTree.begin(), rbTree.end()) == rbTree.end());
+	EXPECT_TRUE(rbTree.isEmpty());
+	EXPECT_TRUE(rbTree.isValid());
+}
+
+TEST(RED_BLACK_TREE, ForEachInRangeTest)
+{
+	IntStringRBTree rbTree;
+	for (int i = 0; i < 50; i++)
+		rbTree.insert(i, std::to_string(i));
+	std::vector<int> visited;
+	EXPECT_TRUE(rbTree.forEachInRange(10, 15, [&visited](const IntStringRBTree::value_type& item) { visited.push_back(item.first); return true; }));
+	EXPECT_EQ(std::vector<int>({ 10, 11, 12, 13, 14 }), visited);
+	visited.clear();
+	EXPECT_FALSE(rbTree.forEachInRange(10, 40, [&visited](const IntStringRBTree::value_type& item) { visited.push_back(item.first); return visited.size() < 3; }));
+	EXPECT_EQ(std::vector<int>({ 10, 11, 12 }), visited);
+	rbTree.forEachInRange(0, 2, [](IntStringRBTree::value_type& item) { item.second = "changed"; return true; });
+	EXPECT_EQ("changed", rbTree.find(1)->second);
+	EXPECT_EQ("2", rbTree.find(2)->second);
+}
+
+typedef RedBlackTree<int, std::string, std::less<int>, std::allocator<IntStringRBTree::value_type>, ExclusiveOwnership, WithOrderStatistics> IntStringOrderedRBTree;
+
+TEST(RED_BLACK_TREE, SelectAndRankTest)
+{
+	IntStringOrderedRBTree rbTree;
+	std::map<int, std::string> expected;
+	for (int i = 0; i < 300; i++)
+	{
+		int key = (i * 37) % 211;
+		rbTree.insert(key, std::to_string(i));
+		expected.insert(std::make_pair(key, std::to_string(i)));
+		if (i % 3 == 0)
+		{
+			rbTree.remove(key / 2);
+			expected.erase(key / 2);
+		}
+	}
+	ASSERT_TRUE(rbTree.isValid());
+	ASSERT_EQ(expected.size(), rbTree.size());
+	size_t position = 0;
+	for (auto item : expected)
+	{
+		EXPECT_EQ(item.first, rbTree.select(position)->first);
+		EXPECT_EQ(position, rbTree.rank(item.first));
+		position++;
+	}
+	EXPECT_TRUE(rbTree.select(expected.size()) == rbTree.end());
+	EXPECT_EQ(std::distance(expected.lower_bound(50), expected.lower_bound(150)), static_cast<std::ptrdiff_t>(rbTree.countRange(50, 150)));
+	EXPECT_EQ(0, rbTree.countRange(150, 50));
+	EXPECT_EQ(expected.size(), rbTree.rank(1000));
+}
+
+TEST(RED_BLACK_TREE, SubtreeSizesSurviveCopyAndBuildTest)
+{
+	std::vector<std::pair<int, std::string> > items;
+	for (int i = 0; i < 100; i++)
+		items.push_back(std::make_pair(i * 2, std::to_string(i)));
+	IntStringOrderedRBTree rbTree(items.begin(), items.end());
+	IntStringOrderedRBTree copy(rbTree);
+	EXPECT_TRUE(copy.isValid());
+	EXPECT_EQ(40, copy.select(20)->first);
+	EXPECT_EQ(21, copy.rank(41));
+	copy.erase(copy.lower_bound(10), copy.lower_bound(30));
+	EXPECT_TRUE(copy.isValid());
+	EXPECT_EQ(30, copy.select(5)->first);
+	EXPECT_EQ(100, rbTree.countRange(0, 200));
+}
+
+TEST(RED_BLACK_TREE, OrderStatisticsOffKeepsNodeLayoutTest)
+{
+	struct PlainNode { void* Left; void* Right; void* Parent; bool IsRed; std::pair<const int, int> Value; };
+	NodePool plainPool, orderedPool;
+	RedBlackTree<int, int, std::less<int>, PoolAllocator<std::pair<const int, int> > > plainTree(plainPool);
+	RedBlackTree<int, int, std::less<int>, PoolAllocator<std::pair<const int, int> >, ExclusiveOwnership, WithOrderStatistics> orderedTree(orderedPool);
+	EXPECT_EQ(sizeof(PlainNode), plainPool.blockSize());
+	EXPECT_LT(plainPool.blockSize(), orderedPool.blockSize());
+}
+
+typedef PersistentRedBlackTree<int, std::string> IntStringPersistentRBTree;
+
+template<typename TREE>
+bool hasContent(const TREE& tree, const std::map<int, std::string>& expected)
+{
+	if (tree.size() != expected.size() || !tree.isValid())
+		return false;
+	auto expectedIt = expected.begin();
+	for (auto it = tree.begin(); it != tree.end(); ++it, ++expectedIt)
+	{
+		if (*it != *expectedIt)
+			return false;
+	}
+	auto reverseIt = expected.rbegin();
+	for (auto it = tree.end(); it != tree.begin(); ++reverseIt)
+	{
+		if (*--it != *reverseIt)
+			return false;
+	}
+	return true;
+}
+
+TEST(RED_BLACK_TREE, PersistentSnapshotIsUnchangedByUpdatesTest)
+{
+	IntStringPersistentRBTree rbTree;
+	std::map<int, std::string> snapshotContent;
+	for (int i = 0; i < 200; i++)
+	{
+		rbTree.insert(i, std::to_string(i));
+		snapshotContent[i] = std::to_string(i);
+	}
+	IntStringPersistentRBTree snapshot = rbTree.snapshot();
+	std::map<int, std::string> content = snapshotContent;
+	for (int i = 0; i < 200; i += 2)
+	{
+		EXPECT_EQ(1, rbTree.remove(i));
+		content.erase(i);
+	}
+	for (int i = 200; i < 300; i++)
+	{
+		EXPECT_TRUE(rbTree.insert(i, std::to_string(i)));
+		content[i] = std::to_string(i);
+	}
+	EXPECT_FALSE(rbTree.insert_or_assign(1, std::string("changed")));
+	content[1] = "changed";
+	EXPECT_TRUE(hasContent(rbTree, content));
+	EXPECT_TRUE(hasContent(snapshot, snapshotContent));
+	EXPECT_EQ("1", snapshot.find(1)->second);
+	EXPECT_EQ(3, rbTree.lower_bound(2)->first);
+	EXPECT_EQ(5, rbTree.upper_bound(3)->first);
+}
+
+TEST(RED_BLACK_TREE, PersistentVersionsMatchMapTest)
+{
+	IntStringPersistentRBTree rbTree;
+	std::map<int, std::string> content;
+	std::vector<std::pair<IntStringPersistentRBTree, std::map<int, std::string> > > versions;
+	srand(11);
+	for (int i = 0; i < 3000; i++)
+	{
+		int key = rand() % 400;
+		if (rand() % 3)
+			ASSERT_EQ(content.insert(std::make_pair(key, std::to_string(i))).second, rbTree.insert(key, std::to_string(i)));
+		else
+			ASSERT_EQ(content.erase(key), rbTree.remove(key));
+		if (i % 100 == 0)
+			versions.push_back(std::make_pair(rbTree.snapshot(), content));
+	}
+	ASSERT_TRUE(hasContent(rbTree, content));
+	for (auto& version : versions)
+		ASSERT_TRUE(hasContent(version.first, version.second));
+}
+
+TEST(RED_BLACK_TREE, PersistentIteratorKeepsVersionAliveTest)
+{
+	IntStringPersistentRBTree rbTree;
+	for (int i = 0; i < 10; i++)
+		rbTree.insert(i, std::to_string(i));
+	auto it = rbTree.find(5);
+	rbTree.clear();
+	EXPECT_TRUE(rbTree.isEmpty());
+	EXPECT_EQ("5", it->second);
+	EXPECT_EQ(6, (++it)->first);
+	EXPECT_EQ(4, (--(--it))->first);
+}
+
+TEST(RED_BLACK_TREE, PersistentSnapshotsReadOnOtherThreadsTest)
+{
+	const int itemsCount = 20000;
+	IntStringPersistentRBTree rbTree;
+	IntStringPersistentRBTree published;
+	std::mutex publishedMutex;
+	std::atomic<bool> isDone(false);
+	std::atomic<int> failures(0);
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 3; i++)
+	{
+		readers.push_back(std::thread([&]()
+		{
+			while (!isDone)
+			{
+				IntStringPersistentRBTree snapshot;
+				{
+					std::lock_guard<std::mutex> lock(publishedMutex);
+					snapshot = published;
+				}
+				size_t count = 0;
+				int previous = -1;
+				for (auto it = snapshot.begin(); it != snapshot.end(); ++it, ++count)
+				{
+					if (it->first <= previous || it->second != std::to_string(it->first))
+						failures++;
+					previous = it->first;
+				}
+				if (count != snapshot.size() || !snapshot.isValid())
+					failures++;
+			}
+		}));
+	}
+	for (int i = 0; i < itemsCount; i++)
+	{
+		rbTree.insert(i, std::to_string(i));
+		if (i % 3 == 0 && i >= 150)
+			rbTree.remove(i - 150);
+		if (i % 500 == 0)
+		{
+			IntStringPersistentRBTree snapshot = rbTree.snapshot();
+			std::lock_guard<std::mutex> lock(publishedMutex);
+			published = snapshot;
+		}
+	}
+	isDone = true;
+	for (auto& reader : readers)
+		reader.join();
+	EXPECT_EQ(0, failures);
+	EXPECT_TRUE(rbTree.isValid());
+}
+
+typedef ConcurrentRedBlackTree<int, std::string> IntStringConcurrentRBTree;
+
+TEST(RED_BLACK_TREE, ConcurrentTreeBasicOperationsTest)
+{
+	IntStringConcurrentRBTree rbTree(4);
+	EXPECT_EQ(4, rbTree.shardsCount());
+	EXPECT_TRUE(rbTree.isEmpty());
+	for (int i = 0; i < 100; i++)
+		EXPECT_TRUE(rbTree.insert(i, std::to_string(i)));
+	EXPECT_FALSE(rbTree.insert(5, "other"));
+	EXPECT_FALSE(rbTree.insert_or_assign(5, std::string("five")));
+	EXPECT_EQ(100, rbTree.size());
+	std::string data;
+	EXPECT_TRUE(rbTree.find(5, data));
+	EXPECT_EQ("five", data);
+	EXPECT_EQ(1, rbTree.remove(5));
+	EXPECT_FALSE(rbTree.contains(5));
+	EXPECT_FALSE(rbTree.find(5, data));
+	rbTree.clear();
+	EXPECT_TRUE(rbTree.isEmpty());
+}
+
+TEST(RED_BLACK_TREE, ConcurrentTreeMergesShardsInOrderTest)
+{
+	IntStringConcurrentRBTree rbTree(7);
+	std::map<int, std::string> expected;
+	srand(5);
+	for (int i = 0; i < 1000; i++)
+	{
+		int key = rand() % 5000;
+		rbTree.insert(key, std::to_string(i));
+		expected.insert(std::make_pair(key, std::to_string(i)));
+	}
+	{
+		IntStringConcurrentRBTree::ReadView view = rbTree.read();
+		EXPECT_EQ(expected.size(), view.size());
+		EXPECT_TRUE(std::equal(expected.begin(), expected.end(), view.begin()));
+		EXPECT_EQ(expected.lower_bound(2500)->first, view.lower_bound(2500)->first);
+		EXPECT_TRUE(view.find(-1) == view.end());
+	}
+	std::vector<int> visited;
+	EXPECT_TRUE(rbTree.forEachInRange(1000, 2000, [&visited](const IntStringConcurrentRBTree::value_type& item) { visited.push_back(item.first); return true; }));
+	std::vector<int> expectedKeys;
+	for (auto it = expected.lower_bound(1000); it != expected.lower_bound(2000); ++it)
+		expectedKeys.push_back(it->first);
+	EXPECT_EQ(expectedKeys, visited);
+}
+
+TEST(RED_BLACK_TREE, ConcurrentTreeParallelWritersTest)
+{
+	const int threadsCount = 4;
+	const int itemsPerThread = 5000;
+	IntStringConcurrentRBTree rbTree(8);
+	std::atomic<int> failures(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadsCount; t++)
+	{
+		threads.push_back(std::thread([&rbTree, &failures, t]()
+		{
+			for (int i = t; i < threadsCount * itemsPerThread; i += threadsCount)
+				if (!rbTree.insert(i, std::to_string(i)))
+					failures++;
+			for (int i = t; i < threadsCount * itemsPerThread; i += 2 * threadsCount)
+				rbTree.remove(i);
+		}));
+	}
+	threads.push_back(std::thread([&rbTree, &failures]()
+	{
+		for (int round = 0; round < 20; round++)
+		{
+			IntStringConcurrentRBTree::ReadView view = rbTree.read();
+			int previous = -1;
+			for (auto it = view.begin(); it != view.end(); ++it)
+			{
+				if (it->first <= previous)
+					failures++;
+				previous = it->first;
+			}
+		}
+	}));
+	for (auto& thread : threads)
+		thread.join();
+	EXPECT_EQ(0, failures);
+	EXPECT_EQ(threadsCount * itemsPerThread / 2, rbTree.size());
+}
+
+TEST(RED_BLACK_TREE, SeqLockTreeMatchesMapTest)
+{
+	typedef SeqLockRedBlackTree<int, int> IntSeqLockRBTree;
+	IntSeqLockRBTree rbTree;
+	std::map<int, int> expected;
+	srand(29);
+	for (int step = 0; step < 20000; step++)
+	{
+		int key = rand() % 1000;
+		int data;
+		switch (rand() % 4)
+		{
+		case 0:
+			ASSERT_EQ(expected.insert(std::make_pair(key, step)).second, rbTree.insert(key, step));
+			break;
+		case 1:
+			ASSERT_EQ(expected.find(key) == expected.end(), rbTree.insert_or_assign(key, step));
+			expected[key] = step;
+			break;
+		case 2:
+			ASSERT_EQ(expected.erase(key), rbTree.remove(key));
+			break;
+		default:
+			//missing key leaves data unchanged
+			data = -1;
+			ASSERT_EQ(expected.find(key) != expected.end(), rbTree.find(key, data));
+			ASSERT_EQ(expected.find(key) != expected.end() ? expected[key] : -1, data);
+			break;
+		}
+		if (step % 1000 == 0)
+		{
+			ASSERT_TRUE(rbTree.isValid());
+		}
+	}
+	ASSERT_TRUE(rbTree.isValid());
+	ASSERT_EQ(expected.size(), rbTree.size());
+	EXPECT_LT(rbTree.retiredCount(), IntSeqLockRBTree::ReclaimThreshold);
+	rbTree.clear();
+	EXPECT_TRUE(rbTree.isEmpty());
+	EXPECT_EQ(size_t(0), rbTree.retiredCount());
+	EXPECT_FALSE(rbTree.contains(1));
+}
+
+TEST(RED_BLACK_TREE, SeqLockTreeReadersDuringWritesTest)
+{
+	const int stableCount = 1000;
+	SeqLockRedBlackTree<int, std::string> rbTree;
+	for (int i = 0; i < stableCount; i++)
+		rbTree.insert(i, std::to_string(i));
+	std::atomic<bool> isWriting(true);
+	std::atomic<int> failures(0);
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 3; t++)
+	{
+		readers.push_back(std::thread([&rbTree, &isWriting, &failures, t]()
+		{
+			std::string data;
+			for (int i = t; isWriting; i = (i + 7) % stableCount)
+				if (!rbTree.find(i, data) || data != std::to_string(i))
+					failures++;
+		}));
+	}
+	for (int round = 0; round < 20; round++)
+	{
+		for (int i = stableCount; i < 2 * stableCount; i++)
+			rbTree.insert(i, std::to_string(i));
+		for (int i = round % 2; i < stableCount; i += 2)
+			rbTree.insert_or_assign(i, std::to_string(i));
+		for (int i = stableCount; i < 2 * stableCount; i++)
+			rbTree.remove(i);
+	}
+	isWriting = false;
+	for (auto& reader : readers)
+		reader.join();
+	EXPECT_EQ(0, failures);
+	EXPECT_TRUE(rbTree.isValid());
+	EXPECT_EQ(size_t(stableCount), rbTree.size());
+}
+
+template<typename TREE>
+void checkBatchesMatchMap()
+{
+	TREE rbTree;
+	std::map<int, std::string> expected;
+	srand(3);
+	for (int round = 0; round < 50; round++)
+	{
+		std::vector<std::pair<int, std::string> > items;
+		int base = rand() % 10000;
+		for (int i = 0; i < 200; i++)
+			items.push_back(std::make_pair(base + rand() % 400, std::to_string(round)));
+		size_t inserted = 0;
+		for (auto& item : items)
+			inserted += expected.insert(item).second ? 1 : 0;
+		ASSERT_EQ(inserted, rbTree.insertBatch(items.begin(), items.end()));
+		std::vector<int> keys;
+		for (int i = 0; i < 100; i++)
+			keys.push_back(base + rand() % 400);
+		size_t removed = 0;
+		for (int key : keys)
+			removed += expected.erase(key);
+		ASSERT_EQ(removed, rbTree.removeBatch(keys.begin(), keys.end()));
+		ASSERT_TRUE(rbTree.isValid());
+		ASSERT_EQ(expected.size(), rbTree.size());
+	}
+	ASSERT_TRUE(std::equal(expected.begin(), expected.end(), rbTree.begin()));
+}
+
+TEST(RED_BLACK_TREE, BatchOperationsTest)
+{
+	checkBatchesMatchMap<IntStringRBTree>();
+	checkBatchesMatchMap<IntStringRefCountedRBTree>();
+	checkBatchesMatchMap<IntStringOrderedRBTree>();
+}
+
+TEST(RED_BLACK_TREE, BatchSharesDescentTest)
+{
+	const int itemsCount = 4095;
+	RedBlackTree<int, int, CountingLess> rbTree;
+	for (int i = 0; i < itemsCount; i++)
+		rbTree.insert(i * 4, i);
+	std::vector<std::pair<int, int> > items;
+	for (int i = 0; i < 1000; i++)
+		items.push_back(std::make_pair(8001 + i * 4, i));
+	CountingLess::Comparisons = 0;
+	EXPECT_EQ(items.size(), rbTree.insertBatch(items.begin(), items.end()));
+	size_t batchComparisons = CountingLess::Comparisons;
+	//separate inserts would need a full descent of about 12 levels per item
+	EXPECT_LT(batchComparisons, items.size() * 12);
+	EXPECT_TRUE(rbTree.isValid());
+}
+
+template<typename TREE>
+void checkJoinAndSplit()
+{
+	for (int itemsCount : { 0, 1, 2, 7, 100, 1000 })
+	{
+		TREE rbTree;
+		for (int i = 0; i < itemsCount; i++)
+			rbTree.insert(i * 2, std::to_string(i));
+		for (int key : { -1, 0, 1, itemsCount / 2, itemsCount - 1, itemsCount * 2 })
+		{
+			TREE copy(rbTree);
+			TREE right;
+			right.insert(-5, "replaced");
+			copy.split(key, right);
+			ASSERT_TRUE(copy.isValid());
+			ASSERT_TRUE(right.isValid());
+			ASSERT_EQ(rbTree.size(), copy.size() + right.size());
+			if (!copy.isEmpty())
+			{
+				ASSERT_LT((--copy.end())->first, key);
+			}
+			if (!right.isEmpty())
+			{
+				ASSERT_GE(right.begin()->first, key);
+			}
+			copy.join(right);
+			ASSERT_TRUE(right.isEmpty());
+			ASSERT_TRUE(copy.isValid());
+			ASSERT_TRUE(std::equal(rbTree.begin(), rbTree.end(), copy.begin()));
+		}
+	}
+	//trees of different heights are joined over a middle key
+	for (int leftCount : { 0, 3, 500 })
+	{
+		for (int rightCount : { 0, 5, 300 })
+		{
+			TREE left, right;
+			for (int i = 0; i < leftCount; i++)
+				left.insert(i, "left");
+			for (int i = 0; i < rightCount; i++)
+				right.insert(leftCount + 1 + i, "right");
+			left.join(leftCount, "middle", right);
+			ASSERT_TRUE(left.isValid());
+			ASSERT_EQ(size_t(leftCount + rightCount + 1), left.size());
+			ASSERT_EQ("middle", left.find(leftCount)->second);
+			ASSERT_TRUE(right.isEmpty());
+			right.insert(1, "reused");
+			ASSERT_TRUE(right.isValid());
+		}
+	}
+	//moved nodes stay usable after the tree they came from is gone
+	TREE right;
+	{
+		TREE left;
+		for (int i = 0; i < 100; i++)
+			left.insert(i, std::to_string(i));
+		left.split(40, right);
+	}
+	right.insert(1000, "last");
+	right.erase(right.begin());
+	right.remove(70);
+	ASSERT_TRUE(right.isValid());
+	ASSERT_EQ(59u, right.size());
+	ASSERT_EQ(41, right.begin()->first);
+	ASSERT_EQ(1000, (--right.end())->first);
+}
+
+TEST(RED_BLACK_TREE, JoinAndSplitTest)
+{
+	checkJoinAndSplit<IntStringRBTree>();
+	checkJoinAndSplit<IntStringRefCountedRBTree>();
+	checkJoinAndSplit<IntStringOrderedRBTree>();
+}
+
+TEST(RED_BLACK_TREE, JoinRejectsOverlappingKeysTest)
+{
+	IntStringRBTree left, right;
+	fillIntStringRBTreeWithAscendingRange(left, 0, 10);
+	fillIntStringRBTreeWithAscendingRange(right, 9, 20);
+	EXPECT_THROW(left.join(right), std::invalid_argument);
+	EXPECT_THROW(left.join(5, "middle", right), std::invalid_argument);
+	EXPECT_THROW(left.join(left), std::invalid_argument);
+	EXPECT_EQ(10, left.size());
+	EXPECT_EQ(11, right.size());
+}
+
+template<typename TREE>
+void checkSetOperationsMatchStd(ThreadPool& pool)
+{
+	srand(5);
+	for (int round = 0; round < 20; round++)
+	{
+		TREE first, second;
+		std::map<int, std::string> firstExpected, secondExpected;
+		int firstCount = rand() % 3000, secondCount = rand() % 3000;
+		for (int i = 0; i < firstCount; i++)
+		{
+			int key = rand() % 4000;
+			first.insert(key, "first");
+			firstExpected.insert(std::make_pair(key, "first"));
+		}
+		for (int i = 0; i < secondCount; i++)
+		{
+			int key = rand() % 4000;
+			second.insert(key, "second");
+			secondExpected.insert(std::make_pair(key, "second"));
+		}
+		std::map<int, std::string> expected;
+		auto keyLess = [](const std::pair<const int, std::string>& a, const std::pair<const int, std::string>& b) { return a.first < b.first; };
+		auto output = std::inserter(expected, expected.end());
+		TREE result(first);
+		switch (round % 3)
+		{
+		case 0:
+			result.unionWith(second, pool);
+			std::set_union(firstExpected.begin(), firstExpected.end(), secondExpected.begin(), secondExpected.end(), output, keyLess);
+			break;
+		case 1:
+			result.intersectWith(second, pool);
+			std::set_intersection(firstExpected.begin(), firstExpected.end(), secondExpected.begin(), secondExpected.end(), output, keyLess);
+			break;
+		default:
+			result.differenceWith(second, pool);
+			std::set_difference(firstExpected.begin(), firstExpected.end(), secondExpected.begin(), secondExpected.end(), output, keyLess);
+			break;
+		}
+		ASSERT_TRUE(result.isValid());
+		ASSERT_EQ(expected.size(), result.size());
+		ASSERT_TRUE(std::equal(expected.begin(), expected.end(), result.begin()));
+		ASSERT_EQ(secondExpected.size(), second.size());
+		ASSERT_TRUE(second.isValid());
+	}
+}
+
+TEST(RED_BLACK_TREE, SetOperationsMatchStdTest)
+{
+	ThreadPool pool(3);
+	checkSetOperationsMatchStd<IntStringRBTree>(pool);
+	checkSetOperationsMatchStd<IntStringRefCountedRBTree>(pool);
+	checkSetOperationsMatchStd<IntStringOrderedRBTree>(pool);
+}
+
+TEST(RED_BLACK_TREE, SetOperationsCopyOnlyAddedItemsTest)
+{
+	typedef RedBlackTree<int, int, std::less<int>, std::allocator<std::pair<const int, int> >,
+		ExclusiveOwnership, WithoutOrderStatistics, WithOperationCounters> CountedTree;
+	ThreadPool pool(2);
+	CountedTree rbTree, intersection, other;
+	for (int i = 0; i < 1000; i++)
+	{
+		rbTree.insert(i, i);
+		intersection.insert(i, i);
+	}
+	for (int i = 500; i < 1600; i++)
+		other.insert(i, -i);
+	intersection.resetStats();
+	intersection.intersectWith(other, pool);
+	EXPECT_EQ(size_t(0), intersection.stats().Operations.Allocations);
+	EXPECT_EQ(size_t(500), intersection.size());
+	rbTree.resetStats();
+	rbTree.unionWith(other, pool);
+	EXPECT_EQ(size_t(600), rbTree.stats().Operations.Allocations);
+	EXPECT_TRUE(rbTree.isValid());
+	EXPECT_EQ(size_t(1600), rbTree.size());
+	EXPECT_EQ(500, rbTree.find(500)->second);
+	EXPECT_EQ(-1500, rbTree.find(1500)->second);
+	EXPECT_EQ(size_t(1100), other.size());
+	//a tree combined with itself
+	rbTree.unionWith(rbTree, pool);
+	EXPECT_EQ(size_t(1600), rbTree.size());
+	rbTree.differenceWith(rbTree, pool);
+	EXPECT_TRUE(rbTree.isEmpty());
+	EXPECT_TRUE(rbTree.isValid());
+}
+
+TEST(RED_BLACK_TREE, ThreadPoolInvokeTest)
+{
+	ThreadPool pool(2);
+	std::function<long long(int, int)> sum = [&](int low, int high) -> long long
+	{
+		if (high - low < 100)
+		{
+			long long result = 0;
+			for (int i = low; i < high; i++)
+				result += i;
+			return result;
+		}
+		long long left = 0, right = 0;
+		int middle = low + (high - low) / 2;
+		pool.invoke([&]() { left = sum(low, middle); }, [&]() { right = sum(middle, high); });
+		return left + right;
+	};
+	EXPECT_EQ(99999LL * 100000 / 2, sum(0, 100000));
+	EXPECT_THROW(pool.invoke([]() {}, []() { throw std::runtime_error("task"); }), std::runtime_error);
+}
+
+TEST(RED_BLACK_TREE, ParallelTraversalTest)
+{
+	ThreadPool pool(3);
+	RedBlackTree<int, long long> rbTree;
+	std::map<int, long long> expected;
+	srand(31);
+	for (int i = 0; i < 100000; i++)
+	{
+		int key = rand() % 1000000;
+		rbTree.insert(key, key);
+		expected.insert(std::make_pair(key, key));
+	}
+	rbTree.parallel_for_each([](std::pair<const int, long long>& item) { item.second *= 2; }, pool);
+	for (auto& item : expected)
+		item.second *= 2;
+	EXPECT_TRUE(std::equal(expected.begin(), expected.end(), rbTree.begin()));
+
+	const RedBlackTree<int, long long>& constTree = rbTree;
+	std::atomic<long long> sum(0);
+	constTree.parallel_for_each([&sum](const std::pair<const int, long long>& item) { sum += item.second; }, pool);
+	long long expectedSum = 0;
+	for (auto& item : expected)
+		expectedSum += item.second;
+	EXPECT_EQ(expectedSum, sum);
+	EXPECT_EQ(expectedSum, rbTree.parallel_reduce(0LL, [](const std::pair<const int, long long>& item) { return item.second; },
+		[](long long left, long long right) { return left + right; }, pool));
+
+	//subtree results are combined in key order, so a non-commutative reduction matches the sequential one
+	typedef std::vector<int> Keys;
+	Keys keys = rbTree.parallel_reduce(Keys(), [](const std::pair<const int, long long>& item) { return Keys(1, item.first); },
+		[](Keys left, const Keys& right) { left.insert(left.end(), right.begin(), right.end()); return left; }, pool);
+	Keys expectedKeys;
+	for (auto& item : expected)
+		expectedKeys.push_back(item.first);
+	EXPECT_EQ(expectedKeys, keys);
+
+	std::atomic<size_t> inRange(0);
+	std::atomic<int> outOfRange(0);
+	rbTree.parallel_for_each_in_range(250000, 750000, [&inRange, &outOfRange](const std::pair<const int, long long>& item)
+	{
+		inRange++;
+		if (item.first < 250000 || item.first >= 750000)
+			outOfRange++;
+	}, pool);
+	EXPECT_EQ(size_t(std::distance(expected.lower_bound(250000), expected.lower_bound(750000))), inRange);
+	EXPECT_EQ(0, outOfRange);
+
+	RedBlackTree<int, long long> emptyTree;
+	EXPECT_EQ(7, emptyTree.parallel_reduce(7, [](const std::pair<const int, long long>&) { return 1; }, [](int left, int right) { return left + right; }));
+	int lastKey = expectedKeys.back();
+	EXPECT_THROW(rbTree.parallel_for_each([lastKey](const std::pair<const int, long long>& item) { if (item.first == lastKey) throw std::runtime_error("item"); }, pool), std::runtime_error);
+}
+
+template<typename KEY>
+void checkKeySearchMatchesStd()
+{
+	std::vector<KEY> keys;
+	for (int i = 0; i < 70; i++)
+		keys.push_back(KEY(i * 3));
+	for (size_t count = 0; count <= keys.size(); count++)
+	{
+		for (int probe = -2; probe < 215; probe++)
+		{
+			KEY key = KEY(probe);
+			size_t lower = std::lower_bound(keys.begin(), keys.begin() + count, key) - keys.begin();
+			size_t upper = std::upper_bound(keys.begin(), keys.begin() + count, key) - keys.begin();
+			ASSERT_EQ(lower, (KeySearch<KEY, std::less<KEY> >::lowerBound(keys.data(), count, key, std::less<KEY>())));
+			ASSERT_EQ(upper, (KeySearch<KEY, std::less<KEY> >::upperBound(keys.data(), count, key, std::less<KEY>())));
+			ASSERT_EQ(lower, (KeySearch<KEY, std::less<KEY>, false>::lowerBound(keys.data(), count, key, std::less<KEY>())));
+			ASSERT_EQ(upper, (KeySearch<KEY, std::less<KEY>, false>::upperBound(keys.data(), count, key, std::less<KEY>())));
+		}
+	}
+}
+
+TEST(RED_BLACK_TREE, KeySearchTest)
+{
+	checkKeySearchMatchesStd<int>();
+	checkKeySearchMatchesStd<float>();
+	checkKeySearchMatchesStd<double>();
+	checkKeySearchMatchesStd<unsigned short>();
+	checkKeySearchMatchesStd<long long>();
+}
+
+template<typename MAP, typename KEY_FACTORY>
+void checkBTreeMatchesMap(KEY_FACTORY makeKey)
+{
+	MAP bTree;
+	std::map<typename MAP::key_type, typename MAP::mapped_type, typename MAP::key_compare> expected;
+	srand(7);
+	for (int step = 0; step < 20000; step++)
+	{
+		typename MAP::key_type key = makeKey(rand() % 3000);
+		typename MAP::mapped_type data = typename MAP::mapped_type();
+		switch (rand() % 4)
+		{
+		case 0:
+		case 1:
+			ASSERT_EQ(expected.insert(std::make_pair(key, data)).second, bTree.try_emplace(key, data).second);
+			break;
+		case 2:
+			ASSERT_EQ(expected.erase(key), bTree.remove(key));
+			break;
+		default:
+			ASSERT_EQ(expected.find(key) == expected.end(), bTree.find(key) == bTree.end());
+			break;
+		}
+		if (step % 1000 == 0)
+		{
+			ASSERT_TRUE(bTree.isValid());
+		}
+	}
+	ASSERT_TRUE(bTree.isValid());
+	ASSERT_EQ(expected.size(), bTree.size());
+	auto expectedIt = expected.begin();
+	for (auto it = bTree.begin(); it != bTree.end(); ++it, ++expectedIt)
+		ASSERT_TRUE(it->first == expectedIt->first);
+	auto reverseIt = expected.rbegin();
+	for (auto it = bTree.end(); it != bTree.begin(); ++reverseIt)
+		ASSERT_TRUE((--it)->first == reverseIt->first);
+	for (int i = 0; i < 3000; i += 7)
+	{
+		typename MAP::key_type key = makeKey(i);
+		auto lower = expected.lower_bound(key);
+		auto upper = expected.upper_bound(key);
+		ASSERT_EQ(lower == expected.end(), bTree.lower_bound(key) == bTree.end());
+		ASSERT_EQ(upper == expected.end(), bTree.upper_bound(key) == bTree.end());
+		if (lower != expected.end())
+		{
+			ASSERT_TRUE(bTree.lower_bound(key)->first == lower->first);
+		}
+		if (upper != expected.end())
+		{
+			ASSERT_TRUE(bTree.upper_bound(key)->first == upper->first);
+		}
+	}
+	for (auto& item : expected)
+		ASSERT_EQ(1, bTree.remove(item.first));
+	ASSERT_TRUE(bTree.isEmpty());
+	ASSERT_TRUE(bTree.isValid());
+	ASSERT_TRUE(bTree.begin() == bTree.end());
+}
+
+TEST(RED_BLACK_TREE, BTreeMapMatchesMapTest)
+{
+	checkBTreeMatchesMap<BTreeMap<int, std::string> >([](int i) { return i; });
+	checkBTreeMatchesMap<BTreeMap<std::string, int> >([](int i) { return std::to_string(i); });
+	checkBTreeMatchesMap<BTreeMap<double, int, std::greater<double> > >([](int i) { return i / 4.0; });
+}
+
+TEST(RED_BLACK_TREE, BTreeMapInterfaceTest)
+{
+	BTreeMap<int, std::string> bTree;
+	EXPECT_THROW(*bTree.begin(), std::runtime_error);
+	for (int i = 0; i < 1000; i++)
+		bTree.insert(i, std::to_string(i));
+	EXPECT_EQ("10", bTree.find(10)->second);
+	EXPECT_FALSE(bTree.insert_or_assign(10, "ten").second);
+	EXPECT_EQ("ten", bTree.find(10)->second);
+	bTree[11] = "eleven";
+	EXPECT_EQ("eleven", (*bTree.find(11)).second);
+	EXPECT_TRUE(bTree.insert_or_assign(1000, "last").second);
+	EXPECT_THROW(--bTree.begin(), std::out_of_range);
+	EXPECT_THROW(++bTree.end(), std::out_of_range);
+	EXPECT_EQ(1000, (--bTree.end())->first);
+
+	BTreeMap<int, std::string> copy(bTree);
+	bTree.clear();
+	EXPECT_TRUE(bTree.isEmpty());
+	EXPECT_TRUE(copy.isValid());
+	EXPECT_EQ(1001, copy.size());
+	EXPECT_EQ("eleven", copy.find(11)->second);
+	bTree = copy;
+	EXPECT_TRUE(bTree.isValid());
+	EXPECT_EQ(copy.size(), bTree.size());
+}
+
+TEST(RED_BLACK_TREE, FreezeMatchesTreeTest)
+{
+	srand(11);
+	for (int itemsCount : { 0, 1, 2, 3, 7, 8, 31, 100, 5000 })
+	{
+		IntStringRBTree rbTree;
+		while (rbTree.size() < size_t(itemsCount))
+		{
+			int key = rand() % (itemsCount * 4);
+			rbTree.insert(key * 2, std::to_string(key));
+		}
+		IntStringRBTree::frozen_map_type frozen = rbTree.freeze();
+		ASSERT_EQ(rbTree.size(), frozen.size());
+		auto treeIt = rbTree.begin();
+		for (auto it = frozen.begin(); it != frozen.end(); ++it, ++treeIt)
+		{
+			ASSERT_EQ(treeIt->first, it->first);
+			ASSERT_EQ(treeIt->second, (*it).second);
+		}
+		ASSERT_TRUE(treeIt == rbTree.end());
+		for (auto it = frozen.end(); it != frozen.begin();)
+			ASSERT_EQ((--treeIt)->first, (--it)->first);
+		for (int key = -1; key <= itemsCount * 8 + 1; key++)
+		{
+			ASSERT_EQ(rbTree.find(key) == rbTree.end(), frozen.find(key) == frozen.end());
+			auto lower = rbTree.lower_bound(key);
+			auto upper = rbTree.upper_bound(key);
+			ASSERT_EQ(lower == rbTree.end(), frozen.lower_bound(key) == frozen.end());
+			ASSERT_EQ(upper == rbTree.end(), frozen.upper_bound(key) == frozen.end());
+			if (lower != rbTree.end())
+			{
+				ASSERT_EQ(lower->first, frozen.lower_bound(key)->first);
+			}
+			if (upper != rbTree.end())
+			{
+				ASSERT_EQ(upper->first, frozen.upper_bound(key)->first);
+			}
+		}
+	}
+}
+
+TEST(RED_BLACK_TREE, FrozenMapRejectsUnsortedRangeTest)
+{
+	std::vector<std::pair<int, int> > items = { { 1, 1 }, { 3, 3 }, { 2, 2 } };
+	EXPECT_THROW((FrozenMap<int, int>(items.begin(), items.end())), std::invalid_argument);
+	items[2].first = 3;
+	EXPECT_THROW((FrozenMap<int, int>(items.begin(), items.end())), std::invalid_argument);
+	FrozenMap<int, int> frozen(items.begin(), items.begin() + 2);
+	EXPECT_EQ(3, frozen.find(3)->second);
+	EXPECT_THROW(*frozen.end(), std::runtime_error);
+	EXPECT_THROW(--frozen.begin(), std::out_of_range);
+}
+
+TEST(RED_BLACK_TREE, SaveAndOpenMappedTest)
+{
+	const char* path = "rbtree_image.bin";
+	RedBlackTree<int, double> rbTree;
+	for (int i = 0; i < 3000; i++)
+		rbTree.insert(i * 3, i / 2.0);
+	rbTree.save(path);
+	{
+		RedBlackTree<int, double>::frozen_map_type mapped = RedBlackTree<int, double>::open_mapped(path);
+		ASSERT_EQ(rbTree.size(), mapped.size());
+		ASSERT_TRUE(std::equal(rbTree.begin(), rbTree.end(), mapped.begin(),
+			[](const std::pair<const int, double>& item, const std::pair<const int&, const double&>& mappedItem) { return item.first == mappedItem.first && item.second == mappedItem.second; }));
+		EXPECT_EQ(5.0, mapped.find(30)->second);
+		EXPECT_TRUE(mapped.find(31) == mapped.end());
+		EXPECT_EQ(33, mapped.lower_bound(31)->first);
+
+		//mutable copy is built from the mapping in O(n)
+		RedBlackTree<int, double> thawed(mapped.begin(), mapped.end());
+		thawed.insert(1, 0.25);
+		EXPECT_TRUE(thawed.isValid());
+		EXPECT_EQ(rbTree.size() + 1, thawed.size());
+		EXPECT_TRUE(mapped.find(1) == mapped.end());
+	}
+	RedBlackTree<int, double>().save(path);
+	EXPECT_TRUE((RedBlackTree<int, double>::open_mapped(path).isEmpty()));
+	EXPECT_THROW((RedBlackTree<int, int>::open_mapped(path)), std::runtime_error);
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << "not an image";
+	}
+	EXPECT_THROW((RedBlackTree<int, double>::open_mapped(path)), std::runtime_error);
+	std::remove(path);
+	EXPECT_THROW((RedBlackTree<int, double>::open_mapped(path)), std::runtime_error);
+}
+
+TEST(RED_BLACK_TREE, OperationCountersTest)
+{
+	typedef RedBlackTree<int, int, std::less<int>, std::allocator<std::pair<const int, int> >,
+		ExclusiveOwnership, WithoutOrderStatistics, WithOperationCounters> CountedTree;
+	const size_t count = 1000;
+	std::vector<int> keys;
+	for (size_t i = 0; i < count; i++)
+		keys.push_back(int(i));
+	srand(7);
+	for (size_t i = count - 1; i > 0; i--)
+		std::swap(keys[i], keys[rand() % (i + 1)]);
+	CountedTree rbTree;
+	for (size_t i = 0; i < count; i++)
+		rbTree.insert(keys[i], keys[i]);
+	TreeStatistics statistics = rbTree.stats();
+	EXPECT_EQ(count, statistics.Count);
+	EXPECT_LE(statistics.Height, 2 * statistics.BlackHeight);
+	EXPECT_LE(statistics.Height, size_t(20));
+	EXPECT_GE(statistics.BytesPerEntry, double(sizeof(std::pair<const int, int>)));
+	//sentinel is the first allocation
+	EXPECT_EQ(count + 1, statistics.Operations.Allocations);
+	EXPECT_GT(statistics.Operations.Rotations, size_t(0));
+	EXPECT_GT(statistics.Operations.Recolorings, size_t(0));
+	EXPECT_GT(statistics.Operations.Comparisons, count);
+
+	rbTree.resetStats();
+	for (size_t i = 0; i < count; i++)
+		EXPECT_EQ(keys[i], rbTree.find(keys[i])->second);
+	statistics = rbTree.stats();
+	EXPECT_EQ(size_t(0), statistics.Operations.Rotations);
+	EXPECT_EQ(size_t(0), statistics.Operations.Allocations);
+	//every search ends in a leaf, so it visits at least black height nodes
+	ASSERT_EQ(statistics.Height + 1, statistics.Operations.SearchLengths.size());
+	size_t searches = 0;
+	for (size_t i = 0; i < statistics.Operations.SearchLengths.size(); i++)
+	{
+		if (i < statistics.BlackHeight)
+		{
+			EXPECT_EQ(size_t(0), statistics.Operations.SearchLengths[i]);
+		}
+		searches += statistics.Operations.SearchLengths[i];
+	}
+	EXPECT_EQ(count, searches);
+
+	for (size_t i = 0; i < count; i++)
+		rbTree.remove(keys[i]);
+	EXPECT_EQ(count, rbTree.stats().Operations.Frees);
+	EXPECT_EQ(size_t(0), rbTree.stats().Height);
+
+	//counters are compiled out by default
+	RedBlackTree<int, int> plainTree;
+	plainTree.insert(1, 1);
+	EXPECT_EQ(sizeof(plainTree), sizeof(CountedTree) - sizeof(WithOperationCounters));
+	EXPECT_EQ(size_t(0), plainTree.stats().Operations.Comparisons);
+	EXPECT_TRUE(plainTree.stats().Operations.SearchLengths.empty());
+	EXPECT_EQ(size_t(1), plainTree.stats().Height);
+}
+
+TEST(RED_BLACK_TREE, HintedInsertAndFindTest)
+{
+	typedef RedBlackTree<int, int, std::less<int>, std::allocator<std::pair<const int, int> >,
+		ExclusiveOwnership, WithOrderStatistics, WithOperationCounters> CountedTree;
+	//appending at the end costs one comparison per item
+	CountedTree appended;
+	for (int i = 0; i < 10000; i++)
+		appended.insert(appended.end(), i, i);
+	EXPECT_TRUE(appended.isValid());
+	EXPECT_EQ(size_t(10000), appended.size());
+	EXPECT_EQ(size_t(10000 - 1), appended.stats().Operations.Comparisons);
+
+	CountedTree::iterator hint = appended.find(5000);
+	appended.resetStats();
+	for (int i = 4999; i >= 0; i--)
+		EXPECT_EQ(i, appended.find(hint, i)->first);
+	EXPECT_TRUE(appended.find(hint, 10000) == appended.end());
+	EXPECT_TRUE(appended.find(appended.end(), 9999) == --appended.end());
+	EXPECT_TRUE(appended.find(CountedTree::const_iterator(), 77) == appended.find(77));
+
+	RedBlackTree<int, int> rbTree;
+	std::map<int, int> expected;
+	srand(19);
+	for (int i = 0; i < 3000; i++)
+	{
+		int key = rand() % 2000;
+		RedBlackTree<int, int>::iterator near = rbTree.lower_bound(rand() % 2000);
+		RedBlackTree<int, int>::iterator inserted;
+		if (i % 2)
+			inserted = rbTree.insert(near, key, i);
+		else
+			inserted = rbTree.emplace_hint(near, key, i);
+		expected.insert(std::make_pair(key, i));
+		ASSERT_EQ(key, inserted->first);
+		ASSERT_EQ(expected[key], inserted->second);
+		ASSERT_TRUE(rbTree.find(near, key) == inserted);
+	}
+	EXPECT_TRUE(rbTree.isValid());
+	ASSERT_EQ(expected.size(), rbTree.size());
+	EXPECT_TRUE(std::equal(expected.begin(), expected.end(), rbTree.begin()));
+	EXPECT_TRUE(rbTree.find(rbTree.begin(), 2001) == rbTree.end());
+}
+
+TEST(RED_BLACK_TREE, FindManyMatchesFindTest)
+{
+	RedBlackTree<int, int> rbTree;
+	srand(37);
+	for (int i = 0; i < 10000; i++)
+		rbTree.insert(rand() % 30000, i);
+	std::vector<int> keys;
+	for (int i = 0; i < 1000; i++)
+		keys.push_back(rand() % 30000);
+	keys.push_back(-1);
+	keys.push_back(30000);
+	std::vector<RedBlackTree<int, int>::iterator> found;
+	rbTree.find_many(keys.begin(), keys.end(), std::back_inserter(found));
+	ASSERT_EQ(keys.size(), found.size());
+	for (size_t i = 0; i < keys.size(); i++)
+		ASSERT_TRUE(rbTree.find(keys[i]) == found[i]);
+
+	//keys of a list and a group larger than the range
+	const RedBlackTree<int, int>& constTree = rbTree;
+	std::list<int> fewKeys(keys.begin(), keys.begin() + 5);
+	std::vector<RedBlackTree<int, int>::const_iterator> constFound(fewKeys.size());
+	EXPECT_TRUE(constTree.find_many(fewKeys.begin(), fewKeys.end(), constFound.begin()) == constFound.end());
+	EXPECT_TRUE(std::equal(found.begin(), found.begin() + 5, constFound.begin()));
+
+	RedBlackMultiTree<int, int> multiTree;
+	multiTree.insert(2, 1);
+	multiTree.insert(2, 2);
+	multiTree.insert(1, 3);
+	std::vector<int> multiKeys = { 2, 3, 1 };
+	std::vector<RedBlackMultiTree<int, int>::iterator> multiFound(multiKeys.size());
+	multiTree.find_many(multiKeys.begin(), multiKeys.end(), multiFound.begin());
+	EXPECT_EQ(1, multiFound[0]->second);
+	EXPECT_TRUE(multiFound[1] == multiTree.end());
+	EXPECT_EQ(3, multiFound[2]->second);
+}
+
+TEST(RED_BLACK_TREE, CompactTreeMatchesMapTest)
+{
+	checkBTreeMatchesMap<CompactRedBlackTree<int, std::string> >([](int i) { return i; });
+	checkBTreeMatchesMap<CompactRedBlackTree<std::string, int> >([](int i) { return std::to_string(i); });
+	checkBTreeMatchesMap<CompactRedBlackTree<double, int, std::greater<double> > >([](int i) { return i / 4.0; });
+}
+
+TEST(RED_BLACK_TREE, CompactTreeInterfaceTest)
+{
+	//links and color take 12 bytes, the rest is the item and its alignment
+	typedef CompactRedBlackTree<int, int> IntTree;
+	typedef CompactRedBlackTree<long long, long long> LongTree;
+	EXPECT_EQ(sizeof(IntTree::value_type) + 12, IntTree::nodeSize());
+	EXPECT_GE(sizeof(LongTree::value_type) + 16, LongTree::nodeSize());
+
+	CompactRedBlackTree<int, std::string> compactTree;
+	EXPECT_TRUE(compactTree.isValid());
+	EXPECT_TRUE(compactTree.find(1) == compactTree.end());
+	EXPECT_EQ(size_t(0), compactTree.remove(1));
+	EXPECT_THROW(*compactTree.begin(), std::runtime_error);
+	EXPECT_THROW(--compactTree.end(), std::out_of_range);
+	for (int i = 0; i < 10000; i++)
+		compactTree.insert(i, std::to_string(i));
+	std::string& tenth = compactTree.find(10)->second;
+	for (int i = 10000; i < 20000; i++)
+		compactTree.insert(i, std::to_string(i));
+	EXPECT_EQ(&tenth, &compactTree.find(10)->second);
+	EXPECT_FALSE(compactTree.insert_or_assign(10, "ten").second);
+	EXPECT_EQ("ten", tenth);
+	compactTree[11] = "eleven";
+	EXPECT_EQ("eleven", (*compactTree.find(11)).second);
+	EXPECT_THROW(--compactTree.begin(), std::out_of_range);
+	EXPECT_THROW(++compactTree.end(), std::out_of_range);
+	EXPECT_EQ(19999, (--compactTree.end())->first);
+
+	auto it = compactTree.lower_bound(100);
+	while (it != compactTree.end() && it->first < 200)
+		it = compactTree.erase(it);
+	EXPECT_EQ(200, it->first);
+	EXPECT_EQ(size_t(19900), compactTree.size());
+	EXPECT_TRUE(compactTree.isValid());
+	//removed slots are reused, the item keeps its address
+	for (int i = 100; i < 200; i++)
+		compactTree.insert(i, std::to_string(i));
+	EXPECT_EQ(&tenth, &compactTree.find(10)->second);
+	EXPECT_TRUE(compactTree.isValid());
+
+	CompactRedBlackTree<int, std::string> copy(compactTree);
+	compactTree.clear();
+	EXPECT_TRUE(compactTree.isEmpty());
+	EXPECT_TRUE(compactTree.isValid());
+	//cleared tree holds no chunk until the next insert
+	compactTree.insert(1, "one");
+	EXPECT_EQ("one", compactTree.begin()->second);
+	EXPECT_TRUE(compactTree.isValid());
+	EXPECT_TRUE(copy.isValid());
+	EXPECT_EQ(size_t(20000), copy.size());
+	EXPECT_EQ("eleven", copy.find(11)->second);
+	compactTree = copy;
+	EXPECT_TRUE(compactTree.isValid());
+	EXPECT_TRUE(std::equal(copy.begin(), copy.end(), compactTree.begin()));
+}
+
+TEST(RED_BLACK_TREE, TopDownTreeMatchesMapTest)
+{
+	checkBTreeMatchesMap<TopDownRedBlackTree<int, std::string> >([](int i) { return i; });
+	checkBTreeMatchesMap<TopDownRedBlackTree<std::string, int> >([](int i) { return std::to_string(i); });
+	checkBTreeMatchesMap<TopDownRedBlackTree<double, int, std::greater<double> > >([](int i) { return i / 4.0; });
+}
+
+TEST(RED_BLACK_TREE, TopDownTreeInterfaceTest)
+{
+	//no parent pointer, two links and the color padded to the item alignment
+	typedef TopDownRedBlackTree<long long, long long> LongTree;
+	EXPECT_GE(sizeof(LongTree::value_type) + 2 * sizeof(void*) + alignof(LongTree::value_type), LongTree::nodeSize());
+
+	TopDownRedBlackTree<int, std::string> topDownTree;
+	EXPECT_THROW(*topDownTree.begin(), std::runtime_error);
+	EXPECT_THROW(--topDownTree.end(), std::out_of_range);
+	for (int i = 0; i < 10000; i++)
+		EXPECT_EQ(i, topDownTree.insert(i, std::to_string(i))->first);
+	EXPECT_TRUE(topDownTree.isValid());
+	std::string& tenth = topDownTree.find(10)->second;
+	for (int i = 20000; i >= 10000; i--)
+		topDownTree.insert(i, std::to_string(i));
+	EXPECT_EQ(&tenth, &topDownTree.find(10)->second);
+	EXPECT_FALSE(topDownTree.insert_or_assign(10, "ten").second);
+	EXPECT_EQ("ten", tenth);
+	topDownTree[11] = "eleven";
+	EXPECT_EQ("eleven", (*topDownTree.find(11)).second);
+	EXPECT_THROW(--topDownTree.begin(), std::out_of_range);
+	EXPECT_THROW(++topDownTree.end(), std::out_of_range);
+	EXPECT_EQ(20000, (--topDownTree.end())->first);
+	EXPECT_EQ(9999, (--topDownTree.lower_bound(10000))->first);
+
+	auto it = topDownTree.lower_bound(100);
+	while (it != topDownTree.end() && it->first < 200)
+		it = topDownTree.erase(it);
+	EXPECT_EQ(200, it->first);
+	EXPECT_EQ(size_t(19901), topDownTree.size());
+	EXPECT_TRUE(topDownTree.isValid());
+	//removal relinks nodes, the items stay in place
+	EXPECT_EQ(&tenth, &topDownTree.find(10)->second);
+	it = topDownTree.find(20000);
+	EXPECT_TRUE(topDownTree.erase(it) == topDownTree.end());
+
+	TopDownRedBlackTree<int, std::string> copy(topDownTree);
+	topDownTree.clear();
+	EXPECT_TRUE(topDownTree.isEmpty());
+	EXPECT_TRUE(topDownTree.isValid());
+	EXPECT_TRUE(topDownTree.begin() == topDownTree.end());
+	EXPECT_TRUE(copy.isValid());
+	EXPECT_EQ(size_t(19900), copy.size());
+	EXPECT_EQ("eleven", copy.find(11)->second);
+	topDownTree = copy;
+	EXPECT_TRUE(topDownTree.isValid());
+	EXPECT_TRUE(std::equal(copy.begin(), copy.end(), topDownTree.begin()));
+}
+
+TEST(RED_BLACK_TREE, MultiTreeKeepsDuplicatesInInsertionOrderTest)
+{
+	typedef RedBlackMultiTree<int, std::string> IntStringMultiTree;
+	IntStringMultiTree multiTree;
+	multiTree.insert(1, "first");
+	multiTree.insert(0, "zero");
+	multiTree.insert(1, "second");
+	multiTree.emplace(1, "third");
+	multiTree.insert(multiTree.find(1), 1, "before first");
+	multiTree.emplace_hint(multiTree.end(), 2, "two");
+	ASSERT_TRUE(multiTree.isValid());
+	EXPECT_EQ(size_t(6), multiTree.size());
+	EXPECT_EQ(size_t(4), multiTree.count(1));
+	EXPECT_EQ(size_t(0), multiTree.count(5));
+	EXPECT_EQ("before first", multiTree.find(1)->second);
+	std::vector<std::string> duplicates;
+	auto range = multiTree.equal_range(1);
+	for (auto it = range.first; it != range.second; ++it)
+		duplicates.push_back(it->second);
+	EXPECT_EQ(std::vector<std::string>({ "before first", "first", "second", "third" }), duplicates);
+	EXPECT_EQ(2, range.second->first);
+
+	EXPECT_EQ(size_t(4), multiTree.remove(1));
+	EXPECT_EQ(size_t(0), multiTree.remove(1));
+	EXPECT_TRUE(multiTree.isValid());
+	EXPECT_EQ(size_t(2), multiTree.size());
+
+	std::vector<std::pair<int, std::string> > sorted = { { 1, "a" }, { 2, "b" }, { 2, "c" }, { 2, "d" }, { 3, "e" } };
+	multiTree.assignSorted(sorted.begin(), sorted.end());
+	EXPECT_TRUE(multiTree.isValid());
+	EXPECT_EQ(size_t(3), multiTree.count(2));
+	IntStringMultiTree right;
+	multiTree.split(2, right);
+	EXPECT_TRUE(multiTree.isValid());
+	EXPECT_TRUE(right.isValid());
+	EXPECT_EQ(size_t(1), multiTree.size());
+	EXPECT_EQ("b", right.begin()->second);
+	multiTree.join(1, "f", right);
+	EXPECT_TRUE(multiTree.isValid());
+	EXPECT_EQ(size_t(6), multiTree.size());
+	EXPECT_EQ(size_t(2), multiTree.count(1));
+	EXPECT_EQ(size_t(3), multiTree.count(2));
+
+	//unique tree counts and ranges at most one item
+	IntStringRBTree rbTree;
+	rbTree.insert(1, "first");
+	rbTree.insert(1, "second");
+	EXPECT_EQ(size_t(1), rbTree.count(1));
+	EXPECT_EQ(size_t(0), rbTree.count(2));
+	EXPECT_THROW(rbTree.assignSorted(sorted.begin(), sorted.end()), std::invalid_argument);
+}
+
+TEST(RED_BLACK_TREE, MultiTreeMatchesMultimapTest)
+{
+	RedBlackMultiTree<int, int, std::less<int>, std::allocator<std::pair<const int, int> >, ExclusiveOwnership, WithOrderStatistics> multiTree;
+	std::multimap<int, int> expected;
+	srand(23);
+	for (int step = 0; step < 20000; step++)
+	{
+		int key = rand() % 200;
+		switch (rand() % 5)
+		{
+		case 0:
+		case 1:
+			multiTree.insert(key, step);
+			expected.insert(std::make_pair(key, step));
+			break;
+		case 2:
+			multiTree.insert(multiTree.upper_bound(key), key, step);
+			expected.insert(expected.upper_bound(key), std::make_pair(key, step));
+			break;
+		case 3:
+			if (rand() % 8 == 0)
+			{
+				ASSERT_EQ(expected.erase(key), multiTree.remove(key));
+			}
+			break;
+		default:
+			ASSERT_EQ(expected.count(key), multiTree.count(key));
+			ASSERT_EQ(expected.count(key), multiTree.rank(key + 1) - multiTree.rank(key));
+			break;
+		}
+		if (step % 1000 == 0)
+		{
+			ASSERT_TRUE(multiTree.isValid());
+		}
+	}
+	ASSERT_TRUE(multiTree.isValid());
+	ASSERT_EQ(expected.size(), multiTree.size());
+	ASSERT_TRUE(std::equal(expected.begin(), expected.end(), multiTree.begin()));
+
+	std::vector<int> keys = { 5, 7, 5, 199 };
+	size_t expectedRemoved = expected.count(5) + expected.count(7) + expected.count(199);
+	EXPECT_EQ(expectedRemoved, multiTree.removeBatch(keys.begin(), keys.end()));
+	std::vector<std::pair<int, int> > items = { { 7, 1 }, { 7, 2 }, { 6, 3 }, { 7, 3 } };
+	EXPECT_EQ(items.size(), multiTree.insertBatch(items.begin(), items.end()));
+	EXPECT_TRUE(multiTree.isValid());
+	EXPECT_EQ(size_t(3), multiTree.count(7));
+	EXPECT_EQ(3, (--multiTree.equal_range(7).second)->second);
+}
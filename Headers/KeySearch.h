@@ -0,0 +1,178 @@
+#pragma once
+#ifndef KEY_SEARCH_H
+#define KEY_SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include "Mutex.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KEY_SEARCH_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/// hint to load cache line of given address, the address is not dereferenced and may lie outside of any object
+inline void prefetchRead(std::uintptr_t aAddress)
+{
+#ifdef _MSC_VER
+	_mm_prefetch(reinterpret_cast<const char*>(aAddress), _MM_HINT_T0);
+#else
+	__builtin_prefetch(reinterpret_cast<const void*>(aAddress));
+#endif
+}
+
+/// count of lowest zero bits, aValue must not be 0
+inline unsigned countTrailingZeros(size_t aValue)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+#ifdef _WIN64
+	_BitScanForward64(&index, aValue);
+#else
+	_BitScanForward(&index, aValue);
+#endif
+	return unsigned(index);
+#else
+	return unsigned(__builtin_ctzll(aValue));
+#endif
+}
+
+/// Search in a short sorted array of keys, e.g. keys of one tree node.
+/// Keys are searched binary by the comparator. Arithmetic keys ordered by std::less are
+/// counted without branches instead: the count of keys less than the searched one is
+/// its lower bound, and the count is taken by SIMD compares of several keys at once.
+template<typename KEY, typename COMPARE, bool IS_COUNTED = std::is_arithmetic<KEY>::value &&
+	(std::is_same<COMPARE, std::less<KEY> >::value || std::is_same<COMPARE, std::less<> >::value)>
+struct KeySearch
+{
+	/// index of first key not less than given one
+	static size_t lowerBound(const KEY* aKeys, size_t aCount, const KEY& aKey, const COMPARE& aCompare)
+	{
+		size_t low = 0;
+		while (aCount > 0)
+		{
+			size_t half = aCount / 2;
+			if (aCompare(aKeys[low + half], aKey))
+			{
+				low += half + 1;
+				aCount -= half + 1;
+			}
+			else
+				aCount = half;
+		}
+		return low;
+	}
+	/// index of first key greater than given one
+	static size_t upperBound(const KEY* aKeys, size_t aCount, const KEY& aKey, const COMPARE& aCompare)
+	{
+		size_t low = 0;
+		while (aCount > 0)
+		{
+			size_t half = aCount / 2;
+			if (!aCompare(aKey, aKeys[low + half]))
+			{
+				low += half + 1;
+				aCount -= half + 1;
+			}
+			else
+				aCount = half;
+		}
+		return low;
+	}
+};
+
+template<typename KEY, typename COMPARE>
+struct KeySearch<KEY, COMPARE, true>
+{
+	static size_t lowerBound(const KEY* aKeys, size_t aCount, const KEY& aKey, const COMPARE& aCompare)
+	{
+		UNREF_PAR(aCompare);
+		return countLess(aKeys, aCount, aKey);
+	}
+	static size_t upperBound(const KEY* aKeys, size_t aCount, const KEY& aKey, const COMPARE& aCompare)
+	{
+		UNREF_PAR(aCompare);
+		return aCount - countGreater(aKeys, aCount, aKey);
+	}
+private:
+	//plain loops without branches are vectorized by the compiler
+	template<typename T>
+	static size_t countLess(const T* aKeys, size_t aCount, const T& aKey)
+	{
+		size_t count = 0;
+		for (size_t i = 0; i < aCount; i++)
+			count += aKeys[i] < aKey ? 1 : 0;
+		return count;
+	}
+	template<typename T>
+	static size_t countGreater(const T* aKeys, size_t aCount, const T& aKey)
+	{
+		size_t count = 0;
+		for (size_t i = 0; i < aCount; i++)
+			count += aKey < aKeys[i] ? 1 : 0;
+		return count;
+	}
+#ifdef KEY_SEARCH_SSE2
+	//true lanes of compare are -1, so subtracting them counts them
+	static size_t sumLanes(__m128i aCounts)
+	{
+		int lanes[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), aCounts);
+		return size_t(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+	}
+	static size_t countLess(const int* aKeys, size_t aCount, const int& aKey)
+	{
+		__m128i key = _mm_set1_epi32(aKey);
+		__m128i counts = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 4 <= aCount; i += 4)
+			counts = _mm_sub_epi32(counts, _mm_cmplt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(aKeys + i)), key));
+		size_t count = sumLanes(counts);
+		for (; i < aCount; i++)
+			count += aKeys[i] < aKey ? 1 : 0;
+		return count;
+	}
+	static size_t countGreater(const int* aKeys, size_t aCount, const int& aKey)
+	{
+		__m128i key = _mm_set1_epi32(aKey);
+		__m128i counts = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 4 <= aCount; i += 4)
+			counts = _mm_sub_epi32(counts, _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(aKeys + i)), key));
+		size_t count = sumLanes(counts);
+		for (; i < aCount; i++)
+			count += aKey < aKeys[i] ? 1 : 0;
+		return count;
+	}
+	static size_t countLess(const float* aKeys, size_t aCount, const float& aKey)
+	{
+		__m128 key = _mm_set1_ps(aKey);
+		__m128i counts = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 4 <= aCount; i += 4)
+			counts = _mm_sub_epi32(counts, _mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(aKeys + i), key)));
+		size_t count = sumLanes(counts);
+		for (; i < aCount; i++)
+			count += aKeys[i] < aKey ? 1 : 0;
+		return count;
+	}
+	static size_t countGreater(const float* aKeys, size_t aCount, const float& aKey)
+	{
+		__m128 key = _mm_set1_ps(aKey);
+		__m128i counts = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 4 <= aCount; i += 4)
+			counts = _mm_sub_epi32(counts, _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(aKeys + i), key)));
+		size_t count = sumLanes(counts);
+		for (; i < aCount; i++)
+			count += aKey < aKeys[i] ? 1 : 0;
+		return count;
+	}
+#endif
+};
+
+#endif // !KEY_SEARCH_H
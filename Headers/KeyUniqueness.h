@@ -0,0 +1,21 @@
+#pragma once
+#ifndef KEY_UNIQUENESS_H
+#define KEY_UNIQUENESS_H
+
+/// Key uniqueness policies decide whether a tree keeps more items with equal keys.
+/// AllowsDuplicates - equal keys are kept; such items follow each other in insertion order,
+/// find and remove by key address all of them, operator[] and insert_or_assign are not available.
+
+/// Item with a present key is not inserted, as in std::map.
+struct UniqueKeys
+{
+	static const bool AllowsDuplicates = false;
+};
+
+/// Every item is inserted after the items with equal key, as in std::multimap.
+struct DuplicateKeys
+{
+	static const bool AllowsDuplicates = true;
+};
+
+#endif // !KEY_UNIQUENESS_H
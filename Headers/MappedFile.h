@@ -0,0 +1,129 @@
+#pragma once
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// Whole file mapped to memory. Opened file is mapped read-only with pages private to the process,
+/// so pages are loaded on first access and shared with the page cache until written.
+/// Created file is mapped writable and its content reaches the file when the mapping is closed.
+class MappedFile
+{
+public:
+	/// map existing file for reading, throws runtime_error if it cannot be mapped
+	static std::shared_ptr<MappedFile> open(const std::string& aPath) { return std::shared_ptr<MappedFile>(new MappedFile(aPath, 0, false)); }
+	/// create or truncate file to given size and map it for writing
+	static std::shared_ptr<MappedFile> create(const std::string& aPath, size_t aSize) { return std::shared_ptr<MappedFile>(new MappedFile(aPath, aSize, true)); }
+	~MappedFile() { close(); }
+	const char* data() const { return mData; }
+	char* data() { return mData; }
+	size_t size() const { return mSize; }
+private:
+	char* mData;
+	size_t mSize;
+#ifdef _WIN32
+	HANDLE mFile;
+	HANDLE mMapping;
+#else
+	int mFile;
+#endif
+
+	MappedFile(const std::string& aPath, size_t aSize, bool aIsWritable)
+		: mData(NULL), mSize(aSize)
+	{
+#ifdef _WIN32
+		mMapping = NULL;
+		mFile = CreateFileA(aPath.c_str(), aIsWritable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, NULL,
+			aIsWritable ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (mFile == INVALID_HANDLE_VALUE)
+			throw std::runtime_error(std::string("Cannot open file ") + aPath);
+		if (!aIsWritable)
+		{
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(mFile, &size))
+			{
+				close();
+				throw std::runtime_error(std::string("Cannot read size of file ") + aPath);
+			}
+			mSize = size_t(size.QuadPart);
+		}
+		if (mSize == 0)
+			return;
+		unsigned long long size = mSize;
+		mMapping = CreateFileMappingA(mFile, NULL, aIsWritable ? PAGE_READWRITE : PAGE_WRITECOPY, DWORD(size >> 32), DWORD(size), NULL);
+		if (mMapping != NULL)
+			mData = static_cast<char*>(MapViewOfFile(mMapping, aIsWritable ? FILE_MAP_WRITE : FILE_MAP_COPY, 0, 0, mSize));
+#else
+		mFile = ::open(aPath.c_str(), aIsWritable ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+		if (mFile < 0)
+			throw std::runtime_error(std::string("Cannot open file ") + aPath);
+		if (aIsWritable)
+		{
+			if (ftruncate(mFile, off_t(mSize)) != 0)
+			{
+				close();
+				throw std::runtime_error(std::string("Cannot resize file ") + aPath);
+			}
+		}
+		else
+		{
+			struct stat status;
+			if (fstat(mFile, &status) != 0)
+			{
+				close();
+				throw std::runtime_error(std::string("Cannot read size of file ") + aPath);
+			}
+			mSize = size_t(status.st_size);
+		}
+		if (mSize == 0)
+			return;
+		void* data = mmap(NULL, mSize, aIsWritable ? PROT_READ | PROT_WRITE : PROT_READ, aIsWritable ? MAP_SHARED : MAP_PRIVATE, mFile, 0);
+		if (data != MAP_FAILED)
+			mData = static_cast<char*>(data);
+#endif
+		if (mData == NULL)
+		{
+			close();
+			throw std::runtime_error(std::string("Cannot map file ") + aPath);
+		}
+	}
+	void close()
+	{
+#ifdef _WIN32
+		if (mData != NULL)
+			UnmapViewOfFile(mData);
+		if (mMapping != NULL)
+			CloseHandle(mMapping);
+		if (mFile != INVALID_HANDLE_VALUE)
+			CloseHandle(mFile);
+		mMapping = NULL;
+		mFile = INVALID_HANDLE_VALUE;
+#else
+		if (mData != NULL)
+			munmap(mData, mSize);
+		if (mFile >= 0)
+			::close(mFile);
+		mFile = -1;
+#endif
+		mData = NULL;
+	}
+
+	MappedFile(const MappedFile&);
+	void operator = (const MappedFile&);
+};
+
+#endif // !MAPPED_FILE_H
@@ -0,0 +1,136 @@
+#pragma once
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <new>
+
+/// Pool of fixed size blocks. Blocks are carved from contiguous chunks and freed blocks
+/// are recycled through a free list, so nodes of one container stay close in memory.
+/// Block size is fixed by the first allocation.
+class NodePool
+{
+public:
+	NodePool(size_t aBlocksPerChunk = 1024)
+		: mBlocksPerChunk(aBlocksPerChunk > 0 ? aBlocksPerChunk : 1), mBlockSize(0), mAlignment(0),
+		mChunks(NULL), mFreeList(NULL), mNextFree(NULL), mChunkEnd(NULL), mUsedBlocks(0) {}
+	~NodePool() { release(); }
+
+	/// true if block of given size and alignment can be served by this pool
+	bool fits(size_t aSize, size_t aAlignment) const
+	{
+		return mBlockSize == 0 || (aSize <= mBlockSize && mAlignment % aAlignment == 0);
+	}
+	/// get block from free list or from current chunk
+	void* allocate(size_t aSize, size_t aAlignment)
+	{
+		if (mBlockSize == 0)
+			init(aSize, aAlignment);
+		else if (!fits(aSize, aAlignment))
+			throw std::bad_alloc();
+		mUsedBlocks++;
+		if (mFreeList != NULL)
+		{
+			FreeBlock* block = mFreeList;
+			mFreeList = block->Next;
+			return block;
+		}
+		if (mNextFree == mChunkEnd)
+			addChunk();
+		void* block = mNextFree;
+		mNextFree += mBlockSize;
+		return block;
+	}
+	/// return block to free list
+	void deallocate(void* aP)
+	{
+		FreeBlock* block = static_cast<FreeBlock*>(aP);
+		block->Next = mFreeList;
+		mFreeList = block;
+		mUsedBlocks--;
+	}
+	/// free all chunks at once, blocks handed out before become invalid
+	void release()
+	{
+		while (mChunks != NULL)
+		{
+			Chunk* next = mChunks->Next;
+			::operator delete(mChunks);
+			mChunks = next;
+		}
+		mFreeList = NULL;
+		mNextFree = mChunkEnd = NULL;
+		mUsedBlocks = 0;
+	}
+	size_t blockSize() const { return mBlockSize; }
+	/// count of blocks handed out and not returned yet
+	size_t usedBlocks() const { return mUsedBlocks; }
+private:
+	struct FreeBlock { FreeBlock* Next; };
+	struct Chunk { Chunk* Next; };
+
+	size_t mBlocksPerChunk;
+	size_t mBlockSize;
+	size_t mAlignment;
+	Chunk* mChunks;
+	FreeBlock* mFreeList;
+	char* mNextFree;
+	char* mChunkEnd;
+	size_t mUsedBlocks;
+
+	void init(size_t aSize, size_t aAlignment)
+	{
+		mAlignment = aAlignment < alignof(FreeBlock) ? alignof(FreeBlock) : aAlignment;
+		size_t size = aSize < sizeof(FreeBlock) ? sizeof(FreeBlock) : aSize;
+		mBlockSize = (size + mAlignment - 1) / mAlignment * mAlignment;
+	}
+	void addChunk()
+	{
+		size_t headerSize = (sizeof(Chunk) + mAlignment - 1) / mAlignment * mAlignment;
+		char* memory = static_cast<char*>(::operator new(headerSize + mBlockSize * mBlocksPerChunk));
+		Chunk* chunk = reinterpret_cast<Chunk*>(memory);
+		chunk->Next = mChunks;
+		mChunks = chunk;
+		mNextFree = memory + headerSize;
+		mChunkEnd = mNextFree + mBlockSize * mBlocksPerChunk;
+	}
+
+	NodePool(const NodePool&);
+	void operator = (const NodePool&);
+};
+
+/// Standard compatible allocator serving single objects from NodePool, arrays go to global heap.
+template< class T >
+class PoolAllocator
+{
+public:
+	typedef T value_type;
+
+	PoolAllocator(NodePool& aPool) : mPool(&aPool) {}
+	template< class U >
+	PoolAllocator(const PoolAllocator<U>& aOther) : mPool(aOther.pool()) {}
+
+	T* allocate(size_t aCount)
+	{
+		if (aCount == 1 && mPool->fits(sizeof(T), alignof(T)))
+			return static_cast<T*>(mPool->allocate(sizeof(T), alignof(T)));
+		return static_cast<T*>(::operator new(aCount * sizeof(T)));
+	}
+	void deallocate(T* aP, size_t aCount)
+	{
+		if (aCount == 1 && mPool->fits(sizeof(T), alignof(T)))
+			mPool->deallocate(aP);
+		else
+			::operator delete(aP);
+	}
+	NodePool* pool() const { return mPool; }
+
+	template< class U >
+	bool operator== (const PoolAllocator<U>& aOther) const { return mPool == aOther.pool(); }
+	template< class U >
+	bool operator!= (const PoolAllocator<U>& aOther) const { return mPool != aOther.pool(); }
+private:
+	NodePool* mPool;
+};
+
+#endif // !NODE_POOL_H
@@ -0,0 +1,115 @@
+#pragma once
+#ifndef OPERATION_COUNTERS_H
+#define OPERATION_COUNTERS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include "Mutex.h"
+
+/// Counts of tree operations, all zero when the tree does not count them.
+struct OperationCounts
+{
+	OperationCounts() : Comparisons(0), Rotations(0), Recolorings(0), Allocations(0), Frees(0) {}
+	size_t Comparisons;
+	size_t Rotations;
+	size_t Recolorings;
+	size_t Allocations;
+	size_t Frees;
+	/// SearchLengths[i] - count of searches which visited i nodes
+	std::vector<size_t> SearchLengths;
+};
+
+/// Shape of a tree and counts of its operations.
+struct TreeStatistics
+{
+	TreeStatistics() : Count(0), Height(0), BlackHeight(0), BytesPerEntry(0) {}
+	size_t Count;
+	/// nodes on the longest path from the root
+	size_t Height;
+	/// black nodes on every path from the root
+	size_t BlackHeight;
+	/// node and tree object bytes per item, without allocator overhead
+	double BytesPerEntry;
+	OperationCounts Operations;
+};
+
+/// Operation counter policies decide whether a tree counts its operations. The tree derives
+/// from the policy, so counters are kept per tree and the empty policy takes no space.
+/// countComparison, countRotation, countRecolorings, countAllocation, countFree, countSearch - record an operation,
+/// counts - copy of the counters, reset - zeroes them.
+
+/// Nothing is counted, every call is empty and compiled out.
+struct WithoutOperationCounters
+{
+	static const bool IsCounting = false;
+
+	void countComparison() const {}
+	void countRotation() {}
+	void countRecolorings(size_t aCount) { UNREF_PAR(aCount); }
+	void countAllocation() {}
+	void countFree() {}
+	void countSearch(size_t aLength) const { UNREF_PAR(aLength); }
+	OperationCounts counts() const { return OperationCounts(); }
+	void reset() {}
+};
+
+/// Every operation increments its counter. Counters are relaxed atomics incremented by a separate
+/// load and store, which costs no locked instruction; concurrent readers or parallel set operations
+/// of one tree may lose some counts, but never race.
+struct WithOperationCounters
+{
+	static const bool IsCounting = true;
+	/// longer searches are counted in the last bucket
+	static const size_t SearchLengthsCount = 128;
+
+	WithOperationCounters() { reset(); }
+	void countComparison() const { increment(mComparisons, 1); }
+	void countRotation() { increment(mRotations, 1); }
+	void countRecolorings(size_t aCount) { increment(mRecolorings, aCount); }
+	void countAllocation() { increment(mAllocations, 1); }
+	void countFree() { increment(mFrees, 1); }
+	void countSearch(size_t aLength) const { increment(mSearchLengths[aLength < SearchLengthsCount ? aLength : SearchLengthsCount - 1], 1); }
+	OperationCounts counts() const
+	{
+		OperationCounts counts;
+		counts.Comparisons = mComparisons.load(std::memory_order_relaxed);
+		counts.Rotations = mRotations.load(std::memory_order_relaxed);
+		counts.Recolorings = mRecolorings.load(std::memory_order_relaxed);
+		counts.Allocations = mAllocations.load(std::memory_order_relaxed);
+		counts.Frees = mFrees.load(std::memory_order_relaxed);
+		size_t length = SearchLengthsCount;
+		while (length > 0 && mSearchLengths[length - 1].load(std::memory_order_relaxed) == 0)
+			length--;
+		for (size_t i = 0; i < length; i++)
+			counts.SearchLengths.push_back(mSearchLengths[i].load(std::memory_order_relaxed));
+		return counts;
+	}
+	void reset()
+	{
+		mComparisons.store(0, std::memory_order_relaxed);
+		mRotations.store(0, std::memory_order_relaxed);
+		mRecolorings.store(0, std::memory_order_relaxed);
+		mAllocations.store(0, std::memory_order_relaxed);
+		mFrees.store(0, std::memory_order_relaxed);
+		for (size_t i = 0; i < SearchLengthsCount; i++)
+			mSearchLengths[i].store(0, std::memory_order_relaxed);
+	}
+private:
+	mutable std::atomic<size_t> mComparisons;
+	std::atomic<size_t> mRotations;
+	std::atomic<size_t> mRecolorings;
+	std::atomic<size_t> mAllocations;
+	std::atomic<size_t> mFrees;
+	mutable std::array<std::atomic<size_t>, SearchLengthsCount> mSearchLengths;
+
+	static void increment(std::atomic<size_t>& aCounter, size_t aCount)
+	{
+		aCounter.store(aCounter.load(std::memory_order_relaxed) + aCount, std::memory_order_relaxed);
+	}
+	WithOperationCounters(const WithOperationCounters&);
+	void operator = (const WithOperationCounters&);
+};
+
+#endif // !OPERATION_COUNTERS_H
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef ORDER_STATISTICS_H
+#define ORDER_STATISTICS_H
+
+#include <cstddef>
+#include "Mutex.h"
+
+/// Order statistics policies decide whether tree nodes count the nodes of their subtree.
+/// NodeBase - wraps node base of the ownership policy, update - recomputes the count of node
+/// from its children, increment/decrement - count node added or removed below, isConsistent - checks the count,
+/// size - count of nodes in the subtree of node, 0 if the policy keeps no count.
+/// Counts of the sentinel and of leaves stay 0, so children can be read without testing for a leaf.
+
+/// Nodes carry no count, the node layout is the one of the ownership policy alone.
+struct WithoutOrderStatistics
+{
+	static const bool HasSubtreeSize = false;
+
+	template< class BASE >
+	using NodeBase = BASE;
+
+	template< class NODE >
+	static void update(NODE* aNode) { UNREF_PAR(aNode); }
+	template< class NODE >
+	static void increment(NODE* aNode) { UNREF_PAR(aNode); }
+	template< class NODE >
+	static void decrement(NODE* aNode) { UNREF_PAR(aNode); }
+	template< class NODE >
+	static bool isConsistent(const NODE* aNode) { UNREF_PAR(aNode); return true; }
+	template< class NODE >
+	static size_t size(const NODE* aNode) { UNREF_PAR(aNode); return 0; }
+};
+
+/// Every node keeps the count of nodes in its subtree, which allows rank and select in O(log n).
+struct WithOrderStatistics
+{
+	static const bool HasSubtreeSize = true;
+
+	template< class BASE >
+	struct NodeBase : public BASE
+	{
+		template< class ALLOCATOR >
+		NodeBase(const ALLOCATOR& aAllocator) : BASE(aAllocator), SubtreeSize(0) {}
+		size_t SubtreeSize;
+	};
+
+	template< class NODE >
+	static void update(NODE* aNode) { aNode->SubtreeSize = aNode->Left->SubtreeSize + aNode->Right->SubtreeSize + 1; }
+	template< class NODE >
+	static void increment(NODE* aNode) { aNode->SubtreeSize++; }
+	template< class NODE >
+	static void decrement(NODE* aNode) { aNode->SubtreeSize--; }
+	template< class NODE >
+	static bool isConsistent(const NODE* aNode) { return aNode->SubtreeSize == aNode->Left->SubtreeSize + aNode->Right->SubtreeSize + 1; }
+	template< class NODE >
+	static size_t size(const NODE* aNode) { return aNode->SubtreeSize; }
+};
+
+#endif // !ORDER_STATISTICS_H
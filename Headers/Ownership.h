@@ -0,0 +1,83 @@
+#pragma once
+#ifndef OWNERSHIP_H
+#define OWNERSHIP_H
+
+#include <memory>
+#include "Mutex.h"
+#include "Pointer.h"
+
+/// Ownership policies decide how container links hold nodes.
+/// Link - type of pointer between nodes, Guard - keeps node alive while it is relinked,
+/// NodeBase - base of every node, release - frees node after it was unlinked from container.
+
+/// Container exclusively owns its nodes. Links are raw pointers and nodes carry no counter,
+/// iterators are invalidated by removing their node.
+struct ExclusiveOwnership
+{
+	static const bool IsRefCounted = false;
+
+	template< class T >
+	using Link = T*;
+
+	template< class T >
+	struct Guard
+	{
+		Guard(T* aP) { UNREF_PAR(aP); }
+	};
+
+	template< class NODE, class ALLOCATOR >
+	struct NodeBase
+	{
+		NodeBase(const ALLOCATOR& aAllocator) { UNREF_PAR(aAllocator); }
+	};
+
+	template< class NODE, class ALLOCATOR >
+	static void release(NODE* aNode, ALLOCATOR& aAllocator)
+	{
+		std::allocator_traits<ALLOCATOR>::destroy(aAllocator, aNode);
+		std::allocator_traits<ALLOCATOR>::deallocate(aAllocator, aNode, 1);
+	}
+};
+
+/// Nodes are reference counted by links and iterators, so an iterator keeps its node alive
+/// after the node was removed from container. Node keeps a copy of the allocator (empty for
+/// stateless allocators) to free itself when the last reference is dropped.
+struct RefCountedOwnership
+{
+	static const bool IsRefCounted = true;
+
+	template< class T >
+	using Link = AutoRefPtr<T>;
+
+	template< class T >
+	using Guard = AutoRefPtr<T>;
+
+	template< class NODE, class ALLOCATOR >
+	class NodeBase : private ALLOCATOR
+	{
+	public:
+		NodeBase(const ALLOCATOR& aAllocator) : ALLOCATOR(aAllocator), mRefCount(0) {}
+
+		/// count of links and iterators holding node
+		int references() const { return mRefCount.get(); }
+		void reference() { mRefCount.reference(); }
+		void dereference()
+		{
+			if (mRefCount.dereference())
+			{
+				ALLOCATOR allocator(*this);
+				NODE* node = static_cast<NODE*>(this);
+				std::allocator_traits<ALLOCATOR>::destroy(allocator, node);
+				std::allocator_traits<ALLOCATOR>::deallocate(allocator, node, 1);
+			}
+		}
+	private:
+		RefCount mRefCount;
+	};
+
+	/// node is freed by its last reference
+	template< class NODE, class ALLOCATOR >
+	static void release(NODE* aNode, ALLOCATOR& aAllocator) { UNREF_PAR(aNode); UNREF_PAR(aAllocator); }
+};
+
+#endif // !OWNERSHIP_H
@@ -2,13 +2,16 @@
 #ifndef POINTER_H
 #define POINTER_H
 
+#include <cstddef>
+#include <utility>
+
 template< class T >
 class AutoRefPtr
 {
 public:
 	AutoRefPtr() { mP = NULL; }
 	AutoRefPtr(T* aP) { mP = aP; if (mP) mP->reference(); }
-	AutoRefPtr(T* aP, bool aDontReference) { UNREF_PAR(aDontReference) mP = aP; }
+	AutoRefPtr(T* aP, bool aDontReference) { UNREF_PAR(aDontReference); mP = aP; }
 	AutoRefPtr(const AutoRefPtr<T>& aP) { mP = aP.mP; if (mP) mP->reference(); }
 	~AutoRefPtr() { if (mP) mP->dereference(); }
 
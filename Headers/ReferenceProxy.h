@@ -0,0 +1,15 @@
+#pragma once
+#ifndef REFERENCE_PROXY_H
+#define REFERENCE_PROXY_H
+
+/// Result of operator-> of iterators over containers which keep keys apart from values,
+/// so they return a pair of references instead of a reference to a stored pair.
+template< class REFERENCE >
+struct ReferenceProxy
+{
+	REFERENCE Value;
+	explicit ReferenceProxy(const REFERENCE& aValue) : Value(aValue) {}
+	const REFERENCE* operator->() const { return &Value; }
+};
+
+#endif // !REFERENCE_PROXY_H
@@ -0,0 +1,202 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Fork-join pool with work stealing. Every worker owns a deque of forked tasks, takes
+/// the newest one itself and steals the oldest one from others. Threads outside the pool
+/// fork into a shared deque. A thread waiting for its forked task runs other tasks meanwhile,
+/// so nested invoke never blocks the pool.
+class ThreadPool
+{
+public:
+	/// aThreadsCount 0 means one worker per hardware thread except the calling one
+	explicit ThreadPool(size_t aThreadsCount = 0)
+		: mIsStopped(false), mPending(0)
+	{
+		if (aThreadsCount == 0)
+		{
+			unsigned hardwareThreads = std::thread::hardware_concurrency();
+			aThreadsCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+		//last queue belongs to threads outside the pool
+		for (size_t i = 0; i <= aThreadsCount; i++)
+			mQueues.push_back(std::unique_ptr<Queue>(new Queue()));
+		for (size_t i = 0; i < aThreadsCount; i++)
+			mWorkers.push_back(std::thread(&ThreadPool::work, this, i));
+	}
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mSleepMutex);
+			mIsStopped = true;
+		}
+		mWakeUp.notify_all();
+		for (size_t i = 0; i < mWorkers.size(); i++)
+			mWorkers[i].join();
+	}
+	/// pool shared by containers which are not given one
+	static ThreadPool& instance()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+	size_t threadsCount() const { return mWorkers.size(); }
+
+	/// run both functions, the second one possibly on another thread, return when both finished;
+	/// exception of either function is rethrown after both finished
+	template< class FIRST, class SECOND >
+	void invoke(FIRST&& aFirst, SECOND&& aSecond)
+	{
+		Task task(std::forward<SECOND>(aSecond));
+		size_t queue = currentQueue();
+		push(queue, &task);
+		std::exception_ptr error;
+		try
+		{
+			aFirst();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+		if (takeBack(queue, &task))
+			execute(&task);
+		while (!task.IsDone.load(std::memory_order_acquire))
+		{
+			Task* other = findTask(queue);
+			if (other != NULL)
+				execute(other);
+			else
+				std::this_thread::yield();
+		}
+		if (error)
+			std::rethrow_exception(error);
+		if (task.Error)
+			std::rethrow_exception(task.Error);
+	}
+private:
+	struct Task
+	{
+		template< class FUNCTION >
+		Task(FUNCTION&& aFunction) : Run(std::forward<FUNCTION>(aFunction)), IsDone(false) {}
+		std::function<void()> Run;
+		std::exception_ptr Error;
+		std::atomic<bool> IsDone;
+	};
+	struct Queue
+	{
+		std::mutex Mutex;
+		std::deque<Task*> Tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue> > mQueues;
+	std::vector<std::thread> mWorkers;
+	std::mutex mSleepMutex;
+	std::condition_variable mWakeUp;
+	bool mIsStopped;
+	std::atomic<size_t> mPending;
+
+	/// pool and queue of the calling worker thread
+	static ThreadPool*& currentPool() { static thread_local ThreadPool* pool = NULL; return pool; }
+	static size_t& currentIndex() { static thread_local size_t index = 0; return index; }
+	size_t currentQueue() const { return currentPool() == this ? currentIndex() : mWorkers.size(); }
+
+	void push(size_t aQueue, Task* aTask)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mQueues[aQueue]->Mutex);
+			mQueues[aQueue]->Tasks.push_back(aTask);
+			mPending++;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mSleepMutex);
+		}
+		mWakeUp.notify_one();
+	}
+	bool takeBack(size_t aQueue, Task* aTask)
+	{
+		std::lock_guard<std::mutex> lock(mQueues[aQueue]->Mutex);
+		std::deque<Task*>& tasks = mQueues[aQueue]->Tasks;
+		std::deque<Task*>::iterator it = std::find(tasks.begin(), tasks.end(), aTask);
+		if (it == tasks.end())
+			return false;
+		tasks.erase(it);
+		mPending--;
+		return true;
+	}
+	/// newest task of own queue, otherwise the oldest one of another queue
+	Task* findTask(size_t aQueue)
+	{
+		if (mPending.load() == 0)
+			return NULL;
+		for (size_t i = 0; i < mQueues.size(); i++)
+		{
+			size_t index = (aQueue + i) % mQueues.size();
+			std::lock_guard<std::mutex> lock(mQueues[index]->Mutex);
+			std::deque<Task*>& tasks = mQueues[index]->Tasks;
+			if (tasks.empty())
+				continue;
+			Task* task;
+			if (i == 0)
+			{
+				task = tasks.back();
+				tasks.pop_back();
+			}
+			else
+			{
+				task = tasks.front();
+				tasks.pop_front();
+			}
+			mPending--;
+			return task;
+		}
+		return NULL;
+	}
+	static void execute(Task* aTask)
+	{
+		try
+		{
+			aTask->Run();
+		}
+		catch (...)
+		{
+			aTask->Error = std::current_exception();
+		}
+		aTask->IsDone.store(true, std::memory_order_release);
+	}
+	void work(size_t aIndex)
+	{
+		currentPool() = this;
+		currentIndex() = aIndex;
+		while (true)
+		{
+			Task* task = findTask(aIndex);
+			if (task != NULL)
+			{
+				execute(task);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(mSleepMutex);
+			mWakeUp.wait(lock, [this]() { return mIsStopped || mPending.load() > 0; });
+			if (mIsStopped)
+				return;
+		}
+	}
+
+	ThreadPool(const ThreadPool&);
+	void operator = (const ThreadPool&);
+};
+
+#endif // !THREAD_POOL_H
@@ -0,0 +1,761 @@
+#pragma once
+#ifndef B_TREE_MAP_H
+#define B_TREE_MAP_H
+
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "../Headers/KeySearch.h"
+#include "../Headers/ReferenceProxy.h"
+
+//STRUCTURES
+/// B-tree with the interface of RedBlackTree, an alternative for small keys. Node keeps its keys
+/// in one array followed by the array of their values, so a lookup reads a few adjacent cache
+/// lines per level and searches them by KeySearch instead of missing cache on every comparison.
+/// Key and value are not stored together, so iterators return pairs of references. Insert and
+/// remove move items between nodes and invalidate all iterators; keys and values should move without throwing.
+template<typename KEY_TYPE, typename MAPPED_TYPE,
+	typename COMPARE = std::less<KEY_TYPE>,
+	typename ALLOCATOR = std::allocator<std::pair<const KEY_TYPE, MAPPED_TYPE> > >
+class BTreeMap
+{
+	struct LeafNode;
+	struct InternalNode;
+public:
+	typedef KEY_TYPE key_type;
+	typedef MAPPED_TYPE mapped_type;
+	typedef std::pair<const key_type, mapped_type> value_type;
+	typedef std::pair<const key_type&, mapped_type&> reference;
+	typedef std::pair<const key_type&, const mapped_type&> const_reference;
+	typedef COMPARE key_compare;
+	typedef ALLOCATOR allocator_type;
+	typedef typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<LeafNode> leaf_allocator_type;
+	typedef typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<InternalNode> internal_allocator_type;
+	class const_iterator;
+	class iterator;
+	/// keys of one node fill NodeCacheLines cache lines, values follow them
+	static const size_t CacheLineSize = 64;
+	static const size_t NodeCacheLines = 4;
+	static const size_t NodeKeysCount = CacheLineSize * NodeCacheLines / sizeof(key_type) < 3 ? 3
+		: CacheLineSize * NodeCacheLines / sizeof(key_type) > 255 ? 255 : CacheLineSize * NodeCacheLines / sizeof(key_type);
+	/// nodes other than root never hold fewer keys
+	static const size_t MinNodeKeysCount = (NodeKeysCount - 1) / 2;
+	BTreeMap();
+	explicit BTreeMap(const key_compare& compare, const allocator_type& allocator = allocator_type());
+	BTreeMap(const BTreeMap& other);
+	BTreeMap& operator=(const BTreeMap& other);
+	~BTreeMap();
+	void swap(BTreeMap& other);
+	bool isEmpty() const { return mCount == 0; }
+	size_t size() const { return mCount; }
+	allocator_type get_allocator() const { return allocator_type(mAllocator); }
+	key_compare key_comp() const { return mCompare; }
+	iterator insert(const key_type& key, const mapped_type& data) { return try_emplace(key, data).first; }
+	iterator insert(key_type&& key, mapped_type&& data) { return try_emplace(std::move(key), std::move(data)).first; }
+	/// mapped value is constructed from args only if the key is not present
+	template<typename... ARGS>
+	std::pair<iterator, bool> try_emplace(const key_type& key, ARGS&&... args) { return tryEmplace(key, std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	std::pair<iterator, bool> try_emplace(key_type&& key, ARGS&&... args) { return tryEmplace(std::move(key), std::forward<ARGS>(args)...); }
+	template<typename M>
+	std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& data);
+	mapped_type& operator[](const key_type& key) { return try_emplace(key).first->second; }
+	mapped_type& operator[](key_type&& key) { return try_emplace(std::move(key)).first->second; }
+	size_t remove(const key_type& key);
+	void clear();
+	/// true if ordering, node fill and equal depth of leaves hold
+	bool isValid() const;
+	iterator begin() { return iterator(mLeftmost, 0); }
+	iterator end() { return iterator(mRightmost, mRightmost ? mRightmost->Count : 0); }
+	const_iterator begin() const { return const_iterator(mLeftmost, 0); }
+	const_iterator end() const { return const_iterator(mRightmost, mRightmost ? mRightmost->Count : 0); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+	iterator find(const key_type& key) { const_iterator found = findEntry(key); return iterator(found.mNode, found.mPosition); }
+	const_iterator find(const key_type& key) const { return findEntry(key); }
+	/// first item with key not less than given one
+	iterator lower_bound(const key_type& key) { const_iterator found = boundEntry<false>(key); return iterator(found.mNode, found.mPosition); }
+	const_iterator lower_bound(const key_type& key) const { return boundEntry<false>(key); }
+	/// first item with key greater than given one
+	iterator upper_bound(const key_type& key) { const_iterator found = boundEntry<true>(key); return iterator(found.mNode, found.mPosition); }
+	const_iterator upper_bound(const key_type& key) const { return boundEntry<true>(key); }
+private:
+	typedef std::allocator_traits<leaf_allocator_type> leaf_allocator_traits;
+	typedef std::allocator_traits<internal_allocator_type> internal_allocator_traits;
+	typedef KeySearch<key_type, key_compare> key_search_type;
+	leaf_allocator_type mAllocator;
+	key_compare mCompare;
+	size_t mCount;
+	LeafNode* mRoot;
+	LeafNode* mLeftmost;
+	LeafNode* mRightmost;
+
+	LeafNode* createLeaf();
+	InternalNode* createInternal();
+	void destroyNode(LeafNode* node);
+	void destroySubtree(LeafNode* node);
+	LeafNode* copySubtree(const LeafNode* node);
+	size_t lowerBoundIndex(const LeafNode* node, const key_type& key) const { return key_search_type::lowerBound(node->keys(), node->Count, key, mCompare); }
+	size_t upperBoundIndex(const LeafNode* node, const key_type& key) const { return key_search_type::upperBound(node->keys(), node->Count, key, mCompare); }
+	const_iterator findEntry(const key_type& key) const;
+	template<bool IS_UPPER>
+	const_iterator boundEntry(const key_type& key) const;
+	template<typename K, typename... ARGS>
+	std::pair<iterator, bool> tryEmplace(K&& key, ARGS&&... args);
+	std::pair<LeafNode*, size_t> makeRoom(LeafNode* node, size_t index);
+	void insertEntry(LeafNode* node, size_t index, key_type& key, mapped_type& data, LeafNode* rightChild);
+	void removeEntry(LeafNode* node, size_t index);
+	void rebalance(LeafNode* node);
+	void rotateLeft(InternalNode* parent, size_t index);
+	void rotateRight(InternalNode* parent, size_t index);
+	void mergeChildren(InternalNode* parent, size_t index);
+	int checkSubtree(const LeafNode* node, const key_type* low, const key_type* high, size_t& count) const;
+};
+
+/// Leaf holds keys and values in raw storage, only the first Count of them are constructed.
+/// Parent and Position locate the node among children of its parent.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+struct BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::LeafNode
+{
+	InternalNode* Parent;
+	unsigned char Position;
+	unsigned char Count;
+	bool IsLeaf;
+	typename std::aligned_storage<sizeof(key_type) * NodeKeysCount, std::alignment_of<key_type>::value>::type Keys;
+	typename std::aligned_storage<sizeof(mapped_type) * NodeKeysCount, std::alignment_of<mapped_type>::value>::type Values;
+
+	explicit LeafNode(bool isLeaf = true) : Parent(NULL), Position(0), Count(0), IsLeaf(isLeaf) {}
+	key_type* keys() { return reinterpret_cast<key_type*>(&Keys); }
+	const key_type* keys() const { return reinterpret_cast<const key_type*>(&Keys); }
+	mapped_type* values() { return reinterpret_cast<mapped_type*>(&Values); }
+	const mapped_type* values() const { return reinterpret_cast<const mapped_type*>(&Values); }
+	InternalNode* internal() { return static_cast<InternalNode*>(this); }
+	const InternalNode* internal() const { return static_cast<const InternalNode*>(this); }
+	/// move constructed item to raw slot
+	void moveEntry(size_t from, LeafNode* target, size_t to)
+	{
+		::new (static_cast<void*>(target->keys() + to)) key_type(std::move(keys()[from]));
+		::new (static_cast<void*>(target->values() + to)) mapped_type(std::move(values()[from]));
+		destroyEntry(from);
+	}
+	void destroyEntry(size_t index)
+	{
+		keys()[index].~key_type();
+		values()[index].~mapped_type();
+	}
+};
+
+/// Internal node has one child more than keys, keys of child i lie between keys i - 1 and i.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+struct BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::InternalNode : public LeafNode
+{
+	LeafNode* Children[NodeKeysCount + 1];
+
+	InternalNode() : LeafNode(false) {}
+	void setChild(size_t index, LeafNode* child)
+	{
+		Children[index] = child;
+		child->Parent = this;
+		child->Position = static_cast<unsigned char>(index);
+	}
+};
+
+/// Iterator is a node and a position in it, end() is the position after the last item of the rightmost leaf.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+class BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator
+	: public std::iterator<std::bidirectional_iterator_tag,
+	typename BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::value_type,
+	std::ptrdiff_t,
+	ReferenceProxy<typename BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_reference>,
+	typename BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_reference>
+{
+public:
+	const_iterator() : mNode(NULL), mPosition(0) {}
+	const_reference operator*() const
+	{
+		if (!mNode || mPosition >= mNode->Count)
+			throw std::runtime_error(std::string("Cannot be dereferenced"));
+		return const_reference(mNode->keys()[mPosition], mNode->values()[mPosition]);
+	}
+	ReferenceProxy<const_reference> operator->() const
+	{
+		if (!mNode || mPosition >= mNode->Count)
+			throw std::runtime_error(std::string("Cannot be referenced"));
+		return ReferenceProxy<const_reference>(const_reference(mNode->keys()[mPosition], mNode->values()[mPosition]));
+	}
+	const_iterator& operator++() { increment(); return *this; }
+	const_iterator operator++(int) { const_iterator retIt = *this; increment(); return retIt; }
+	const_iterator& operator--() { decrement(); return *this; }
+	const_iterator operator--(int) { const_iterator retIt = *this; decrement(); return retIt; }
+	bool operator==(const const_iterator& right) const { return mNode == right.mNode && mPosition == right.mPosition; }
+	bool operator!=(const const_iterator& right) const { return !(*this == right); }
+protected:
+	LeafNode* mNode;
+	size_t mPosition;
+	friend BTreeMap;
+	const_iterator(const LeafNode* node, size_t position) : mNode(const_cast<LeafNode*>(node)), mPosition(position) {}
+	void increment();
+	void decrement();
+};
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+class BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::iterator : public BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator
+{
+public:
+	typedef ReferenceProxy<typename BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::reference> pointer;
+	typedef typename BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::reference reference;
+	iterator() {}
+	reference operator*() const
+	{
+		const_reference item = const_iterator::operator*();
+		return reference(item.first, const_cast<mapped_type&>(item.second));
+	}
+	pointer operator->() const { return pointer(**this); }
+	iterator& operator++() { this->increment(); return *this; }
+	iterator operator++(int) { iterator retIt = *this; this->increment(); return retIt; }
+	iterator& operator--() { this->decrement(); return *this; }
+	iterator operator--(int) { iterator retIt = *this; this->decrement(); return retIt; }
+private:
+	friend BTreeMap;
+	iterator(LeafNode* node, size_t position) : const_iterator(node, position) {}
+};
+
+//ITERATOR METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator::increment()
+{
+	if (!mNode || mPosition >= mNode->Count)
+		throw std::out_of_range("Iterator cannot be increment.");
+	if (!mNode->IsLeaf)
+	{
+		mNode = mNode->internal()->Children[mPosition + 1];
+		while (!mNode->IsLeaf)
+			mNode = mNode->internal()->Children[0];
+		mPosition = 0;
+		return;
+	}
+	if (++mPosition < mNode->Count)
+		return;
+	//successor of last item of a leaf is the nearest ancestor key on the right
+	LeafNode* node = mNode;
+	while (node->Parent != NULL && node->Position == node->Parent->Count)
+		node = node->Parent;
+	if (node->Parent != NULL)
+	{
+		mPosition = node->Position;
+		mNode = node->Parent;
+	}
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator::decrement()
+{
+	if (!mNode)
+		throw std::out_of_range("Iterator cannot be decrement.");
+	if (!mNode->IsLeaf)
+	{
+		mNode = mNode->internal()->Children[mPosition];
+		while (!mNode->IsLeaf)
+			mNode = mNode->internal()->Children[mNode->Count];
+		mPosition = mNode->Count - 1;
+		return;
+	}
+	if (mPosition > 0)
+	{
+		mPosition--;
+		return;
+	}
+	LeafNode* node = mNode;
+	while (node->Parent != NULL && node->Position == 0)
+		node = node->Parent;
+	if (node->Parent == NULL)
+		throw std::out_of_range("Iterator cannot be decrement.");
+	mPosition = node->Position - 1;
+	mNode = node->Parent;
+}
+
+//PRIVATE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::LeafNode* BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::createLeaf()
+{
+	LeafNode* node = leaf_allocator_traits::allocate(mAllocator, 1);
+	try
+	{
+		leaf_allocator_traits::construct(mAllocator, node);
+	}
+	catch (...)
+	{
+		leaf_allocator_traits::deallocate(mAllocator, node, 1);
+		throw;
+	}
+	return node;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::InternalNode* BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::createInternal()
+{
+	internal_allocator_type allocator(mAllocator);
+	InternalNode* node = internal_allocator_traits::allocate(allocator, 1);
+	try
+	{
+		internal_allocator_traits::construct(allocator, node);
+	}
+	catch (...)
+	{
+		internal_allocator_traits::deallocate(allocator, node, 1);
+		throw;
+	}
+	return node;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::destroyNode(LeafNode* node)
+{
+	if (node->IsLeaf)
+	{
+		leaf_allocator_traits::destroy(mAllocator, node);
+		leaf_allocator_traits::deallocate(mAllocator, node, 1);
+		return;
+	}
+	internal_allocator_type allocator(mAllocator);
+	internal_allocator_traits::destroy(allocator, node->internal());
+	internal_allocator_traits::deallocate(allocator, node->internal(), 1);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::destroySubtree(LeafNode* node)
+{
+	for (size_t i = 0; i < node->Count; i++)
+		node->destroyEntry(i);
+	if (!node->IsLeaf)
+	{
+		for (size_t i = 0; i <= node->Count; i++)
+			destroySubtree(node->internal()->Children[i]);
+	}
+	destroyNode(node);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::LeafNode* BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::copySubtree(const LeafNode* node)
+{
+	//entries and children are counted as they are copied, so a partial copy is destroyed correctly
+	LeafNode* copy = node->IsLeaf ? createLeaf() : createInternal();
+	size_t childrenCount = 0;
+	try
+	{
+		for (size_t i = 0; i <= node->Count; i++)
+		{
+			if (!node->IsLeaf)
+			{
+				copy->internal()->setChild(i, copySubtree(node->internal()->Children[i]));
+				childrenCount++;
+			}
+			if (i == node->Count)
+				break;
+			::new (static_cast<void*>(copy->keys() + i)) key_type(node->keys()[i]);
+			try
+			{
+				::new (static_cast<void*>(copy->values() + i)) mapped_type(node->values()[i]);
+			}
+			catch (...)
+			{
+				copy->keys()[i].~key_type();
+				throw;
+			}
+			copy->Count++;
+		}
+	}
+	catch (...)
+	{
+		for (size_t i = 0; i < copy->Count; i++)
+			copy->destroyEntry(i);
+		for (size_t i = 0; i < childrenCount; i++)
+			destroySubtree(copy->internal()->Children[i]);
+		destroyNode(copy);
+		throw;
+	}
+	return copy;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::findEntry(const key_type& key) const
+{
+	const LeafNode* node = mRoot;
+	while (node != NULL)
+	{
+		size_t index = lowerBoundIndex(node, key);
+		if (index < node->Count && !mCompare(key, node->keys()[index]))
+			return const_iterator(node, index);
+		if (node->IsLeaf)
+			break;
+		node = node->internal()->Children[index];
+	}
+	return end();
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<bool IS_UPPER>
+typename BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::boundEntry(const key_type& key) const
+{
+	//bound is the bound in the leaf, or the nearest ancestor key on the right of the descent
+	const_iterator bound = end();
+	const LeafNode* node = mRoot;
+	while (node != NULL)
+	{
+		size_t index = IS_UPPER ? upperBoundIndex(node, key) : lowerBoundIndex(node, key);
+		if (index < node->Count)
+			bound = const_iterator(node, index);
+		if (node->IsLeaf)
+			break;
+		node = node->internal()->Children[index];
+	}
+	return bound;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename K, typename... ARGS>
+std::pair<typename BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::iterator, bool> BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::tryEmplace(K&& key, ARGS&&... args)
+{
+	LeafNode* node = mRoot;
+	size_t index = 0;
+	while (node != NULL)
+	{
+		index = lowerBoundIndex(node, key);
+		if (index < node->Count && !mCompare(key, node->keys()[index]))
+			return std::make_pair(iterator(node, index), false);
+		if (node->IsLeaf)
+			break;
+		node = node->internal()->Children[index];
+	}
+	//item is constructed before the tree changes, nodes only move it
+	key_type newKey(std::forward<K>(key));
+	mapped_type newData(std::forward<ARGS>(args)...);
+	if (node == NULL)
+	{
+		node = createLeaf();
+		mRoot = mLeftmost = mRightmost = node;
+	}
+	std::pair<LeafNode*, size_t> room = makeRoom(node, index);
+	insertEntry(room.first, room.second, newKey, newData, NULL);
+	mCount++;
+	return std::make_pair(iterator(room.first, room.second), true);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+std::pair<typename BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::LeafNode*, size_t> BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::makeRoom(LeafNode* node, size_t index)
+{
+	if (node->Count < NodeKeysCount)
+		return std::make_pair(node, index);
+	//full node is split around its middle key, which moves to the parent, so the parent needs room first
+	InternalNode* parent;
+	size_t parentIndex;
+	if (node->Parent == NULL)
+	{
+		parent = createInternal();
+		parent->setChild(0, node);
+		mRoot = parent;
+		parentIndex = 0;
+	}
+	else
+	{
+		std::pair<LeafNode*, size_t> parentRoom = makeRoom(node->Parent, node->Position);
+		parent = parentRoom.first->internal();
+		parentIndex = parentRoom.second;
+	}
+	LeafNode* sibling = node->IsLeaf ? createLeaf() : createInternal();
+	const size_t middle = NodeKeysCount / 2;
+	for (size_t i = middle + 1; i < node->Count; i++)
+		node->moveEntry(i, sibling, i - middle - 1);
+	if (!node->IsLeaf)
+	{
+		for (size_t i = middle + 1; i <= node->Count; i++)
+			sibling->internal()->setChild(i - middle - 1, node->internal()->Children[i]);
+	}
+	sibling->Count = static_cast<unsigned char>(node->Count - middle - 1);
+	node->Count = static_cast<unsigned char>(middle);
+	insertEntry(parent, parentIndex, node->keys()[middle], node->values()[middle], sibling);
+	node->destroyEntry(middle);
+	if (node == mRightmost)
+		mRightmost = sibling;
+	if (index <= middle)
+		return std::make_pair(node, index);
+	return std::make_pair(sibling, index - middle - 1);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::insertEntry(LeafNode* node, size_t index, key_type& key, mapped_type& data, LeafNode* rightChild)
+{
+	for (size_t i = node->Count; i > index; i--)
+		node->moveEntry(i - 1, node, i);
+	::new (static_cast<void*>(node->keys() + index)) key_type(std::move(key));
+	::new (static_cast<void*>(node->values() + index)) mapped_type(std::move(data));
+	if (rightChild != NULL)
+	{
+		InternalNode* internal = node->internal();
+		for (size_t i = node->Count + 1; i > index + 1; i--)
+			internal->setChild(i, internal->Children[i - 1]);
+		internal->setChild(index + 1, rightChild);
+	}
+	node->Count++;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::removeEntry(LeafNode* node, size_t index)
+{
+	node->destroyEntry(index);
+	for (size_t i = index + 1; i < node->Count; i++)
+		node->moveEntry(i, node, i - 1);
+	node->Count--;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::rebalance(LeafNode* node)
+{
+	//underfull node borrows from a sibling with spare keys, otherwise merges with it and the parent may underflow
+	while (node != mRoot && node->Count < MinNodeKeysCount)
+	{
+		InternalNode* parent = node->Parent;
+		size_t position = node->Position;
+		if (position > 0 && parent->Children[position - 1]->Count > MinNodeKeysCount)
+		{
+			rotateRight(parent, position - 1);
+			return;
+		}
+		if (position < parent->Count && parent->Children[position + 1]->Count > MinNodeKeysCount)
+		{
+			rotateLeft(parent, position);
+			return;
+		}
+		mergeChildren(parent, position > 0 ? position - 1 : position);
+		node = parent;
+	}
+	if (mRoot->Count > 0)
+		return;
+	LeafNode* root = mRoot;
+	if (root->IsLeaf)
+		mRoot = mLeftmost = mRightmost = NULL;
+	else
+	{
+		mRoot = root->internal()->Children[0];
+		mRoot->Parent = NULL;
+		mRoot->Position = 0;
+	}
+	destroyNode(root);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::rotateLeft(InternalNode* parent, size_t index)
+{
+	//separator moves down to the end of left child, first key of right child replaces it
+	LeafNode* left = parent->Children[index];
+	LeafNode* right = parent->Children[index + 1];
+	parent->moveEntry(index, left, left->Count);
+	right->moveEntry(0, parent, index);
+	if (!left->IsLeaf)
+	{
+		left->internal()->setChild(left->Count + 1, right->internal()->Children[0]);
+		for (size_t i = 0; i < right->Count; i++)
+			right->internal()->setChild(i, right->internal()->Children[i + 1]);
+	}
+	left->Count++;
+	for (size_t i = 1; i < right->Count; i++)
+		right->moveEntry(i, right, i - 1);
+	right->Count--;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::rotateRight(InternalNode* parent, size_t index)
+{
+	//separator moves down to the front of right child, last key of left child replaces it
+	LeafNode* left = parent->Children[index];
+	LeafNode* right = parent->Children[index + 1];
+	for (size_t i = right->Count; i > 0; i--)
+		right->moveEntry(i - 1, right, i);
+	parent->moveEntry(index, right, 0);
+	left->moveEntry(left->Count - 1, parent, index);
+	if (!right->IsLeaf)
+	{
+		for (size_t i = right->Count + 1; i > 0; i--)
+			right->internal()->setChild(i, right->internal()->Children[i - 1]);
+		right->internal()->setChild(0, left->internal()->Children[left->Count]);
+	}
+	right->Count++;
+	left->Count--;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::mergeChildren(InternalNode* parent, size_t index)
+{
+	//right child and separator are appended to left child
+	LeafNode* left = parent->Children[index];
+	LeafNode* right = parent->Children[index + 1];
+	parent->moveEntry(index, left, left->Count);
+	for (size_t i = 0; i < right->Count; i++)
+		right->moveEntry(i, left, left->Count + 1 + i);
+	if (!left->IsLeaf)
+	{
+		for (size_t i = 0; i <= right->Count; i++)
+			left->internal()->setChild(left->Count + 1 + i, right->internal()->Children[i]);
+	}
+	left->Count = static_cast<unsigned char>(left->Count + 1 + right->Count);
+	for (size_t i = index + 1; i < parent->Count; i++)
+		parent->moveEntry(i, parent, i - 1);
+	for (size_t i = index + 1; i < parent->Count; i++)
+		parent->setChild(i, parent->Children[i + 1]);
+	parent->Count--;
+	if (right == mRightmost)
+		mRightmost = left;
+	destroyNode(right);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+int BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::checkSubtree(const LeafNode* node, const key_type* low, const key_type* high, size_t& count) const
+{
+	if (node->Count > NodeKeysCount || (node != mRoot && node->Count < MinNodeKeysCount) || node->Count == 0)
+		return -1;
+	for (size_t i = 0; i < node->Count; i++)
+	{
+		const key_type& key = node->keys()[i];
+		if ((i > 0 && !mCompare(node->keys()[i - 1], key)) || (low && !mCompare(*low, key)) || (high && !mCompare(key, *high)))
+			return -1;
+	}
+	count += node->Count;
+	if (node->IsLeaf)
+		return 1;
+	int depth = -1;
+	for (size_t i = 0; i <= node->Count; i++)
+	{
+		const LeafNode* child = node->internal()->Children[i];
+		if (child->Parent != node || child->Position != i)
+			return -1;
+		int childDepth = checkSubtree(child, i > 0 ? node->keys() + i - 1 : low, i < node->Count ? node->keys() + i : high, count);
+		if (childDepth < 0 || (depth >= 0 && childDepth != depth))
+			return -1;
+		depth = childDepth;
+	}
+	return depth + 1;
+}
+
+//B-TREE MAP METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::BTreeMap()
+	: mAllocator(allocator_type()), mCompare(), mCount(0), mRoot(NULL), mLeftmost(NULL), mRightmost(NULL)
+{
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::BTreeMap(const key_compare& compare, const allocator_type& allocator)
+	: mAllocator(allocator), mCompare(compare), mCount(0), mRoot(NULL), mLeftmost(NULL), mRightmost(NULL)
+{
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::BTreeMap(const BTreeMap& other)
+	: mAllocator(leaf_allocator_traits::select_on_container_copy_construction(other.mAllocator)), mCompare(other.mCompare),
+	mCount(other.mCount), mRoot(NULL), mLeftmost(NULL), mRightmost(NULL)
+{
+	if (other.mRoot == NULL)
+		return;
+	mRoot = copySubtree(other.mRoot);
+	for (mLeftmost = mRoot; !mLeftmost->IsLeaf; mLeftmost = mLeftmost->internal()->Children[0]);
+	for (mRightmost = mRoot; !mRightmost->IsLeaf; mRightmost = mRightmost->internal()->Children[mRightmost->Count]);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>& BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::operator=(const BTreeMap& other)
+{
+	if (this != &other)
+	{
+		BTreeMap copy(other);
+		swap(copy);
+	}
+	return *this;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::~BTreeMap()
+{
+	clear();
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::swap(BTreeMap& other)
+{
+	std::swap(mAllocator, other.mAllocator);
+	std::swap(mCompare, other.mCompare);
+	std::swap(mCount, other.mCount);
+	std::swap(mRoot, other.mRoot);
+	std::swap(mLeftmost, other.mLeftmost);
+	std::swap(mRightmost, other.mRightmost);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename M>
+std::pair<typename BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::iterator, bool> BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::insert_or_assign(const key_type& key, M&& data)
+{
+	iterator found = find(key);
+	if (found != end())
+	{
+		found->second = std::forward<M>(data);
+		return std::make_pair(found, false);
+	}
+	return try_emplace(key, std::forward<M>(data));
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+size_t BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::remove(const key_type& key)
+{
+	const_iterator found = findEntry(key);
+	if (found == end())
+		return 0;
+	LeafNode* node = found.mNode;
+	size_t index = found.mPosition;
+	if (!node->IsLeaf)
+	{
+		//key of internal node is replaced by its predecessor, which is removed from its leaf
+		LeafNode* leaf = node->internal()->Children[index];
+		while (!leaf->IsLeaf)
+			leaf = leaf->internal()->Children[leaf->Count];
+		node->keys()[index] = std::move(leaf->keys()[leaf->Count - 1]);
+		node->values()[index] = std::move(leaf->values()[leaf->Count - 1]);
+		node = leaf;
+		index = leaf->Count - 1;
+	}
+	removeEntry(node, index);
+	mCount--;
+	rebalance(node);
+	return 1;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::clear()
+{
+	if (mRoot != NULL)
+		destroySubtree(mRoot);
+	mRoot = mLeftmost = mRightmost = NULL;
+	mCount = 0;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+bool BTreeMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::isValid() const
+{
+	if (mRoot == NULL)
+		return mCount == 0 && mLeftmost == NULL && mRightmost == NULL;
+	size_t count = 0;
+	if (mRoot->Parent != NULL || checkSubtree(mRoot, NULL, NULL, count) < 0 || count != mCount)
+		return false;
+	const LeafNode* leftmost = mRoot;
+	while (!leftmost->IsLeaf)
+		leftmost = leftmost->internal()->Children[0];
+	const LeafNode* rightmost = mRoot;
+	while (!rightmost->IsLeaf)
+		rightmost = rightmost->internal()->Children[rightmost->Count];
+	return leftmost == mLeftmost && rightmost == mRightmost;
+}
+
+#endif // !B_TREE_MAP_H
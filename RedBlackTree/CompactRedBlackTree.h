@@ -0,0 +1,819 @@
+#pragma once
+#ifndef COMPACT_RED_BLACK_TREE_H
+#define COMPACT_RED_BLACK_TREE_H
+
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+//STRUCTURES
+/// Red-black tree with the interface of RedBlackTree for many small items. Nodes live in chunks
+/// of a pool owned by the tree and link each other by 32-bit indices, the color is the top bit of
+/// the parent index, so a node carries 12 bytes besides its item instead of three pointers and a flag.
+/// Index 0 is the leaf, its slot is never given to an item. Freed slots are reused before the pool grows,
+/// chunks never move, so references to items stay valid until the item is removed. An empty tree holds
+/// no chunk, the first one is allocated by the first insert and clear releases all of them.
+template<typename KEY_TYPE, typename MAPPED_TYPE,
+	typename COMPARE = std::less<KEY_TYPE>,
+	typename ALLOCATOR = std::allocator<std::pair<const KEY_TYPE, MAPPED_TYPE> > >
+class CompactRedBlackTree
+{
+	struct CompactNode;
+public:
+	typedef KEY_TYPE key_type;
+	typedef MAPPED_TYPE mapped_type;
+	typedef std::pair<const key_type, mapped_type> value_type;
+	typedef COMPARE key_compare;
+	typedef ALLOCATOR allocator_type;
+	typedef typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<CompactNode> node_allocator_type;
+	typedef uint32_t index_type;
+	class const_iterator;
+	class iterator;
+	/// nodes of one chunk, a chunk is allocated at once
+	static const index_type ChunkSize = 4096;
+	/// indices above are reserved for the color bit
+	static const index_type MaxNodesCount = 0x7FFFFFFF;
+	CompactRedBlackTree();
+	explicit CompactRedBlackTree(const key_compare& compare, const allocator_type& allocator = allocator_type());
+	CompactRedBlackTree(const CompactRedBlackTree& other);
+	CompactRedBlackTree& operator=(const CompactRedBlackTree& other);
+	~CompactRedBlackTree();
+	void swap(CompactRedBlackTree& other);
+	bool isEmpty() const { return mCount == 0; }
+	size_t size() const { return mCount; }
+	allocator_type get_allocator() const { return allocator_type(mAllocator); }
+	key_compare key_comp() const { return mCompare; }
+	/// bytes of one node, the item included
+	static size_t nodeSize() { return sizeof(CompactNode); }
+	iterator insert(const key_type& key, const mapped_type& data) { return try_emplace(key, data).first; }
+	iterator insert(key_type&& key, mapped_type&& data) { return try_emplace(std::move(key), std::move(data)).first; }
+	/// mapped value is constructed from args only if the key is not present
+	template<typename... ARGS>
+	std::pair<iterator, bool> try_emplace(const key_type& key, ARGS&&... args) { return tryEmplace(key, std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	std::pair<iterator, bool> try_emplace(key_type&& key, ARGS&&... args) { return tryEmplace(std::move(key), std::forward<ARGS>(args)...); }
+	template<typename M>
+	std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& data);
+	mapped_type& operator[](const key_type& key) { return try_emplace(key).first->second; }
+	mapped_type& operator[](key_type&& key) { return try_emplace(std::move(key)).first->second; }
+	size_t remove(const key_type& key);
+	/// remove item at position, return iterator to the next one
+	iterator erase(const_iterator position);
+	void clear();
+	/// true if ordering, colors, black height and parent indices hold
+	bool isValid() const;
+	iterator begin() { return iterator(this, mLeftmost); }
+	iterator end() { return iterator(this, 0); }
+	const_iterator begin() const { return const_iterator(this, mLeftmost); }
+	const_iterator end() const { return const_iterator(this, 0); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+	iterator find(const key_type& key) { return iterator(this, findIndex(key)); }
+	const_iterator find(const key_type& key) const { return const_iterator(this, findIndex(key)); }
+	/// first item with key not less than given one
+	iterator lower_bound(const key_type& key) { return iterator(this, boundIndex<false>(key)); }
+	const_iterator lower_bound(const key_type& key) const { return const_iterator(this, boundIndex<false>(key)); }
+	/// first item with key greater than given one
+	iterator upper_bound(const key_type& key) { return iterator(this, boundIndex<true>(key)); }
+	const_iterator upper_bound(const key_type& key) const { return const_iterator(this, boundIndex<true>(key)); }
+private:
+	typedef std::allocator_traits<ALLOCATOR> allocator_traits;
+	typedef std::allocator_traits<node_allocator_type> node_allocator_traits;
+	typedef typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<CompactNode*> chunk_allocator_type;
+	static const index_type RedBit = 0x80000000;
+	allocator_type mAllocator;
+	key_compare mCompare;
+	size_t mCount;
+	std::vector<CompactNode*, chunk_allocator_type> mChunks;
+	/// slots handed out so far, the leaf included
+	index_type mUsedCount;
+	/// freed slots chained by Left
+	index_type mFreeList;
+	index_type mRoot;
+	index_type mLeftmost;
+	index_type mRightmost;
+
+	CompactNode& node(index_type index) const { return mChunks[index / ChunkSize][index % ChunkSize]; }
+	index_type left(index_type index) const { return node(index).Left; }
+	index_type right(index_type index) const { return node(index).Right; }
+	index_type parent(index_type index) const { return node(index).ParentAndColor & ~RedBit; }
+	bool isRed(index_type index) const { return (node(index).ParentAndColor & RedBit) != 0; }
+	const key_type& key(index_type index) const { return node(index).Value.first; }
+	void setParent(index_type index, index_type parentIndex) { node(index).ParentAndColor = (node(index).ParentAndColor & RedBit) | parentIndex; }
+	void setRed(index_type index, bool isRed) { node(index).ParentAndColor = (node(index).ParentAndColor & ~RedBit) | (isRed ? RedBit : 0); }
+	index_type minimum(index_type index) const;
+	index_type maximum(index_type index) const;
+	index_type next(index_type index) const;
+	index_type previous(index_type index) const;
+	index_type allocateNode();
+	void freeNode(index_type index);
+	template<typename... ARGS>
+	index_type createNode(ARGS&&... args);
+	void destroyNode(index_type index);
+	void releaseChunks();
+	void rotateLeft(index_type x);
+	void rotateRight(index_type x);
+	void attachNode(index_type z, index_type parentIndex, bool isLeft);
+	void restoreAfterInsert(index_type z);
+	void transplant(index_type u, index_type v);
+	void removeNode(index_type z);
+	void restoreAfterDelete(index_type x);
+	index_type findInsertPosition(const key_type& key, index_type& parentIndex, bool& isLeft) const;
+	index_type findIndex(const key_type& key) const;
+	template<bool IS_UPPER>
+	index_type boundIndex(const key_type& key) const;
+	template<typename K, typename... ARGS>
+	std::pair<iterator, bool> tryEmplace(K&& key, ARGS&&... args);
+	int checkSubtree(index_type index, index_type parentIndex, size_t& count) const;
+};
+
+/// Node is 12 bytes of links followed by the item, which is left unconstructed in the leaf and in free slots.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+struct CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::CompactNode
+{
+	index_type Left;
+	index_type Right;
+	index_type ParentAndColor;
+	union { value_type Value; };
+
+	CompactNode() : Left(0), Right(0), ParentAndColor(0) {}
+	~CompactNode() {}
+};
+
+/// Iterator is the tree and a node index, end() is the leaf index 0.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+class CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator
+	: public std::iterator<std::bidirectional_iterator_tag,
+	typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::value_type,
+	std::ptrdiff_t,
+	const typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::value_type*,
+	const typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::value_type&>
+{
+public:
+	const_iterator() : mTree(NULL), mIndex(0) {}
+	const value_type& operator*() const
+	{
+		if (!mTree || mIndex == 0)
+			throw std::runtime_error(std::string("Cannot be dereferenced"));
+		return mTree->node(mIndex).Value;
+	}
+	const value_type* operator->() const
+	{
+		if (!mTree || mIndex == 0)
+			throw std::runtime_error(std::string("Cannot be referenced"));
+		return &mTree->node(mIndex).Value;
+	}
+	const_iterator& operator++() { increment(); return *this; }
+	const_iterator operator++(int) { const_iterator retIt = *this; increment(); return retIt; }
+	const_iterator& operator--() { decrement(); return *this; }
+	const_iterator operator--(int) { const_iterator retIt = *this; decrement(); return retIt; }
+	bool operator==(const const_iterator& right) const { return mTree == right.mTree && mIndex == right.mIndex; }
+	bool operator!=(const const_iterator& right) const { return !(*this == right); }
+protected:
+	const CompactRedBlackTree* mTree;
+	index_type mIndex;
+	friend CompactRedBlackTree;
+	const_iterator(const CompactRedBlackTree* tree, index_type index) : mTree(tree), mIndex(index) {}
+	void increment();
+	void decrement();
+};
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+class CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::iterator : public CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator
+{
+public:
+	typedef value_type* pointer;
+	typedef value_type& reference;
+	iterator() {}
+	value_type& operator*() const { return const_cast<value_type&>(const_iterator::operator*()); }
+	value_type* operator->() const { return const_cast<value_type*>(const_iterator::operator->()); }
+	iterator& operator++() { this->increment(); return *this; }
+	iterator operator++(int) { iterator retIt = *this; this->increment(); return retIt; }
+	iterator& operator--() { this->decrement(); return *this; }
+	iterator operator--(int) { iterator retIt = *this; this->decrement(); return retIt; }
+private:
+	friend CompactRedBlackTree;
+	iterator(const CompactRedBlackTree* tree, index_type index) : const_iterator(tree, index) {}
+};
+
+//ITERATOR METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator::increment()
+{
+	if (!mTree || mIndex == 0)
+		throw std::out_of_range("Iterator cannot be increment.");
+	mIndex = mTree->next(mIndex);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator::decrement()
+{
+	if (!mTree)
+		throw std::out_of_range("Iterator cannot be decrement.");
+	index_type previous = mIndex == 0 ? mTree->mRightmost : mTree->previous(mIndex);
+	if (previous == 0)
+		throw std::out_of_range("Iterator cannot be decrement.");
+	mIndex = previous;
+}
+
+//PRIVATE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::index_type CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::minimum(index_type index) const
+{
+	while (left(index) != 0)
+		index = left(index);
+	return index;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::index_type CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::maximum(index_type index) const
+{
+	while (right(index) != 0)
+		index = right(index);
+	return index;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::index_type CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::next(index_type index) const
+{
+	if (right(index) != 0)
+		return minimum(right(index));
+	index_type parentIndex = parent(index);
+	while (parentIndex != 0 && index == right(parentIndex))
+	{
+		index = parentIndex;
+		parentIndex = parent(index);
+	}
+	return parentIndex;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::index_type CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::previous(index_type index) const
+{
+	if (left(index) != 0)
+		return maximum(left(index));
+	index_type parentIndex = parent(index);
+	while (parentIndex != 0 && index == left(parentIndex))
+	{
+		index = parentIndex;
+		parentIndex = parent(index);
+	}
+	return parentIndex;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::index_type CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::allocateNode()
+{
+	if (mFreeList != 0)
+	{
+		index_type index = mFreeList;
+		mFreeList = left(index);
+		return index;
+	}
+	if (mUsedCount == MaxNodesCount)
+		throw std::length_error("Tree cannot hold more nodes.");
+	if (mUsedCount == mChunks.size() * ChunkSize)
+	{
+		node_allocator_type allocator(mAllocator);
+		CompactNode* chunk = node_allocator_traits::allocate(allocator, ChunkSize);
+		for (index_type i = 0; i < ChunkSize; i++)
+			node_allocator_traits::construct(allocator, chunk + i);
+		try
+		{
+			mChunks.push_back(chunk);
+		}
+		catch (...)
+		{
+			node_allocator_traits::deallocate(allocator, chunk, ChunkSize);
+			throw;
+		}
+		//first chunk starts with the leaf slot
+		if (mUsedCount == 0)
+			mUsedCount = 1;
+	}
+	return mUsedCount++;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::freeNode(index_type index)
+{
+	CompactNode& freed = node(index);
+	freed.Left = mFreeList;
+	freed.Right = 0;
+	freed.ParentAndColor = 0;
+	mFreeList = index;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename... ARGS>
+typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::index_type CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::createNode(ARGS&&... args)
+{
+	index_type index = allocateNode();
+	try
+	{
+		allocator_traits::construct(mAllocator, &node(index).Value, std::forward<ARGS>(args)...);
+	}
+	catch (...)
+	{
+		freeNode(index);
+		throw;
+	}
+	return index;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::destroyNode(index_type index)
+{
+	allocator_traits::destroy(mAllocator, &node(index).Value);
+	freeNode(index);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::releaseChunks()
+{
+	//items are destroyed in order, the leaf and free slots hold none
+	for (index_type index = mLeftmost; index != 0; index = next(index))
+		allocator_traits::destroy(mAllocator, &node(index).Value);
+	node_allocator_type allocator(mAllocator);
+	for (size_t i = 0; i < mChunks.size(); i++)
+	{
+		for (index_type j = 0; j < ChunkSize; j++)
+			node_allocator_traits::destroy(allocator, mChunks[i] + j);
+		node_allocator_traits::deallocate(allocator, mChunks[i], ChunkSize);
+	}
+	mChunks.clear();
+	mCount = 0;
+	mUsedCount = 0;
+	mFreeList = 0;
+	mRoot = mLeftmost = mRightmost = 0;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::rotateLeft(index_type x)
+{
+	index_type y = right(x);
+	node(x).Right = left(y);
+	if (left(y) != 0)
+		setParent(left(y), x);
+	setParent(y, parent(x));
+	if (parent(x) == 0)
+		mRoot = y;
+	else if (x == left(parent(x)))
+		node(parent(x)).Left = y;
+	else
+		node(parent(x)).Right = y;
+	node(y).Left = x;
+	setParent(x, y);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::rotateRight(index_type x)
+{
+	index_type y = left(x);
+	node(x).Left = right(y);
+	if (right(y) != 0)
+		setParent(right(y), x);
+	setParent(y, parent(x));
+	if (parent(x) == 0)
+		mRoot = y;
+	else if (x == right(parent(x)))
+		node(parent(x)).Right = y;
+	else
+		node(parent(x)).Left = y;
+	node(y).Right = x;
+	setParent(x, y);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::attachNode(index_type z, index_type parentIndex, bool isLeft)
+{
+	CompactNode& attached = node(z);
+	attached.Left = 0;
+	attached.Right = 0;
+	attached.ParentAndColor = parentIndex | RedBit;
+	if (parentIndex == 0)
+	{
+		mRoot = mLeftmost = mRightmost = z;
+	}
+	else if (isLeft)
+	{
+		node(parentIndex).Left = z;
+		if (parentIndex == mLeftmost)
+			mLeftmost = z;
+	}
+	else
+	{
+		node(parentIndex).Right = z;
+		if (parentIndex == mRightmost)
+			mRightmost = z;
+	}
+	restoreAfterInsert(z);
+	mCount++;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::restoreAfterInsert(index_type z)
+{
+	//leaf 0 is black, so the parent of the root stops the loop
+	while (isRed(parent(z)))
+	{
+		index_type p = parent(z);
+		index_type g = parent(p);
+		if (p == left(g))
+		{
+			index_type y = right(g);
+			if (isRed(y))
+			{
+				setRed(p, false);
+				setRed(y, false);
+				setRed(g, true);
+				z = g;
+			}
+			else
+			{
+				if (z == right(p))
+				{
+					z = p;
+					rotateLeft(z);
+					p = parent(z);
+				}
+				setRed(p, false);
+				setRed(g, true);
+				rotateRight(g);
+			}
+		}
+		else
+		{
+			index_type y = left(g);
+			if (isRed(y))
+			{
+				setRed(p, false);
+				setRed(y, false);
+				setRed(g, true);
+				z = g;
+			}
+			else
+			{
+				if (z == left(p))
+				{
+					z = p;
+					rotateRight(z);
+					p = parent(z);
+				}
+				setRed(p, false);
+				setRed(g, true);
+				rotateLeft(g);
+			}
+		}
+	}
+	setRed(mRoot, false);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::transplant(index_type u, index_type v)
+{
+	//parent of the leaf is set too, removal climbs from it
+	index_type parentIndex = parent(u);
+	if (parentIndex == 0)
+		mRoot = v;
+	else if (u == left(parentIndex))
+		node(parentIndex).Left = v;
+	else
+		node(parentIndex).Right = v;
+	setParent(v, parentIndex);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::removeNode(index_type z)
+{
+	if (z == mLeftmost)
+		mLeftmost = next(z);
+	if (z == mRightmost)
+		mRightmost = previous(z);
+	index_type x;
+	bool isRemovedRed = isRed(z);
+	if (left(z) == 0)
+	{
+		x = right(z);
+		transplant(z, x);
+	}
+	else if (right(z) == 0)
+	{
+		x = left(z);
+		transplant(z, x);
+	}
+	else
+	{
+		//successor takes the place of removed node, items never move between slots
+		index_type y = minimum(right(z));
+		isRemovedRed = isRed(y);
+		x = right(y);
+		if (parent(y) == z)
+			setParent(x, y);
+		else
+		{
+			transplant(y, x);
+			node(y).Right = right(z);
+			setParent(right(y), y);
+		}
+		transplant(z, y);
+		node(y).Left = left(z);
+		setParent(left(y), y);
+		setRed(y, isRed(z));
+	}
+	if (!isRemovedRed)
+		restoreAfterDelete(x);
+	node(0).ParentAndColor = 0;
+	destroyNode(z);
+	mCount--;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::restoreAfterDelete(index_type x)
+{
+	while (x != mRoot && !isRed(x))
+	{
+		index_type p = parent(x);
+		if (x == left(p))
+		{
+			index_type w = right(p);
+			if (isRed(w))
+			{
+				setRed(w, false);
+				setRed(p, true);
+				rotateLeft(p);
+				w = right(p);
+			}
+			if (!isRed(left(w)) && !isRed(right(w)))
+			{
+				setRed(w, true);
+				x = p;
+			}
+			else
+			{
+				if (!isRed(right(w)))
+				{
+					setRed(left(w), false);
+					setRed(w, true);
+					rotateRight(w);
+					w = right(p);
+				}
+				setRed(w, isRed(p));
+				setRed(p, false);
+				setRed(right(w), false);
+				rotateLeft(p);
+				x = mRoot;
+			}
+		}
+		else
+		{
+			index_type w = left(p);
+			if (isRed(w))
+			{
+				setRed(w, false);
+				setRed(p, true);
+				rotateRight(p);
+				w = left(p);
+			}
+			if (!isRed(right(w)) && !isRed(left(w)))
+			{
+				setRed(w, true);
+				x = p;
+			}
+			else
+			{
+				if (!isRed(left(w)))
+				{
+					setRed(right(w), false);
+					setRed(w, true);
+					rotateLeft(w);
+					w = left(p);
+				}
+				setRed(w, isRed(p));
+				setRed(p, false);
+				setRed(left(w), false);
+				rotateRight(p);
+				x = mRoot;
+			}
+		}
+	}
+	setRed(x, false);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::index_type CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::findInsertPosition(const key_type& searched, index_type& parentIndex, bool& isLeft) const
+{
+	index_type index = mRoot;
+	index_type notGreater = 0;
+	parentIndex = 0;
+	isLeft = false;
+	while (index != 0)
+	{
+		parentIndex = index;
+		isLeft = mCompare(searched, key(index));
+		if (isLeft)
+			index = left(index);
+		else
+		{
+			notGreater = index;
+			index = right(index);
+		}
+	}
+	if (notGreater != 0 && !mCompare(key(notGreater), searched))
+		return notGreater;
+	return 0;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::index_type CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::findIndex(const key_type& searched) const
+{
+	index_type notLess = boundIndex<false>(searched);
+	if (notLess != 0 && mCompare(searched, key(notLess)))
+		return 0;
+	return notLess;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<bool IS_UPPER>
+typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::index_type CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::boundIndex(const key_type& searched) const
+{
+	index_type index = mRoot;
+	index_type bound = 0;
+	while (index != 0)
+	{
+		bool isRight = IS_UPPER ? !mCompare(searched, key(index)) : mCompare(key(index), searched);
+		if (isRight)
+			index = right(index);
+		else
+		{
+			bound = index;
+			index = left(index);
+		}
+	}
+	return bound;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename K, typename... ARGS>
+std::pair<typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::iterator, bool> CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::tryEmplace(K&& searched, ARGS&&... args)
+{
+	index_type parentIndex;
+	bool isLeft;
+	index_type found = findInsertPosition(searched, parentIndex, isLeft);
+	if (found != 0)
+		return std::make_pair(iterator(this, found), false);
+	index_type index = createNode(std::piecewise_construct,
+		std::forward_as_tuple(std::forward<K>(searched)), std::forward_as_tuple(std::forward<ARGS>(args)...));
+	attachNode(index, parentIndex, isLeft);
+	return std::make_pair(iterator(this, index), true);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+int CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::checkSubtree(index_type index, index_type parentIndex, size_t& count) const
+{
+	if (index == 0)
+		return 1;
+	if (parent(index) != parentIndex)
+		return -1;
+	if (isRed(index) && (isRed(left(index)) || isRed(right(index))))
+		return -1;
+	if (left(index) != 0 && !mCompare(key(left(index)), key(index)))
+		return -1;
+	if (right(index) != 0 && !mCompare(key(index), key(right(index))))
+		return -1;
+	count++;
+	int leftHeight = checkSubtree(left(index), index, count);
+	int rightHeight = checkSubtree(right(index), index, count);
+	if (leftHeight < 0 || leftHeight != rightHeight)
+		return -1;
+	return leftHeight + (isRed(index) ? 0 : 1);
+}
+
+//COMPACT RED BLACK TREE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::CompactRedBlackTree()
+	: mAllocator(allocator_type()), mCompare(), mCount(0), mChunks(chunk_allocator_type(mAllocator)),
+	mUsedCount(0), mFreeList(0), mRoot(0), mLeftmost(0), mRightmost(0)
+{
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::CompactRedBlackTree(const key_compare& compare, const allocator_type& allocator)
+	: mAllocator(allocator), mCompare(compare), mCount(0), mChunks(chunk_allocator_type(mAllocator)),
+	mUsedCount(0), mFreeList(0), mRoot(0), mLeftmost(0), mRightmost(0)
+{
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::CompactRedBlackTree(const CompactRedBlackTree& other)
+	: mAllocator(allocator_traits::select_on_container_copy_construction(other.mAllocator)), mCompare(other.mCompare), mCount(0),
+	mChunks(chunk_allocator_type(mAllocator)), mUsedCount(0), mFreeList(0), mRoot(0), mLeftmost(0), mRightmost(0)
+{
+	//items are appended in order, so the copy fills its chunks without gaps
+	try
+	{
+		for (const_iterator it = other.begin(); it != other.end(); ++it)
+			attachNode(createNode(*it), mRightmost, false);
+	}
+	catch (...)
+	{
+		releaseChunks();
+		throw;
+	}
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>& CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::operator=(const CompactRedBlackTree& other)
+{
+	if (this != &other)
+	{
+		CompactRedBlackTree copy(other);
+		swap(copy);
+	}
+	return *this;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::~CompactRedBlackTree()
+{
+	releaseChunks();
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::swap(CompactRedBlackTree& other)
+{
+	std::swap(mAllocator, other.mAllocator);
+	std::swap(mCompare, other.mCompare);
+	std::swap(mCount, other.mCount);
+	mChunks.swap(other.mChunks);
+	std::swap(mUsedCount, other.mUsedCount);
+	std::swap(mFreeList, other.mFreeList);
+	std::swap(mRoot, other.mRoot);
+	std::swap(mLeftmost, other.mLeftmost);
+	std::swap(mRightmost, other.mRightmost);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename M>
+std::pair<typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::iterator, bool> CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::insert_or_assign(const key_type& searched, M&& data)
+{
+	index_type parentIndex;
+	bool isLeft;
+	index_type found = findInsertPosition(searched, parentIndex, isLeft);
+	if (found != 0)
+	{
+		node(found).Value.second = std::forward<M>(data);
+		return std::make_pair(iterator(this, found), false);
+	}
+	index_type index = createNode(searched, std::forward<M>(data));
+	attachNode(index, parentIndex, isLeft);
+	return std::make_pair(iterator(this, index), true);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+size_t CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::remove(const key_type& searched)
+{
+	index_type found = findIndex(searched);
+	if (found == 0)
+		return 0;
+	removeNode(found);
+	return 1;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::iterator CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::erase(const_iterator position)
+{
+	if (position.mTree != this || position.mIndex == 0)
+		throw std::out_of_range("Iterator cannot be erased.");
+	index_type nextIndex = next(position.mIndex);
+	removeNode(position.mIndex);
+	return iterator(this, nextIndex);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::clear()
+{
+	releaseChunks();
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+bool CompactRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::isValid() const
+{
+	if (mChunks.empty())
+		return mCount == 0 && mUsedCount == 0 && mRoot == 0 && mLeftmost == 0 && mRightmost == 0;
+	if (isRed(mRoot) || isRed(0))
+		return false;
+	size_t count = 0;
+	if (checkSubtree(mRoot, 0, count) < 0 || count != mCount)
+		return false;
+	if (mCount == 0)
+		return mLeftmost == 0 && mRightmost == 0;
+	return mLeftmost == minimum(mRoot) && mRightmost == maximum(mRoot);
+}
+#endif // !COMPACT_RED_BLACK_TREE_H
@@ -0,0 +1,363 @@
+#pragma once
+#ifndef CONCURRENT_RED_BLACK_TREE_H
+#define CONCURRENT_RED_BLACK_TREE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "RedBlackTree.h"
+
+//STRUCTURES
+/// Ordered map split by key hash into shards, each one a RedBlackTree behind its own
+/// reader-writer lock. Writers lock only the shard of their key, so writes to different
+/// shards run in parallel. Ordered reads go through ReadView, which holds all shards
+/// shared and merges their ordered sequences; writers wait for the view to be released.
+template<typename KEY_TYPE, typename MAPPED_TYPE,
+	typename COMPARE = std::less<KEY_TYPE>,
+	typename HASH = std::hash<KEY_TYPE>,
+	typename ALLOCATOR = std::allocator<std::pair<const KEY_TYPE, MAPPED_TYPE> > >
+class ConcurrentRedBlackTree
+{
+public:
+	typedef RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR> shard_type;
+	typedef KEY_TYPE key_type;
+	typedef MAPPED_TYPE mapped_type;
+	typedef typename shard_type::value_type value_type;
+	typedef COMPARE key_compare;
+	typedef HASH hasher;
+	typedef ALLOCATOR allocator_type;
+	class const_iterator;
+	class ReadView;
+	/// shardsCount 0 means one shard per hardware thread
+	explicit ConcurrentRedBlackTree(size_t shardsCount = 0, const key_compare& compare = key_compare(),
+		const hasher& hash = hasher(), const allocator_type& allocator = allocator_type());
+	~ConcurrentRedBlackTree();
+	size_t shardsCount() const { return mShardsCount; }
+	/// count of items, shards are counted one after another
+	size_t size() const;
+	bool isEmpty() const { return size() == 0; }
+	/// insert item if key is not present, return true if it was inserted
+	bool insert(const key_type& key, const mapped_type& data);
+	/// insert item or replace value of present key, return true if it was inserted
+	template<typename M>
+	bool insert_or_assign(const key_type& key, M&& data);
+	size_t remove(const key_type& key);
+	void clear();
+	/// copy value of key to data, return false if key is not present
+	bool find(const key_type& key, mapped_type& data) const;
+	bool contains(const key_type& key) const;
+	/// lock all shards for reading until the view is destroyed
+	ReadView read() const { return ReadView(*this); }
+	/// call function for items with low <= key < high in order until it returns false,
+	/// return false if it was stopped
+	template<typename FUNCTION>
+	bool forEachInRange(const key_type& low, const key_type& high, FUNCTION function) const;
+private:
+	typedef std::shared_timed_mutex mutex_type;
+	static const size_t CacheLineSize = 64;
+	/// padded to whole cache lines, so writers of different shards never share one
+	struct alignas(CacheLineSize) Shard
+	{
+		Shard(const key_compare& compare, const allocator_type& allocator) : Tree(compare, allocator) {}
+		mutable mutex_type Mutex;
+		shard_type Tree;
+	};
+	key_compare mCompare;
+	hasher mHash;
+	/// shards are built in one block aligned by hand, as new does not honour extended alignment before C++17
+	std::unique_ptr<char[]> mShardsBlock;
+	Shard* mShards;
+	size_t mShardsCount;
+
+	Shard& shardOf(const key_type& key) const;
+
+	ConcurrentRedBlackTree(const ConcurrentRedBlackTree&);
+	void operator=(const ConcurrentRedBlackTree&);
+};
+
+/// Shared locks of all shards, taken in shard order so views never deadlock each other.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+class ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::ReadView
+{
+public:
+	size_t size() const;
+	const_iterator begin() const;
+	const_iterator end() const { return const_iterator(mTree->mCompare); }
+	const_iterator find(const key_type& key) const;
+	/// first item with key not less than given one
+	const_iterator lower_bound(const key_type& key) const;
+private:
+	friend ConcurrentRedBlackTree;
+	const ConcurrentRedBlackTree* mTree;
+	std::vector<std::shared_lock<mutex_type> > mLocks;
+
+	explicit ReadView(const ConcurrentRedBlackTree& tree);
+};
+
+/// K-way merge of shard iterators. Cursors form a heap with the least key on top,
+/// end() has no cursor left.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+class ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::const_iterator
+	: public std::iterator<std::forward_iterator_tag,
+	typename ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::value_type,
+	std::ptrdiff_t,
+	const typename ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::value_type*,
+	const typename ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::value_type&>
+{
+public:
+	const_iterator() {}
+	const value_type& operator*() const
+	{
+		if (mCursors.empty())
+			throw std::runtime_error(std::string("Cannot be dereferenced"));
+		return *mCursors.front().first;
+	}
+	const value_type* operator->() const
+	{
+		if (mCursors.empty())
+			throw std::runtime_error(std::string("Cannot be referenced"));
+		return &*mCursors.front().first;
+	}
+	const_iterator& operator++() { increment(); return *this; }
+	const_iterator operator++(int) { const_iterator retIt = *this; increment(); return retIt; }
+	bool operator==(const const_iterator& right) const;
+	bool operator!=(const const_iterator& right) const { return !(*this == right); }
+private:
+	typedef typename shard_type::const_iterator shard_iterator;
+	typedef std::pair<shard_iterator, shard_iterator> cursor_type;
+	friend ConcurrentRedBlackTree;
+	/// heap order, cursor with greater key sinks
+	struct CursorGreater
+	{
+		key_compare Compare;
+		bool operator()(const cursor_type& left, const cursor_type& right) const { return Compare(right.first->first, left.first->first); }
+	};
+	CursorGreater mGreater;
+	std::vector<cursor_type> mCursors;
+
+	explicit const_iterator(const key_compare& compare) { mGreater.Compare = compare; }
+	void addCursor(shard_iterator first, shard_iterator last);
+	void increment();
+};
+
+//ITERATOR METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+bool ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::const_iterator::operator==(const const_iterator& right) const
+{
+	if (mCursors.empty() || right.mCursors.empty())
+		return mCursors.empty() == right.mCursors.empty();
+	return mCursors.front().first == right.mCursors.front().first;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+void ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::const_iterator::addCursor(shard_iterator first, shard_iterator last)
+{
+	if (first == last)
+		return;
+	mCursors.push_back(cursor_type(first, last));
+	std::push_heap(mCursors.begin(), mCursors.end(), mGreater);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+void ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::const_iterator::increment()
+{
+	if (mCursors.empty())
+		throw std::out_of_range("Iterator cannot be increment.");
+	std::pop_heap(mCursors.begin(), mCursors.end(), mGreater);
+	cursor_type& cursor = mCursors.back();
+	if (++cursor.first == cursor.second)
+		mCursors.pop_back();
+	else
+		std::push_heap(mCursors.begin(), mCursors.end(), mGreater);
+}
+
+//READ VIEW METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::ReadView::ReadView(const ConcurrentRedBlackTree& tree)
+	: mTree(&tree)
+{
+	mLocks.reserve(tree.mShardsCount);
+	for (size_t i = 0; i < tree.mShardsCount; i++)
+		mLocks.push_back(std::shared_lock<mutex_type>(tree.mShards[i].Mutex));
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+size_t ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::ReadView::size() const
+{
+	size_t count = 0;
+	for (size_t i = 0; i < mTree->mShardsCount; i++)
+		count += mTree->mShards[i].Tree.size();
+	return count;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+typename ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::const_iterator ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::ReadView::begin() const
+{
+	const_iterator it(mTree->mCompare);
+	it.mCursors.reserve(mTree->mShardsCount);
+	for (size_t i = 0; i < mTree->mShardsCount; i++)
+	{
+		const shard_type& shard = mTree->mShards[i].Tree;
+		it.addCursor(shard.begin(), shard.end());
+	}
+	return it;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+typename ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::const_iterator ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::ReadView::find(const key_type& key) const
+{
+	const_iterator it = lower_bound(key);
+	if (it != end() && mTree->mCompare(key, it->first))
+		return end();
+	return it;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+typename ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::const_iterator ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::ReadView::lower_bound(const key_type& key) const
+{
+	const_iterator it(mTree->mCompare);
+	it.mCursors.reserve(mTree->mShardsCount);
+	for (size_t i = 0; i < mTree->mShardsCount; i++)
+	{
+		const shard_type& shard = mTree->mShards[i].Tree;
+		it.addCursor(shard.lower_bound(key), shard.end());
+	}
+	return it;
+}
+
+//PRIVATE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+typename ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::Shard& ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::shardOf(const key_type& key) const
+{
+	//mix bits so that identity hashes of regular keys spread over all shards
+	size_t hash = mHash(key);
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3b;
+	hash ^= hash >> 16;
+	return mShards[hash % mShardsCount];
+}
+
+//CONCURRENT RED BLACK TREE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::ConcurrentRedBlackTree(size_t shardsCount, const key_compare& compare,
+	const hasher& hash, const allocator_type& allocator)
+	: mCompare(compare), mHash(hash), mShards(NULL), mShardsCount(0)
+{
+	if (shardsCount == 0)
+		shardsCount = std::max(std::thread::hardware_concurrency(), 1u);
+	//one cache line more leaves room to round the start of shards up to a cache line
+	mShardsBlock.reset(new char[shardsCount * sizeof(Shard) + CacheLineSize]);
+	std::uintptr_t address = reinterpret_cast<std::uintptr_t>(mShardsBlock.get());
+	mShards = reinterpret_cast<Shard*>(mShardsBlock.get() + (CacheLineSize - address % CacheLineSize) % CacheLineSize);
+	try
+	{
+		for (; mShardsCount < shardsCount; mShardsCount++)
+			new (mShards + mShardsCount) Shard(compare, allocator);
+	}
+	catch (...)
+	{
+		while (mShardsCount > 0)
+			mShards[--mShardsCount].~Shard();
+		throw;
+	}
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::~ConcurrentRedBlackTree()
+{
+	for (size_t i = 0; i < mShardsCount; i++)
+		mShards[i].~Shard();
+	mShardsCount = 0;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+size_t ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::size() const
+{
+	size_t count = 0;
+	for (size_t i = 0; i < mShardsCount; i++)
+	{
+		std::shared_lock<mutex_type> lock(mShards[i].Mutex);
+		count += mShards[i].Tree.size();
+	}
+	return count;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+bool ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::insert(const key_type& key, const mapped_type& data)
+{
+	Shard& shard = shardOf(key);
+	std::unique_lock<mutex_type> lock(shard.Mutex);
+	return shard.Tree.try_emplace(key, data).second;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+template<typename M>
+bool ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::insert_or_assign(const key_type& key, M&& data)
+{
+	Shard& shard = shardOf(key);
+	std::unique_lock<mutex_type> lock(shard.Mutex);
+	return shard.Tree.insert_or_assign(key, std::forward<M>(data)).second;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+size_t ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::remove(const key_type& key)
+{
+	Shard& shard = shardOf(key);
+	std::unique_lock<mutex_type> lock(shard.Mutex);
+	return shard.Tree.remove(key);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+void ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::clear()
+{
+	for (size_t i = 0; i < mShardsCount; i++)
+	{
+		std::unique_lock<mutex_type> lock(mShards[i].Mutex);
+		mShards[i].Tree.clear();
+	}
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+bool ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::find(const key_type& key, mapped_type& data) const
+{
+	const Shard& shard = shardOf(key);
+	std::shared_lock<mutex_type> lock(shard.Mutex);
+	typename shard_type::const_iterator it = shard.Tree.find(key);
+	if (it == shard.Tree.end())
+		return false;
+	data = it->second;
+	return true;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+bool ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::contains(const key_type& key) const
+{
+	const Shard& shard = shardOf(key);
+	std::shared_lock<mutex_type> lock(shard.Mutex);
+	return shard.Tree.find(key) != shard.Tree.end();
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename HASH, typename ALLOCATOR>
+template<typename FUNCTION>
+bool ConcurrentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, HASH, ALLOCATOR>::forEachInRange(const key_type& low, const key_type& high, FUNCTION function) const
+{
+	ReadView view = read();
+	for (const_iterator it = view.lower_bound(low); it != view.end() && mCompare(it->first, high); ++it)
+	{
+		if (!function(*it))
+			return false;
+	}
+	return true;
+}
+
+#endif // !CONCURRENT_RED_BLACK_TREE_H
@@ -0,0 +1,352 @@
+#pragma once
+#ifndef FROZEN_MAP_H
+#define FROZEN_MAP_H
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../Headers/KeySearch.h"
+#include "../Headers/MappedFile.h"
+#include "../Headers/ReferenceProxy.h"
+
+//STRUCTURES
+/// Immutable sorted map for data built once and read often, e.g. by RedBlackTree::freeze().
+/// Keys are stored in Eytzinger order: item k has children 2k and 2k + 1 (k counted from 1),
+/// so the top levels of every search share few cache lines. Key k is stored at index k of an array
+/// starting at a cache line, whose index 0 is unused, so the descendants of item k a few levels
+/// below fill the cache line at index k * PrefetchStride. Search has no data dependent branches
+/// and prefetches that cache line while it compares the levels above it. Values are
+/// kept in a parallel array, iteration runs in key order and returns pairs of references.
+/// Arrays are shared by copies of the map and may live in a memory mapped image file.
+template<typename KEY_TYPE, typename MAPPED_TYPE,
+	typename COMPARE = std::less<KEY_TYPE>,
+	typename ALLOCATOR = std::allocator<std::pair<const KEY_TYPE, MAPPED_TYPE> > >
+class FrozenMap
+{
+public:
+	typedef KEY_TYPE key_type;
+	typedef MAPPED_TYPE mapped_type;
+	typedef std::pair<const key_type, mapped_type> value_type;
+	typedef std::pair<const key_type&, const mapped_type&> const_reference;
+	typedef COMPARE key_compare;
+	typedef ALLOCATOR allocator_type;
+	class const_iterator;
+	typedef const_iterator iterator;
+	FrozenMap() : mKeys(NULL), mValues(NULL), mCount(0) {}
+	/// range of key/value pairs with strictly ascending keys, throws invalid_argument for other range
+	template<typename ITERATOR>
+	FrozenMap(ITERATOR first, ITERATOR last, const key_compare& compare = key_compare(), const allocator_type& allocator = allocator_type());
+	/// write image file which open_mapped() serves without reading it, keys and values must be trivially copyable
+	void save(const std::string& path) const { saveImage(path, begin(), mCount); }
+	/// write image of count items with strictly ascending keys without building the map first
+	template<typename ITERATOR>
+	static void saveImage(const std::string& path, ITERATOR first, size_t count);
+	/// map image file written by save(), pages are read on first access and never written back;
+	/// throws runtime_error if the file cannot be mapped or holds other types
+	static FrozenMap open_mapped(const std::string& path, const key_compare& compare = key_compare());
+	bool isEmpty() const { return mCount == 0; }
+	size_t size() const { return mCount; }
+	key_compare key_comp() const { return mCompare; }
+	const_iterator begin() const { return const_iterator(this, first(mCount)); }
+	const_iterator end() const { return const_iterator(this, 0); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+	const_iterator find(const key_type& key) const;
+	/// first item with key not less than given one
+	const_iterator lower_bound(const key_type& key) const { return const_iterator(this, lowerBoundIndex<false>(key)); }
+	/// first item with key greater than given one
+	const_iterator upper_bound(const key_type& key) const { return const_iterator(this, lowerBoundIndex<true>(key)); }
+private:
+	typedef typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<key_type> key_allocator_type;
+	typedef typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<mapped_type> mapped_allocator_type;
+	typedef typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<char> byte_allocator_type;
+	static const size_t CacheLineSize = 64;
+	/// arrays of a map built in memory, keys are placed at a cache line of a byte block by hand,
+	/// as allocators need not align beyond the fundamental alignment
+	struct Arrays
+	{
+		Arrays(const allocator_type& allocator, size_t count);
+		~Arrays();
+		byte_allocator_type Allocator;
+		char* Block;
+		size_t BlockSize;
+		/// key k at index k, index 0 is not constructed
+		key_type* Keys;
+		/// keys constructed so far, destroyed with the arrays
+		size_t KeysCount;
+		std::vector<mapped_type, mapped_allocator_type> Values;
+	private:
+		Arrays(const Arrays&);
+		void operator=(const Arrays&);
+	};
+	/// start of image file, arrays follow at given offsets aligned to cache line
+	struct ImageHeader
+	{
+		char Magic[8];
+		std::uint32_t KeySize;
+		std::uint32_t ValueSize;
+		std::uint64_t Count;
+		std::uint64_t KeysOffset;
+		std::uint64_t ValuesOffset;
+	};
+	/// keys per cache line; for key sizes dividing it the descendants of item k log2(PrefetchStride)
+	/// levels below are items k * PrefetchStride to k * PrefetchStride + PrefetchStride - 1, one cache line
+	static const size_t PrefetchStride = sizeof(key_type) >= CacheLineSize ? 1 : CacheLineSize / sizeof(key_type);
+	key_compare mCompare;
+	//owner of arrays; key of item k of Eytzinger order is at index k, its value at index k - 1
+	std::shared_ptr<const void> mStorage;
+	const key_type* mKeys;
+	const mapped_type* mValues;
+	size_t mCount;
+
+	static size_t first(size_t count);
+	static size_t last(size_t count);
+	static size_t next(size_t index, size_t count);
+	static size_t previous(size_t index, size_t count);
+	template<bool IS_UPPER>
+	size_t lowerBoundIndex(const key_type& key) const;
+};
+
+/// Iterator is an Eytzinger index, end() is 0.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+class FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator
+	: public std::iterator<std::bidirectional_iterator_tag,
+	typename FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::value_type,
+	std::ptrdiff_t,
+	ReferenceProxy<typename FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_reference>,
+	typename FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_reference>
+{
+public:
+	const_iterator() : mMap(NULL), mIndex(0) {}
+	const_reference operator*() const
+	{
+		if (mIndex == 0)
+			throw std::runtime_error(std::string("Cannot be dereferenced"));
+		return const_reference(mMap->mKeys[mIndex], mMap->mValues[mIndex - 1]);
+	}
+	ReferenceProxy<const_reference> operator->() const
+	{
+		if (mIndex == 0)
+			throw std::runtime_error(std::string("Cannot be referenced"));
+		return ReferenceProxy<const_reference>(const_reference(mMap->mKeys[mIndex], mMap->mValues[mIndex - 1]));
+	}
+	const_iterator& operator++() { increment(); return *this; }
+	const_iterator operator++(int) { const_iterator retIt = *this; increment(); return retIt; }
+	const_iterator& operator--() { decrement(); return *this; }
+	const_iterator operator--(int) { const_iterator retIt = *this; decrement(); return retIt; }
+	bool operator==(const const_iterator& right) const { return mIndex == right.mIndex; }
+	bool operator!=(const const_iterator& right) const { return mIndex != right.mIndex; }
+private:
+	friend FrozenMap;
+	const FrozenMap* mMap;
+	size_t mIndex;
+
+	const_iterator(const FrozenMap* map, size_t index) : mMap(map), mIndex(index) {}
+	void increment()
+	{
+		if (mIndex == 0)
+			throw std::out_of_range("Iterator cannot be increment.");
+		mIndex = next(mIndex, mMap->size());
+	}
+	void decrement()
+	{
+		size_t index = mIndex == 0 ? last(mMap->size()) : previous(mIndex, mMap->size());
+		if (index == 0)
+			throw std::out_of_range("Iterator cannot be decrement.");
+		mIndex = index;
+	}
+};
+
+//PRIVATE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::Arrays::Arrays(const allocator_type& allocator, size_t count)
+	: Allocator(allocator), Block(NULL), BlockSize((count + 1) * sizeof(key_type) + CacheLineSize - 1), Keys(NULL), KeysCount(0),
+	Values(mapped_allocator_type(allocator))
+{
+	static_assert(CacheLineSize % alignof(key_type) == 0, "keys must fit cache line alignment");
+	Block = std::allocator_traits<byte_allocator_type>::allocate(Allocator, BlockSize);
+	std::uintptr_t address = reinterpret_cast<std::uintptr_t>(Block);
+	Keys = reinterpret_cast<key_type*>(Block + (CacheLineSize - address % CacheLineSize) % CacheLineSize);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::Arrays::~Arrays()
+{
+	key_allocator_type keyAllocator(Allocator);
+	for (size_t index = 1; index <= KeysCount; index++)
+		std::allocator_traits<key_allocator_type>::destroy(keyAllocator, Keys + index);
+	std::allocator_traits<byte_allocator_type>::deallocate(Allocator, Block, BlockSize);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+size_t FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::first(size_t count)
+{
+	if (count == 0)
+		return 0;
+	size_t index = 1;
+	while (2 * index <= count)
+		index = 2 * index;
+	return index;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+size_t FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::last(size_t count)
+{
+	if (count == 0)
+		return 0;
+	size_t index = 1;
+	while (2 * index + 1 <= count)
+		index = 2 * index + 1;
+	return index;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+size_t FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::next(size_t index, size_t count)
+{
+	//leftmost item of right subtree, otherwise the nearest ancestor whose left subtree holds index, 0 after the last item
+	if (2 * index + 1 <= count)
+	{
+		index = 2 * index + 1;
+		while (2 * index <= count)
+			index = 2 * index;
+		return index;
+	}
+	return index >> (countTrailingZeros(~index) + 1);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+size_t FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::previous(size_t index, size_t count)
+{
+	if (2 * index <= count)
+	{
+		index = 2 * index;
+		while (2 * index + 1 <= count)
+			index = 2 * index + 1;
+		return index;
+	}
+	return index >> (countTrailingZeros(index) + 1);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<bool IS_UPPER>
+size_t FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::lowerBoundIndex(const key_type& key) const
+{
+	//descent goes right while the bound lies right, the bound is the last node left from, which is
+	//found by dropping the trailing right steps and one left step from the final index
+	const key_type* keys = mKeys;
+	const size_t count = mCount;
+	const std::uintptr_t prefetchBase = reinterpret_cast<std::uintptr_t>(keys);
+	size_t index = 1;
+	while (index <= count)
+	{
+		prefetchRead(prefetchBase + index * PrefetchStride * sizeof(key_type));
+		const key_type& nodeKey = keys[index];
+		bool isRight = IS_UPPER ? !mCompare(key, nodeKey) : mCompare(nodeKey, key);
+		index = 2 * index + (isRight ? 1 : 0);
+	}
+	return index >> (countTrailingZeros(~index) + 1);
+}
+
+//FROZEN MAP METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename ITERATOR>
+FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::FrozenMap(ITERATOR first, ITERATOR last, const key_compare& compare, const allocator_type& allocator)
+	: mCompare(compare), mKeys(NULL), mValues(NULL), mCount(0)
+{
+	std::vector<ITERATOR> items;
+	for (; first != last; ++first)
+	{
+		if (!items.empty() && !mCompare(items.back()->first, first->first))
+			throw std::invalid_argument("Keys are not in strictly ascending order.");
+		items.push_back(first);
+	}
+	if (items.empty())
+		return;
+	//in-order walk of Eytzinger indexes gives the sorted position of every index
+	std::vector<size_t> positions(items.size() + 1);
+	size_t position = 0;
+	for (size_t index = FrozenMap::first(items.size()); index != 0; index = next(index, items.size()))
+		positions[index] = position++;
+	std::shared_ptr<Arrays> arrays = std::make_shared<Arrays>(allocator, items.size());
+	key_allocator_type keyAllocator(allocator);
+	arrays->Values.reserve(items.size());
+	for (size_t index = 1; index <= items.size(); index++)
+	{
+		std::allocator_traits<key_allocator_type>::construct(keyAllocator, arrays->Keys + index, items[positions[index]]->first);
+		arrays->KeysCount++;
+		arrays->Values.push_back(items[positions[index]]->second);
+	}
+	mKeys = arrays->Keys;
+	mValues = arrays->Values.data();
+	mCount = items.size();
+	mStorage = arrays;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename ITERATOR>
+void FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::saveImage(const std::string& path, ITERATOR first, size_t count)
+{
+	static_assert(std::is_trivially_copyable<key_type>::value && std::is_trivially_copyable<mapped_type>::value,
+		"image holds bytes of keys and values, which must be trivially copyable");
+	ImageHeader header;
+	std::memcpy(header.Magic, "FROZMAP2", sizeof(header.Magic));
+	header.KeySize = std::uint32_t(sizeof(key_type));
+	header.ValueSize = std::uint32_t(sizeof(mapped_type));
+	header.Count = count;
+	//keys are stored at their Eytzinger index, index 0 stays zeroed
+	header.KeysOffset = (sizeof(ImageHeader) + CacheLineSize - 1) / CacheLineSize * CacheLineSize;
+	header.ValuesOffset = (header.KeysOffset + (count + 1) * sizeof(key_type) + CacheLineSize - 1) / CacheLineSize * CacheLineSize;
+	std::shared_ptr<MappedFile> file = MappedFile::create(path, size_t(header.ValuesOffset + count * sizeof(mapped_type)));
+	//items are written straight to their Eytzinger index in the mapping, so nothing is buffered
+	char* keys = file->data() + header.KeysOffset;
+	char* values = file->data() + header.ValuesOffset;
+	for (size_t index = FrozenMap::first(count); index != 0; index = next(index, count), ++first)
+	{
+		std::memcpy(keys + index * sizeof(key_type), &first->first, sizeof(key_type));
+		std::memcpy(values + (index - 1) * sizeof(mapped_type), &first->second, sizeof(mapped_type));
+	}
+	std::memcpy(file->data(), &header, sizeof(header));
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR> FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::open_mapped(const std::string& path, const key_compare& compare)
+{
+	static_assert(std::is_trivially_copyable<key_type>::value && std::is_trivially_copyable<mapped_type>::value,
+		"image holds bytes of keys and values, which must be trivially copyable");
+	std::shared_ptr<MappedFile> file = MappedFile::open(path);
+	ImageHeader header;
+	if (file->size() < sizeof(header))
+		throw std::runtime_error(std::string("File is not a map image: ") + path);
+	std::memcpy(&header, file->data(), sizeof(header));
+	if (std::memcmp(header.Magic, "FROZMAP2", sizeof(header.Magic)) != 0 || header.KeySize != sizeof(key_type) || header.ValueSize != sizeof(mapped_type)
+		|| header.Count > file->size() / sizeof(key_type) || header.Count > file->size() / sizeof(mapped_type)
+		|| header.KeysOffset > file->size() || header.ValuesOffset > file->size() || header.KeysOffset % CacheLineSize != 0 || header.ValuesOffset % CacheLineSize != 0
+		|| header.KeysOffset + (header.Count + 1) * sizeof(key_type) > header.ValuesOffset
+		|| header.ValuesOffset + header.Count * sizeof(mapped_type) > file->size())
+		throw std::runtime_error(std::string("File is not an image of this map type: ") + path);
+	FrozenMap map;
+	map.mCompare = compare;
+	map.mKeys = reinterpret_cast<const key_type*>(file->data() + header.KeysOffset);
+	map.mValues = reinterpret_cast<const mapped_type*>(file->data() + header.ValuesOffset);
+	map.mCount = size_t(header.Count);
+	map.mStorage = file;
+	return map;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::find(const key_type& key) const
+{
+	size_t index = lowerBoundIndex<false>(key);
+	if (index != 0 && mCompare(key, mKeys[index]))
+		index = 0;
+	return const_iterator(this, index);
+}
+
+#endif // !FROZEN_MAP_H
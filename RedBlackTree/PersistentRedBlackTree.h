@@ -0,0 +1,545 @@
+#pragma once
+#ifndef PERSISTENT_RED_BLACK_TREE_H
+#define PERSISTENT_RED_BLACK_TREE_H
+
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../Headers/Ownership.h"
+
+//STRUCTURES
+/// Red-black tree whose versions share nodes. Copy and snapshot() take O(1), insert and remove
+/// copy only those nodes on the search path which are shared with another version, so
+/// a snapshot never changes and can be read on other threads while the tree is modified.
+/// Nodes have no parent link to be shareable, the tree is kept left-leaning so that
+/// rebalancing stays on the search path. Iterators keep their version alive.
+template<typename KEY_TYPE, typename MAPPED_TYPE,
+	typename COMPARE = std::less<KEY_TYPE>,
+	typename ALLOCATOR = std::allocator<std::pair<const KEY_TYPE, MAPPED_TYPE> > >
+class PersistentRedBlackTree
+{
+	struct PersistentNode;
+public:
+	typedef KEY_TYPE key_type;
+	typedef MAPPED_TYPE mapped_type;
+	typedef std::pair<const key_type, mapped_type> value_type;
+	typedef COMPARE key_compare;
+	typedef ALLOCATOR allocator_type;
+	typedef typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<PersistentNode> node_allocator_type;
+	class const_iterator;
+	PersistentRedBlackTree();
+	explicit PersistentRedBlackTree(const key_compare& compare, const allocator_type& allocator = allocator_type());
+	/// immutable version of current content, O(1)
+	PersistentRedBlackTree snapshot() const { return *this; }
+	bool isEmpty() const { return !mRoot; }
+	size_t size() const { return mCount; }
+	allocator_type get_allocator() const { return allocator_type(mAllocator); }
+	key_compare key_comp() const { return mCompare; }
+	/// insert item if key is not present, return true if it was inserted
+	bool insert(const key_type& key, const mapped_type& data);
+	/// insert item or replace value of present key, return true if it was inserted
+	template<typename M>
+	bool insert_or_assign(const key_type& key, M&& data);
+	size_t remove(const key_type& key);
+	void clear();
+	/// true if ordering and red-black invariants hold
+	bool isValid() const;
+	const_iterator begin() const;
+	const_iterator end() const { return const_iterator(mRoot); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+	const_iterator find(const key_type& key) const;
+	/// first item with key not less than given one
+	const_iterator lower_bound(const key_type& key) const;
+	/// first item with key greater than given one
+	const_iterator upper_bound(const key_type& key) const;
+private:
+	typedef std::allocator_traits<node_allocator_type> node_allocator_traits;
+	typedef RefCountedOwnership::Link<PersistentNode> node_link;
+	node_allocator_type mAllocator;
+	key_compare mCompare;
+	size_t mCount;
+	node_link mRoot;
+
+	static bool isRed(const node_link& node) { return node && node->IsRed; }
+	template<typename... ARGS>
+	PersistentNode* createNode(ARGS&&... args);
+	PersistentNode* mutableNode(node_link& link);
+	void rotateLeft(node_link& link);
+	void rotateRight(node_link& link);
+	void flipColors(node_link& link);
+	void moveRedLeft(node_link& link);
+	void moveRedRight(node_link& link);
+	void restore(node_link& link);
+	const PersistentNode* findNode(const key_type& key) const;
+	void insertNode(node_link& link, const key_type& key, const mapped_type& data);
+	template<typename M>
+	void assignNode(node_link& link, const key_type& key, M&& data);
+	void removeNode(node_link& link, const key_type& key);
+	void removeMin(node_link& link, node_link& minimum);
+	int checkSubtree(const PersistentNode* node, size_t& count) const;
+};
+
+/// Node is changed in place only while no other version links it, otherwise it is copied.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+struct PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::PersistentNode
+	: public RefCountedOwnership::NodeBase<PersistentNode, node_allocator_type>
+{
+	typedef RefCountedOwnership::NodeBase<PersistentNode, node_allocator_type> base_type;
+	node_link Left;
+	node_link Right;
+	bool IsRed;
+	value_type Value;
+
+	template<typename... ARGS>
+	PersistentNode(const node_allocator_type& allocator, ARGS&&... args)
+		: base_type(allocator), IsRed(true), Value(std::forward<ARGS>(args)...) {}
+};
+
+/// Iterator holds the path from the root, which also keeps its version alive. Path of end() is empty.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+class PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator
+	: public std::iterator<std::bidirectional_iterator_tag,
+	typename PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::value_type,
+	std::ptrdiff_t,
+	const typename PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::value_type*,
+	const typename PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::value_type&>
+{
+public:
+	const_iterator() {}
+	const value_type& operator*() const
+	{
+		if (mPath.empty())
+			throw std::runtime_error(std::string("Cannot be dereferenced"));
+		return mPath.back()->Value;
+	}
+	const value_type* operator->() const
+	{
+		if (mPath.empty())
+			throw std::runtime_error(std::string("Cannot be referenced"));
+		return &mPath.back()->Value;
+	}
+	const_iterator& operator++() { increment(); return *this; }
+	const_iterator operator++(int) { const_iterator retIt = *this; increment(); return retIt; }
+	const_iterator& operator--() { decrement(); return *this; }
+	const_iterator operator--(int) { const_iterator retIt = *this; decrement(); return retIt; }
+	bool operator==(const const_iterator& right) const { return node() == right.node(); }
+	bool operator!=(const const_iterator& right) const { return node() != right.node(); }
+private:
+	friend PersistentRedBlackTree;
+	node_link mRoot;
+	std::vector<const PersistentNode*> mPath;
+
+	explicit const_iterator(const node_link& root) : mRoot(root) {}
+	const PersistentNode* node() const { return mPath.empty() ? NULL : mPath.back(); }
+	void increment();
+	void decrement();
+};
+
+//ITERATOR METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator::increment()
+{
+	if (mPath.empty())
+		throw std::out_of_range("Iterator cannot be increment.");
+	const PersistentNode* node = mPath.back();
+	if (node->Right)
+	{
+		for (node = node->Right; node != NULL; node = node->Left)
+			mPath.push_back(node);
+		return;
+	}
+	//climb while coming from the right
+	do
+	{
+		node = mPath.back();
+		mPath.pop_back();
+	} while (!mPath.empty() && mPath.back()->Right == node);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator::decrement()
+{
+	const PersistentNode* node;
+	if (mPath.empty())
+	{
+		if (!mRoot)
+			throw std::out_of_range("Iterator cannot be decrement.");
+		for (node = mRoot; node != NULL; node = node->Right)
+			mPath.push_back(node);
+		return;
+	}
+	node = mPath.back();
+	if (node->Left)
+	{
+		for (node = node->Left; node != NULL; node = node->Right)
+			mPath.push_back(node);
+		return;
+	}
+	//previous item is the nearest ancestor reached from the right
+	size_t depth = mPath.size() - 1;
+	while (depth > 0 && mPath[depth - 1]->Left == mPath[depth])
+		depth--;
+	if (depth == 0)
+		throw std::out_of_range("Iterator cannot be decrement.");
+	mPath.resize(depth);
+}
+
+//PRIVATE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename... ARGS>
+typename PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::PersistentNode* PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::createNode(ARGS&&... args)
+{
+	PersistentNode* node = node_allocator_traits::allocate(mAllocator, 1);
+	try
+	{
+		node_allocator_traits::construct(mAllocator, node, mAllocator, std::forward<ARGS>(args)...);
+	}
+	catch (...)
+	{
+		node_allocator_traits::deallocate(mAllocator, node, 1);
+		throw;
+	}
+	return node;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::PersistentNode* PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::mutableNode(node_link& link)
+{
+	//link of a version reached through unshared nodes is the only one, other versions hold more
+	if (link->references() > 1)
+	{
+		PersistentNode* copy = createNode(link->Value);
+		copy->Left = link->Left;
+		copy->Right = link->Right;
+		copy->IsRed = link->IsRed;
+		link = copy;
+	}
+	return link;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::rotateLeft(node_link& link)
+{
+	PersistentNode* node = mutableNode(link);
+	mutableNode(node->Right);
+	node_link x = node->Right;
+	node->Right = x->Left;
+	x->Left = link;
+	x->IsRed = node->IsRed;
+	node->IsRed = true;
+	link = x;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::rotateRight(node_link& link)
+{
+	PersistentNode* node = mutableNode(link);
+	mutableNode(node->Left);
+	node_link x = node->Left;
+	node->Left = x->Right;
+	x->Right = link;
+	x->IsRed = node->IsRed;
+	node->IsRed = true;
+	link = x;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::flipColors(node_link& link)
+{
+	PersistentNode* node = mutableNode(link);
+	node->IsRed = !node->IsRed;
+	PersistentNode* left = mutableNode(node->Left);
+	left->IsRed = !left->IsRed;
+	PersistentNode* right = mutableNode(node->Right);
+	right->IsRed = !right->IsRed;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::moveRedLeft(node_link& link)
+{
+	flipColors(link);
+	if (isRed(link->Right->Left))
+	{
+		rotateRight(link->Right);
+		rotateLeft(link);
+		flipColors(link);
+	}
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::moveRedRight(node_link& link)
+{
+	flipColors(link);
+	if (isRed(link->Left->Left))
+	{
+		rotateRight(link);
+		flipColors(link);
+	}
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::restore(node_link& link)
+{
+	if (isRed(link->Right) && !isRed(link->Left))
+		rotateLeft(link);
+	if (isRed(link->Left) && isRed(link->Left->Left))
+		rotateRight(link);
+	if (isRed(link->Left) && isRed(link->Right))
+		flipColors(link);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+const typename PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::PersistentNode* PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::findNode(const key_type& key) const
+{
+	const PersistentNode* node = mRoot;
+	const PersistentNode* notLess = NULL;
+	while (node != NULL)
+	{
+		if (mCompare(node->Value.first, key))
+			node = node->Right;
+		else
+		{
+			notLess = node;
+			node = node->Left;
+		}
+	}
+	if (notLess != NULL && mCompare(key, notLess->Value.first))
+		return NULL;
+	return notLess;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::insertNode(node_link& link, const key_type& key, const mapped_type& data)
+{
+	if (!link)
+	{
+		link = createNode(key, data);
+		return;
+	}
+	PersistentNode* node = mutableNode(link);
+	//key is known to be missing
+	if (mCompare(key, node->Value.first))
+		insertNode(node->Left, key, data);
+	else
+		insertNode(node->Right, key, data);
+	restore(link);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename M>
+void PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::assignNode(node_link& link, const key_type& key, M&& data)
+{
+	PersistentNode* node = mutableNode(link);
+	if (mCompare(key, node->Value.first))
+		assignNode(node->Left, key, std::forward<M>(data));
+	else if (mCompare(node->Value.first, key))
+		assignNode(node->Right, key, std::forward<M>(data));
+	else
+		node->Value.second = std::forward<M>(data);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::removeNode(node_link& link, const key_type& key)
+{
+	//key is known to be present, a red link is pushed down the search path so the removed node is red
+	mutableNode(link);
+	if (mCompare(key, link->Value.first))
+	{
+		if (!isRed(link->Left) && !isRed(link->Left->Left))
+			moveRedLeft(link);
+		removeNode(link->Left, key);
+	}
+	else
+	{
+		if (isRed(link->Left))
+			rotateRight(link);
+		//rotations keep key not less than the one of the node
+		if (!mCompare(link->Value.first, key) && !link->Right)
+		{
+			link.makeNULL();
+			return;
+		}
+		if (!isRed(link->Right) && !isRed(link->Right->Left))
+			moveRedRight(link);
+		if (!mCompare(link->Value.first, key))
+		{
+			//successor is relinked into the place of removed node, values never move between nodes
+			node_link successor;
+			removeMin(link->Right, successor);
+			successor->Left = link->Left;
+			successor->Right = link->Right;
+			successor->IsRed = link->IsRed;
+			link = successor;
+		}
+		else
+			removeNode(link->Right, key);
+	}
+	restore(link);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::removeMin(node_link& link, node_link& minimum)
+{
+	if (!link->Left)
+	{
+		minimum = link;
+		link.makeNULL();
+		mutableNode(minimum);
+		return;
+	}
+	mutableNode(link);
+	if (!isRed(link->Left) && !isRed(link->Left->Left))
+		moveRedLeft(link);
+	removeMin(link->Left, minimum);
+	restore(link);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+int PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::checkSubtree(const PersistentNode* node, size_t& count) const
+{
+	if (node == NULL)
+		return 1;
+	count++;
+	if (isRed(node->Right))
+		return -1;
+	if (node->IsRed && isRed(node->Left))
+		return -1;
+	if (node->Left && !mCompare(node->Left->Value.first, node->Value.first))
+		return -1;
+	if (node->Right && !mCompare(node->Value.first, node->Right->Value.first))
+		return -1;
+	int leftHeight = checkSubtree(node->Left, count);
+	int rightHeight = checkSubtree(node->Right, count);
+	if (leftHeight < 0 || leftHeight != rightHeight)
+		return -1;
+	return leftHeight + (node->IsRed ? 0 : 1);
+}
+
+//PERSISTENT RED BLACK TREE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::PersistentRedBlackTree()
+	: mAllocator(allocator_type()), mCompare(), mCount(0)
+{
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::PersistentRedBlackTree(const key_compare& compare, const allocator_type& allocator)
+	: mAllocator(allocator), mCompare(compare), mCount(0)
+{
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+bool PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::insert(const key_type& key, const mapped_type& data)
+{
+	if (findNode(key) != NULL)
+		return false;
+	insertNode(mRoot, key, data);
+	mRoot->IsRed = false;
+	mCount++;
+	return true;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename M>
+bool PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::insert_or_assign(const key_type& key, M&& data)
+{
+	if (findNode(key) == NULL)
+		return insert(key, std::forward<M>(data));
+	assignNode(mRoot, key, std::forward<M>(data));
+	return false;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+size_t PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::remove(const key_type& key)
+{
+	if (findNode(key) == NULL)
+		return 0;
+	if (!isRed(mRoot->Left) && !isRed(mRoot->Right))
+		mutableNode(mRoot)->IsRed = true;
+	removeNode(mRoot, key);
+	if (mRoot)
+		mRoot->IsRed = false;
+	mCount--;
+	return 1;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::clear()
+{
+	mRoot.makeNULL();
+	mCount = 0;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+bool PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::isValid() const
+{
+	if (isRed(mRoot))
+		return false;
+	size_t count = 0;
+	return checkSubtree(mRoot, count) > 0 && count == mCount;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::begin() const
+{
+	const_iterator it(mRoot);
+	for (const PersistentNode* node = mRoot; node != NULL; node = node->Left)
+		it.mPath.push_back(node);
+	return it;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::find(const key_type& key) const
+{
+	const_iterator it = lower_bound(key);
+	if (!it.mPath.empty() && mCompare(key, it.mPath.back()->Value.first))
+		it.mPath.clear();
+	return it;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::lower_bound(const key_type& key) const
+{
+	const_iterator it(mRoot);
+	size_t depth = 0;
+	for (const PersistentNode* node = mRoot; node != NULL;)
+	{
+		it.mPath.push_back(node);
+		if (mCompare(node->Value.first, key))
+			node = node->Right;
+		else
+		{
+			depth = it.mPath.size();
+			node = node->Left;
+		}
+	}
+	it.mPath.resize(depth);
+	return it;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator PersistentRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::upper_bound(const key_type& key) const
+{
+	const_iterator it(mRoot);
+	size_t depth = 0;
+	for (const PersistentNode* node = mRoot; node != NULL;)
+	{
+		it.mPath.push_back(node);
+		if (mCompare(key, node->Value.first))
+		{
+			depth = it.mPath.size();
+			node = node->Left;
+		}
+		else
+			node = node->Right;
+	}
+	it.mPath.resize(depth);
+	return it;
+}
+
+#endif // !PERSISTENT_RED_BLACK_TREE_H
@@ -2,237 +2,570 @@
 #ifndef RED_BLACK_TREE_H
 #define RED_BLACK_TREE_H
 
-#include "..\Headers\Mutex.h"
-#include "..\Headers\Pointer.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../Headers/KeySearch.h"
+#include "../Headers/KeyUniqueness.h"
+#include "../Headers/OperationCounters.h"
+#include "../Headers/OrderStatistics.h"
+#include "../Headers/Ownership.h"
+#include "../Headers/ThreadPool.h"
+#include "FrozenMap.h"
 
 //STRUCTURES
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-class RedBlackTree
+template<typename KEY_TYPE, typename MAPPED_TYPE,
+	typename COMPARE = std::less<KEY_TYPE>,
+	typename ALLOCATOR = std::allocator<std::pair<const KEY_TYPE, MAPPED_TYPE> >,
+	typename OWNERSHIP = ExclusiveOwnership,
+	typename ORDER_STATISTICS = WithoutOrderStatistics,
+	typename OPERATION_COUNTERS = WithoutOperationCounters,
+	typename KEY_UNIQUENESS = UniqueKeys>
+class RedBlackTree : private OPERATION_COUNTERS
 {
+	struct RedBlackNode;
 public:
 	typedef KEY_TYPE key_type;
 	typedef MAPPED_TYPE mapped_type;
 	typedef std::pair<const key_type, mapped_type> value_type;
+	typedef COMPARE key_compare;
+	typedef ALLOCATOR allocator_type;
+	typedef typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<RedBlackNode> node_allocator_type;
+	typedef OWNERSHIP ownership_type;
+	typedef ORDER_STATISTICS order_statistics_type;
+	typedef OPERATION_COUNTERS operation_counters_type;
+	typedef KEY_UNIQUENESS key_uniqueness_type;
+	typedef FrozenMap<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR> frozen_map_type;
+	class const_iterator;
 	class iterator;
 	RedBlackTree();
-	bool isEmpty() const { return mRoot == mSentinel; }
+	explicit RedBlackTree(const key_compare& compare, const allocator_type& allocator = allocator_type());
+	explicit RedBlackTree(const allocator_type& allocator);
+	/// sorted range is built in O(n), unsorted one is inserted item by item; sorted means strictly
+	/// ascending keys, or not descending ones with DuplicateKeys
+	template<typename ITERATOR>
+	RedBlackTree(ITERATOR first, ITERATOR last,
+		const key_compare& compare = key_compare(), const allocator_type& allocator = allocator_type());
+	RedBlackTree(const RedBlackTree& other);
+	RedBlackTree& operator=(const RedBlackTree& other);
+	~RedBlackTree();
+	void swap(RedBlackTree& other);
+	bool isEmpty() const { return mRoot->isSentinel(); }
 	size_t size() const { return mCount; }
-	iterator insert(const key_type& key, const mapped_type& data);
-	size_t remove(const key_type& key);
-	iterator begin();
-	iterator end();
-	iterator find(const key_type& key);
+	allocator_type get_allocator() const { return allocator_type(mAllocator); }
+	key_compare key_comp() const { return mCompare; }
+	iterator insert(const key_type& key, const mapped_type& data) { return try_emplace(key, data).first; }
+	iterator insert(key_type&& key, mapped_type&& data) { return try_emplace(std::move(key), std::move(data)).first; }
+	/// value is constructed before the search, so it is destroyed again if the key exists and is unique
+	template<typename... ARGS>
+	std::pair<iterator, bool> emplace(ARGS&&... args);
+	/// amortized O(1) if the key belongs right before or after hint, otherwise the search climbs from hint
+	iterator insert(const_iterator hint, const key_type& key, const mapped_type& data) { return insertHinted(hint, key, data); }
+	iterator insert(const_iterator hint, key_type&& key, mapped_type&& data) { return insertHinted(hint, std::move(key), std::move(data)); }
+	/// value is constructed before the search as in emplace, the position is found as in hinted insert
+	template<typename... ARGS>
+	iterator emplace_hint(const_iterator hint, ARGS&&... args);
+	/// mapped value is constructed from args only if the key is not present or DuplicateKeys are allowed
+	template<typename... ARGS>
+	std::pair<iterator, bool> try_emplace(const key_type& key, ARGS&&... args) { return tryEmplace(key, std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	std::pair<iterator, bool> try_emplace(key_type&& key, ARGS&&... args) { return tryEmplace(std::move(key), std::forward<ARGS>(args)...); }
+	template<typename M>
+	std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& data) { return insertOrAssign(key, std::forward<M>(data)); }
+	template<typename M>
+	std::pair<iterator, bool> insert_or_assign(key_type&& key, M&& data) { return insertOrAssign(std::move(key), std::forward<M>(data)); }
+	mapped_type& operator[](const key_type& key) { return subscript(key); }
+	mapped_type& operator[](key_type&& key) { return subscript(std::move(key)); }
+	/// remove items with given key, return count of removed items
+	size_t remove(const key_type& key) { return removeKey(key); }
+	/// remove item, return iterator to the next one
+	iterator erase(const_iterator position);
+	/// remove items in [first, last), amortized O(log n + k)
+	iterator erase(const_iterator first, const_iterator last);
+	/// insert items whose keys are not present, or all items with DuplicateKeys, return count of inserted items.
+	/// Batch is sorted and every search starts from the previous item, so close keys share the descent
+	template<typename ITERATOR>
+	size_t insertBatch(ITERATOR first, ITERATOR last);
+	/// remove all items of given keys, return count of removed items, searches are shared as in insertBatch
+	template<typename ITERATOR>
+	size_t removeBatch(ITERATOR first, ITERATOR last);
+	/// heterogeneous removal, available when COMPARE declares is_transparent
+	template<typename K, typename C = COMPARE, typename = typename C::is_transparent>
+	size_t remove(const K& key) { return removeKey(key); }
+	void clear();
+	/// replace content by sorted range in O(n), throws invalid_argument for other range
+	template<typename ITERATOR>
+	void assignSorted(ITERATOR first, ITERATOR last);
+	/// append item and all items of right tree, keys must ascend from this tree over key to right tree,
+	/// which is left empty. O(log n), nodes are moved without relinking.
+	/// Equal keys are accepted at the boundaries with DuplicateKeys
+	void join(const key_type& key, const mapped_type& data, RedBlackTree& right);
+	/// append all items of right tree, whose keys must be greater than keys of this tree, or not less with DuplicateKeys
+	void join(RedBlackTree& right);
+	/// move items with keys not less than given one to right tree, replacing its content. O(log n) with
+	/// WithOrderStatistics, otherwise the smaller side is counted in O(log n + min(k, n - k))
+	void split(const key_type& key, RedBlackTree& right);
+	/// add items of other tree whose keys are not present. Subtrees are split and joined in parallel
+	/// on the pool with O(m log(n/m + 1)) work for m items of the smaller tree; comparison must not throw.
+	/// Other tree is only read, just the added items are copied; if a copy throws, the items it would
+	/// add are left out and the exception is rethrown. Set operations need UniqueKeys
+	void unionWith(const RedBlackTree& other, ThreadPool& pool = ThreadPool::instance()) { applySetOperation(other, pool, &RedBlackTree::unionTrees); }
+	/// keep only items whose keys are present in other tree
+	void intersectWith(const RedBlackTree& other, ThreadPool& pool = ThreadPool::instance()) { applySetOperation(other, pool, &RedBlackTree::intersectTrees); }
+	/// remove items whose keys are present in other tree
+	void differenceWith(const RedBlackTree& other, ThreadPool& pool = ThreadPool::instance()) { applySetOperation(other, pool, &RedBlackTree::differenceTrees); }
+	/// immutable copy in Eytzinger layout for read-mostly lookups, O(n)
+	frozen_map_type freeze() const;
+	/// write image file of trivially copyable keys and values in the layout of frozen_map_type
+	void save(const std::string& path) const;
+	/// serve lookups and iteration of saved image from memory mapping without reading it first;
+	/// a mutable tree is built from the mapped range in O(n), e.g. RedBlackTree(mapped.begin(), mapped.end())
+	static frozen_map_type open_mapped(const std::string& path, const key_compare& compare = key_compare()) { return frozen_map_type::open_mapped(path, compare); }
+	/// true if ordering and red-black invariants hold
+	bool isValid() const;
+	iterator begin() { return iterator(mSentinel->Left); }
+	iterator end() { return iterator(mSentinel); }
+	const_iterator begin() const { return const_iterator(sentinel()->Left); }
+	const_iterator end() const { return const_iterator(sentinel()); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+	/// first of items with given key
+	iterator find(const key_type& key) { return iterator(findNode(key)); }
+	const_iterator find(const key_type& key) const { return const_iterator(findNode(key)); }
+	/// finger search, climbs from hint by parent links only as far as the key needs; with DuplicateKeys
+	/// it finds an item with given key, not necessarily the first one
+	iterator find(const_iterator hint, const key_type& key) { return iterator(findNearNode(hint.node(), key)); }
+	const_iterator find(const_iterator hint, const key_type& key) const { return const_iterator(findNearNode(hint.node(), key)); }
+	/// heterogeneous lookup, available when COMPARE declares is_transparent, e.g. std::less<>
+	template<typename K, typename C = COMPARE, typename = typename C::is_transparent>
+	iterator find(const K& key) { return iterator(findNode(key)); }
+	template<typename K, typename C = COMPARE, typename = typename C::is_transparent>
+	const_iterator find(const K& key) const { return const_iterator(findNode(key)); }
+	/// write find(key) of every key of the forward range to out in the same order; FindGroupSize searches
+	/// take turns in descending one level and prefetch their next nodes, so their cache misses overlap
+	template<typename KEY_ITERATOR, typename OUTPUT_ITERATOR>
+	OUTPUT_ITERATOR find_many(KEY_ITERATOR first, KEY_ITERATOR last, OUTPUT_ITERATOR out) { return findMany<iterator>(first, last, out); }
+	template<typename KEY_ITERATOR, typename OUTPUT_ITERATOR>
+	OUTPUT_ITERATOR find_many(KEY_ITERATOR first, KEY_ITERATOR last, OUTPUT_ITERATOR out) const { return findMany<const_iterator>(first, last, out); }
+	/// first item with key not less than given one
+	iterator lower_bound(const key_type& key) { return iterator(lowerBoundNode(key)); }
+	const_iterator lower_bound(const key_type& key) const { return const_iterator(lowerBoundNode(key)); }
+	template<typename K, typename C = COMPARE, typename = typename C::is_transparent>
+	iterator lower_bound(const K& key) { return iterator(lowerBoundNode(key)); }
+	template<typename K, typename C = COMPARE, typename = typename C::is_transparent>
+	const_iterator lower_bound(const K& key) const { return const_iterator(lowerBoundNode(key)); }
+	/// first item with key greater than given one
+	iterator upper_bound(const key_type& key) { return iterator(upperBoundNode(key)); }
+	const_iterator upper_bound(const key_type& key) const { return const_iterator(upperBoundNode(key)); }
+	template<typename K, typename C = COMPARE, typename = typename C::is_transparent>
+	iterator upper_bound(const K& key) { return iterator(upperBoundNode(key)); }
+	template<typename K, typename C = COMPARE, typename = typename C::is_transparent>
+	const_iterator upper_bound(const K& key) const { return const_iterator(upperBoundNode(key)); }
+	/// count of items with given key, O(log n + k)
+	size_t count(const key_type& key) const;
+	std::pair<iterator, iterator> equal_range(const key_type& key) { return equalRange<iterator>(key); }
+	std::pair<const_iterator, const_iterator> equal_range(const key_type& key) const { return equalRange<const_iterator>(key); }
+	template<typename K, typename C = COMPARE, typename = typename C::is_transparent>
+	std::pair<iterator, iterator> equal_range(const K& key) { return equalRange<iterator>(key); }
+	template<typename K, typename C = COMPARE, typename = typename C::is_transparent>
+	std::pair<const_iterator, const_iterator> equal_range(const K& key) const { return equalRange<const_iterator>(key); }
+	/// call function for items with low <= key < high in order until it returns false,
+	/// return false if it was stopped, O(log n + k)
+	template<typename FUNCTION>
+	bool forEachInRange(const key_type& low, const key_type& high, FUNCTION function) { return visitRange<value_type>(low, high, function); }
+	template<typename FUNCTION>
+	bool forEachInRange(const key_type& low, const key_type& high, FUNCTION function) const { return visitRange<const value_type>(low, high, function); }
+	/// call function for every item, subtrees are visited in parallel on the pool in no particular order,
+	/// so the function must be safe to call from several threads; the tree must not change meanwhile
+	template<typename FUNCTION>
+	void parallel_for_each(FUNCTION function, ThreadPool& pool = ThreadPool::instance()) { visitParallel<value_type>(function, pool); }
+	template<typename FUNCTION>
+	void parallel_for_each(FUNCTION function, ThreadPool& pool = ThreadPool::instance()) const { visitParallel<const value_type>(function, pool); }
+	/// combine(init, map(item)) over items in key order, results of subtrees are computed in parallel and
+	/// combined left to right, so combine must be associative but need not be commutative; init must be its identity
+	template<typename T, typename MAP, typename COMBINE>
+	T parallel_reduce(T init, MAP map, COMBINE combine, ThreadPool& pool = ThreadPool::instance()) const;
+	/// call function for items with low <= key < high, subtrees are visited in parallel in no particular order
+	template<typename FUNCTION>
+	void parallel_for_each_in_range(const key_type& low, const key_type& high, FUNCTION function, ThreadPool& pool = ThreadPool::instance()) { visitRangeParallel<value_type>(low, high, function, pool); }
+	template<typename FUNCTION>
+	void parallel_for_each_in_range(const key_type& low, const key_type& high, FUNCTION function, ThreadPool& pool = ThreadPool::instance()) const { visitRangeParallel<const value_type>(low, high, function, pool); }
+	/// item with given zero based position in key order, end() if there is no such, needs WithOrderStatistics
+	iterator select(size_t position) { return iterator(selectNode(position)); }
+	const_iterator select(size_t position) const { return const_iterator(selectNode(position)); }
+	/// count of keys less than given one, needs WithOrderStatistics
+	size_t rank(const key_type& key) const;
+	/// count of keys with low <= key < high, needs WithOrderStatistics
+	size_t countRange(const key_type& low, const key_type& high) const;
+	/// height, black height and bytes per entry in O(n), operation counts need WithOperationCounters
+	TreeStatistics stats() const;
+	/// zero operation counts
+	void resetStats() { OPERATION_COUNTERS::reset(); }
 private:
-	struct RedBlackNode;
+	typedef std::allocator_traits<node_allocator_type> node_allocator_traits;
+	typedef typename OWNERSHIP::template Link<RedBlackNode> node_link;
+	typedef typename OWNERSHIP::template Guard<RedBlackNode> node_guard;
+	node_allocator_type mAllocator;
+	key_compare mCompare;
 	size_t mCount;
-	AutoRefPtr<RedBlackNode> mSentinel;
-	AutoRefPtr<RedBlackNode> mRoot;
+	node_link mSentinel;
+	node_link mRoot;
+
+	/// recursion over subtrees forked on the pool down to a depth
+	struct ParallelRecursion
+	{
+		/// items bound the tasks count, so a task is not smaller than MinTaskItems
+		ParallelRecursion(ThreadPool& pool, size_t items = size_t(-1)) : Pool(pool), ForkDepth(0)
+		{
+			//several tasks per thread even out unequal subtrees
+			for (size_t tasks = 1; tasks < (pool.threadsCount() + 1) * 8 && tasks * MinTaskItems < items; tasks *= 2)
+				ForkDepth++;
+		}
+		template<typename FIRST, typename SECOND>
+		void fork(int depth, FIRST&& first, SECOND&& second)
+		{
+			if (depth < ForkDepth)
+				Pool.invoke(std::forward<FIRST>(first), std::forward<SECOND>(second));
+			else
+			{
+				first();
+				second();
+			}
+		}
+		static const size_t MinTaskItems = 1024;
+		ThreadPool& Pool;
+		int ForkDepth;
+	};
+	/// state shared by parallel branches of union, intersection and difference
+	struct SetOperation : ParallelRecursion
+	{
+		/// stateless allocators such as std::allocator are shared by threads safely, others are called under Mutex
+		static const bool IsAllocationLocked = !std::is_empty<node_allocator_type>::value;
 
-	void rotateLeft(RedBlackNode* x);
-	void rotateRight(RedBlackNode* x);
-	void restoreAfterInsert(RedBlackNode* x);
-	void restoreAfterDelete(RedBlackNode* x);
+		SetOperation(ThreadPool& pool) : ParallelRecursion(pool), Added(0), IsFailed(false) {}
+		void discard(const node_link& node)
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Discarded.push_back(node);
+		}
+		std::mutex Mutex;
+		std::vector<node_link> Discarded;
+		/// count of nodes copied from other tree
+		std::atomic<size_t> Added;
+		/// set with Failure, read without Mutex
+		std::atomic<bool> IsFailed;
+		/// first failed copy, no copy is made after it
+		std::exception_ptr Failure;
+	};
+	typedef node_link (RedBlackTree::*set_operation_type)(node_link, int, const RedBlackNode*, int, int&, SetOperation&, int);
+
+	template<typename LEFT, typename RIGHT>
+	bool compareKeys(const LEFT& left, const RIGHT& right) const { if (OPERATION_COUNTERS::IsCounting) OPERATION_COUNTERS::countComparison(); return mCompare(left, right); }
+	/// true if left key may precede right one in the tree, equal keys may only with DuplicateKeys
+	template<typename LEFT, typename RIGHT>
+	bool isOrdered(const LEFT& left, const RIGHT& right) const { return KEY_UNIQUENESS::AllowsDuplicates ? !compareKeys(right, left) : compareKeys(left, right); }
+	void rotateLeft(RedBlackNode* x) { rotateLeft(x, mRoot); }
+	void rotateRight(RedBlackNode* x) { rotateRight(x, mRoot); }
+	void restoreAfterInsert(RedBlackNode* x) { restoreAfterInsert(x, mRoot); }
+	/// root is the root of the tree or of a detached subtree
+	void rotateLeft(RedBlackNode* x, node_link& root);
+	void rotateRight(RedBlackNode* x, node_link& root);
+	/// return true if the root was recolored, which raises black height
+	bool restoreAfterInsert(RedBlackNode* x, node_link& root);
+	/// x may be a leaf, which is shared and does not know its parent
+	void restoreAfterDelete(RedBlackNode* x, RedBlackNode* parent);
 	void remove(RedBlackNode* node);
+	template<typename... ARGS>
+	RedBlackNode* createNode(ARGS&&... args);
+	void destroyNode(RedBlackNode* node);
+	RedBlackNode* findInsertPosition(const key_type& key, RedBlackNode*& parent, bool& isLeft) const { return findInsertPosition(mRoot, key, parent, isLeft); }
+	RedBlackNode* findInsertPosition(const RedBlackNode* start, const key_type& key, RedBlackNode*& parent, bool& isLeft) const;
+	RedBlackNode* coveringSubtree(const RedBlackNode* finger, const key_type& key) const;
+	RedBlackNode* findHintedPosition(const RedBlackNode* hint, const key_type& key, RedBlackNode*& parent, bool& isLeft) const;
+	RedBlackNode* findNearNode(const RedBlackNode* hint, const key_type& key) const;
+	void attachNode(RedBlackNode* node, RedBlackNode* parent, bool isLeft);
+	template<typename K, typename... ARGS>
+	std::pair<iterator, bool> tryEmplace(K&& key, ARGS&&... args);
+	template<typename K, typename M>
+	std::pair<iterator, bool> insertOrAssign(K&& key, M&& data);
+	template<typename K, typename M>
+	iterator insertHinted(const_iterator hint, K&& key, M&& data);
+	template<typename K>
+	mapped_type& subscript(K&& key);
+	RedBlackNode* createSentinel();
+	/// free sentinel of empty tree, its bound links are cleared first, so no reference cycle keeps it alive
+	void destroySentinel();
+	RedBlackNode* sentinel() const { return const_cast<RedBlackNode*>(static_cast<const RedBlackNode*>(mSentinel)); }
+	/// leaf of all trees of the type, only the outer leaves of the first and last node link the sentinel
+	RedBlackNode* leaf() const;
+	/// storage of leaf(), its address tells the leaf apart without reading it
+	static RedBlackNode* leafAddress();
+	template<typename K>
+	RedBlackNode* findNode(const K& key) const;
+	/// searches interleaved by find_many, enough to keep the memory busy with their misses
+	static const size_t FindGroupSize = 16;
+	template<typename ITERATOR, typename KEY_ITERATOR, typename OUTPUT_ITERATOR>
+	OUTPUT_ITERATOR findMany(KEY_ITERATOR first, KEY_ITERATOR last, OUTPUT_ITERATOR out) const;
+	template<typename K>
+	size_t removeKey(const K& key);
+	/// remove node and the nodes with equal key following it, return count of removed nodes
+	template<typename K>
+	size_t removeDuplicates(RedBlackNode* node, const K& key);
+	template<typename K>
+	RedBlackNode* lowerBoundNode(const K& key) const { return lowerBoundNode(mRoot, key); }
+	template<typename K>
+	RedBlackNode* lowerBoundNode(const RedBlackNode* start, const K& key) const;
+	template<typename K>
+	RedBlackNode* upperBoundNode(const K& key) const;
+	template<typename ITERATOR, typename K>
+	std::pair<ITERATOR, ITERATOR> equalRange(const K& key) const;
+	template<typename VALUE, typename FUNCTION>
+	bool visitRange(const key_type& low, const key_type& high, FUNCTION& function) const;
+	template<typename VALUE, typename FUNCTION>
+	void visitParallel(FUNCTION& function, ThreadPool& pool) const;
+	template<typename VALUE, typename FUNCTION>
+	void visitRangeParallel(const key_type& low, const key_type& high, FUNCTION& function, ThreadPool& pool) const;
+	/// in-order visit of subtree, forked above recursion depth; null bound is not checked, keys of the subtree are within it
+	template<typename VALUE, typename FUNCTION>
+	void visitSubtree(RedBlackNode* node, const key_type* low, const key_type* high, FUNCTION& function, ParallelRecursion& recursion, int depth) const;
+	template<typename T, typename MAP, typename COMBINE>
+	T reduceSubtree(const RedBlackNode* node, const T& init, MAP& map, COMBINE& combine, ParallelRecursion& recursion, int depth) const;
+	/// fold subtree into result in key order without forking
+	template<typename T, typename MAP, typename COMBINE>
+	void accumulateSubtree(const RedBlackNode* node, T& result, MAP& map, COMBINE& combine) const;
+	RedBlackNode* selectNode(size_t position) const;
+	/// link outer leaves of the first and last node to the sentinel
+	void updateBounds();
+	/// link them to the shared leaf again, so the nodes can be moved as detached subtrees
+	void detachBounds();
+	RedBlackNode* copySubtree(const RedBlackNode* node, RedBlackNode* parent);
+	void destroySubtree(RedBlackNode* node);
+	template<typename ITERATOR>
+	bool isSorted(ITERATOR first, ITERATOR last, size_t& count) const;
+	template<typename ITERATOR>
+	void buildFromSorted(ITERATOR first, size_t count);
+	template<typename ITERATOR>
+	RedBlackNode* buildSubtree(ITERATOR& it, size_t count, size_t depth, size_t redDepth);
+	int checkSubtree(const RedBlackNode* node, const RedBlackNode* parent) const;
+	//detached subtrees have black root without parent and the shared leaf as leaves,
+	//heights are black heights, a leaf is an empty subtree
+	int blackHeight(const RedBlackNode* root) const;
+	void exposeTree(RedBlackNode* root, int height, node_link& left, int& leftHeight, node_link& right, int& rightHeight);
+	node_link joinTrees(node_link left, int leftHeight, RedBlackNode* middle, node_link right, int rightHeight, int& height);
+	node_link concatTrees(node_link left, int leftHeight, node_link right, int rightHeight, int& height);
+	void splitTree(node_link root, int height, const key_type& key, node_link& left, int& leftHeight, node_link& found, node_link& right, int& rightHeight);
+	node_link splitLast(node_link root, int height, node_link& rest, int& restHeight);
+	node_link adoptNodes(RedBlackTree& other);
+	void checkExchange(const RedBlackTree& other) const;
+	void applySetOperation(const RedBlackTree& other, ThreadPool& pool, set_operation_type operation);
+	/// black copy of node of other tree, or of its subtree, made under the lock of the operation only for
+	/// stateful allocators, which need not be thread safe; NULL if this or an earlier copy failed
+	RedBlackNode* copyForOperation(const RedBlackNode* node, bool isSubtree, SetOperation& operation);
+	//first is a detached subtree of this tree, second a subtree of other tree read in place,
+	//its height is the black height it would have with a black root
+	node_link unionTrees(node_link first, int firstHeight, const RedBlackNode* second, int secondHeight, int& height, SetOperation& operation, int depth);
+	node_link intersectTrees(node_link first, int firstHeight, const RedBlackNode* second, int secondHeight, int& height, SetOperation& operation, int depth);
+	node_link differenceTrees(node_link first, int firstHeight, const RedBlackNode* second, int secondHeight, int& height, SetOperation& operation, int depth);
+	size_t countSubtree(const RedBlackNode* node) const;
+	size_t subtreeHeight(const RedBlackNode* node) const;
 };
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-struct RedBlackTree<KEY_TYPE, MAPPED_TYPE>::RedBlackNode
+/// RedBlackTree keeping all items with equal keys in insertion order, as std::multimap
+template<typename KEY_TYPE, typename MAPPED_TYPE,
+	typename COMPARE = std::less<KEY_TYPE>,
+	typename ALLOCATOR = std::allocator<std::pair<const KEY_TYPE, MAPPED_TYPE> >,
+	typename OWNERSHIP = ExclusiveOwnership,
+	typename ORDER_STATISTICS = WithoutOrderStatistics,
+	typename OPERATION_COUNTERS = WithoutOperationCounters>
+using RedBlackMultiTree = RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, DuplicateKeys>;
+
+/// Node stores its key/value pair inline. The value is left unconstructed in the sentinel,
+/// which is recognized by being its own parent. Sentinel Left and Right hold the leftmost
+/// and rightmost node. Leaves are a node of the same kind shared by all trees, so subtrees
+/// move between trees unchanged; only the left leaf of the leftmost node and the right leaf
+/// of the rightmost one are the sentinel, which next and previous reach past the ends.
+/// Reference counter, if any, lives in the ownership policy base, subtree size, if any,
+/// in the order statistics base wrapped around it.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+struct RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode
+	: public ORDER_STATISTICS::template NodeBase<typename OWNERSHIP::template NodeBase<RedBlackNode, node_allocator_type> >
 {
-	value_type* Value;
-	AutoRefPtr<RedBlackNode> Left;
-	AutoRefPtr<RedBlackNode> Right;
+	typedef typename ORDER_STATISTICS::template NodeBase<typename OWNERSHIP::template NodeBase<RedBlackNode, node_allocator_type> > base_type;
+	node_link Left;
+	node_link Right;
 	RedBlackNode* Parent;
 	bool IsRed;
-	RefCount mRefCount;
+	union { value_type Value; };
 
-	RedBlackNode() : Value(NULL), Left(NULL), Right(NULL), Parent(NULL), IsRed(true) {}
-	RedBlackNode(const key_type& key, const mapped_type& data) : Left(NULL), Right(NULL), Parent(NULL), IsRed(true)
+	RedBlackNode(const node_allocator_type& allocator)
+		: base_type(allocator), Left(NULL), Right(NULL), Parent(this), IsRed(false) {}
+	template<typename... ARGS>
+	RedBlackNode(const node_allocator_type& allocator, ARGS&&... args)
+		: base_type(allocator), Left(NULL), Right(NULL), Parent(NULL), IsRed(true), Value(std::forward<ARGS>(args)...) {}
+	~RedBlackNode()
 	{
-		Value = new value_type(key, data);
+		if (!isSentinel())
+			Value.~value_type();
 	}
-	~RedBlackNode() { delete Value; }
-	void reference() { mRefCount.reference(); }
-	void dereference()
+	bool isSentinel() const { return Parent == this; }
+	/// links to the shared leaf are not counted, as it is never freed and its counter would be
+	/// written by every thread linking it
+	void reference() { if (this != RedBlackTree::leafAddress()) base_type::reference(); }
+	void dereference() { if (this != RedBlackTree::leafAddress()) base_type::dereference(); }
+	/// in-order successor, sentinel after the last node
+	RedBlackNode* next()
 	{
-		if (mRefCount.dereference())
-			delete this;
+		RedBlackNode* node = this;
+		if (!node->Right->isSentinel())
+		{
+			node = node->Right;
+			while (!node->Left->isSentinel())
+				node = node->Left;
+			return node;
+		}
+		RedBlackNode* sentinel = node->Right;
+		while (node->Parent != NULL && node == node->Parent->Right)
+			node = node->Parent;
+		return node->Parent != NULL ? node->Parent : sentinel;
+	}
+	/// in-order predecessor, sentinel before the first node
+	RedBlackNode* previous()
+	{
+		RedBlackNode* node = this;
+		if (!node->Left->isSentinel())
+		{
+			node = node->Left;
+			while (!node->Right->isSentinel())
+				node = node->Right;
+			return node;
+		}
+		RedBlackNode* sentinel = node->Left;
+		while (node->Parent != NULL && node == node->Parent->Left)
+			node = node->Parent;
+		return node->Parent != NULL ? node->Parent : sentinel;
 	}
 };
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-class RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+class RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::const_iterator
 	: public std::iterator<std::bidirectional_iterator_tag,
-	typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::value_type,
+	typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::value_type,
 	std::ptrdiff_t,
-	typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::value_type*,
-	typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::value_type&>
+	const typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::value_type*,
+	const typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::value_type&>
 {
 public:
-	iterator();
-	iterator(const iterator& src);
-	iterator& operator=(const iterator& src);
-	value_type& operator*()
+	const_iterator() : mNode(NULL) {}
+	const value_type& operator*() const
 	{
-		if (mIsAfterLast || mIsBeforeFirst)
+		if (!mNode || mNode->isSentinel())
 			throw std::runtime_error(std::string("Cannot be dereferenced"));
-		return *mNode->Value;
+		return mNode->Value;
 	}
-	value_type* operator->()
+	const value_type* operator->() const
 	{
-		if (mIsAfterLast || mIsBeforeFirst)
+		if (!mNode || mNode->isSentinel())
 			throw std::runtime_error(std::string("Cannot be referenced"));
-		return mNode->Value;
+		return &mNode->Value;
 	}
-	iterator& operator++();
-	iterator operator++(int);
-	iterator& operator--();
-	iterator operator--(int);
-	bool operator==(const iterator& right) const;
-	bool operator!=(const iterator& right) const;
-private:
-	AutoRefPtr<RedBlackNode> mNode;
-	bool mIsAfterLast;
-	bool mIsBeforeFirst;
-	AutoRefPtr<RedBlackNode> mSentinel;
+	const_iterator& operator++() { increment(); return *this; }
+	const_iterator operator++(int) { const_iterator retIt = *this; increment(); return retIt; }
+	const_iterator& operator--() { decrement(); return *this; }
+	const_iterator operator--(int) { const_iterator retIt = *this; decrement(); return retIt; }
+	bool operator==(const const_iterator& right) const { return mNode == right.mNode; }
+	bool operator!=(const const_iterator& right) const { return mNode != right.mNode; }
+protected:
+	node_link mNode;
 	friend RedBlackTree;
-	iterator(RedBlackNode* node, bool isAfterLast, bool isBeforeFirst, RedBlackNode* sentinel);
+	explicit const_iterator(RedBlackNode* node) : mNode(node) {}
+	RedBlackNode* node() const { return const_cast<RedBlackNode*>(static_cast<const RedBlackNode*>(mNode)); }
+	void increment();
+	void decrement();
 };
 
-//ITERATOR METHODS
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator::iterator()
-	: mNode(NULL), mIsAfterLast(true), mIsBeforeFirst(true), mSentinel(NULL) {}
-
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator::iterator(const iterator& src)
-	: mNode(src.mNode), mIsAfterLast(src.mIsAfterLast), mIsBeforeFirst(src.mIsBeforeFirst), mSentinel(src.mSentinel) {}
-
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator::iterator(RedBlackNode* node, bool isAfterLast, bool isBeforeFirst, RedBlackNode* sentinel)
-	: mNode(node), mIsAfterLast(isAfterLast), mIsBeforeFirst(isBeforeFirst), mSentinel(sentinel) {}
-
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator& RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator::operator=(const iterator& src)
+/// Iterator is a single node link, end() is the sentinel.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+class RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::iterator : public RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::const_iterator
 {
-	if (*this != src)
-	{
-		mNode = src.mNode;
-		mIsAfterLast = src.mIsAfterLast;
-		mIsBeforeFirst = src.mIsBeforeFirst;
-		mSentinel = src.mSentinel;
-	}
-	return *this;
-}
+public:
+	typedef value_type* pointer;
+	typedef value_type& reference;
+	iterator() {}
+	value_type& operator*() const { return const_cast<value_type&>(const_iterator::operator*()); }
+	value_type* operator->() const { return const_cast<value_type*>(const_iterator::operator->()); }
+	iterator& operator++() { this->increment(); return *this; }
+	iterator operator++(int) { iterator retIt = *this; this->increment(); return retIt; }
+	iterator& operator--() { this->decrement(); return *this; }
+	iterator operator--(int) { iterator retIt = *this; this->decrement(); return retIt; }
+private:
+	friend RedBlackTree;
+	explicit iterator(RedBlackNode* node) : const_iterator(node) {}
+};
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator& RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator::operator++()
+//ITERATOR METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::const_iterator::increment()
 {
-	if (mIsAfterLast)
+	if (!mNode || mNode->isSentinel())
 		throw std::out_of_range("Iterator cannot be increment.");
-	if (mIsBeforeFirst)
-	{
-		mIsBeforeFirst = false;
-		return *this;
-	}
-	if (mNode->Right != mSentinel)
-	{
-		mNode = mNode->Right;
-		while (mNode->Left != mSentinel)
-			mNode = mNode->Left;
-	}
-	else
-	{
-		RedBlackNode* temp = mNode;
-		while (mNode->Parent != NULL && mNode == mNode->Parent->Right)
-			mNode = mNode->Parent;
-		if (mNode->Parent == NULL)
-		{
-			mNode = temp;
-			mIsAfterLast = true;
-		}
-		else
-			mNode = mNode->Parent;
-	}
-	return *this;
-}
-
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator::operator++(int)
-{
-	RedBlackTree::iterator retIt = *this;
-	++(*this);
-	return retIt;
-}
-
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-bool RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator::operator==(const iterator& right) const
-{
-	if (this == &right)
-		return true;
-	if (mIsAfterLast != right.mIsAfterLast || mIsBeforeFirst != right.mIsBeforeFirst)
-		return false;
-	return this->mNode == right.mNode;
+	mNode = node()->next();
 }
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-bool RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator::operator!=(const iterator& right) const
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::const_iterator::decrement()
 {
-	if (this == &right)
-		return false;
-	if (mIsAfterLast != right.mIsAfterLast || mIsBeforeFirst != right.mIsBeforeFirst)
-		return true;
-	return this->mNode != right.mNode;
+	if (!mNode)
+		throw std::out_of_range("Iterator cannot be decrement.");
+	RedBlackNode* previous = node()->isSentinel() ? static_cast<RedBlackNode*>(node()->Right) : node()->previous();
+	if (previous->isSentinel())
+		throw std::out_of_range("Iterator cannot be decrement.");
+	mNode = previous;
 }
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator& RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator::operator--()
+//PRIVATE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::selectNode(size_t position) const
 {
-	if (mIsBeforeFirst || (!mIsAfterLast && mNode->Left == mSentinel && mNode->Parent == NULL))
-		throw std::out_of_range("Iterator cannot be decrement.");
-	if (mIsAfterLast)
-	{
-		mIsAfterLast = false;
-		return *this;
-	}
-	if (mNode->Left != mSentinel)
-	{
-		mNode = mNode->Left;
-		while (mNode->Right != mSentinel)
-			mNode = mNode->Right;
-	}
-	else
+	static_assert(ORDER_STATISTICS::HasSubtreeSize, "select needs WithOrderStatistics policy");
+	RedBlackNode* node = const_cast<RedBlackNode*>(static_cast<const RedBlackNode*>(mRoot));
+	while (!node->isSentinel())
 	{
-		RedBlackNode* temp = mNode;
-		while (mNode->Parent != NULL && mNode == mNode->Parent->Left)
-			mNode = mNode->Parent;
-		if (mNode->Parent == NULL)
+		size_t leftSize = node->Left->SubtreeSize;
+		if (position < leftSize)
+			node = node->Left;
+		else if (position == leftSize)
+			return node;
+		else
 		{
-			mNode = temp;
-			mIsBeforeFirst = true;
+			position -= leftSize + 1;
+			node = node->Right;
 		}
-		else
-			mNode = mNode->Parent;
 	}
-	return *this;
-}
-
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator::operator--(int)
-{
-	RedBlackTree::iterator retIt = *this;
-	--(*this);
-	return retIt;
+	return sentinel();
 }
 
-//PRIVATE METHODS
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::rotateLeft(typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::RedBlackNode* x)
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::rotateLeft(typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* x, node_link& root)
 {
-	RedBlackNode* y = x->Right;
+	if (OPERATION_COUNTERS::IsCounting)
+		OPERATION_COUNTERS::countRotation();
+	node_guard xGuard(x);
+	node_link y = x->Right;
 	x->Right = y->Left;
-	if (y->Left != mSentinel)
+	if (!y->Left->isSentinel())
 		y->Left->Parent = x;
-	if (y != mSentinel)
+	if (!y->isSentinel())
 		y->Parent = x->Parent;
 	if (x->Parent != NULL)
 	{
@@ -242,20 +575,28 @@ void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::rotateLeft(typename RedBlackTree<KEY_T
 			x->Parent->Right = y;
 	}
 	else
-		mRoot = y;
+		root = y;
 	y->Left = x;
-	if (x != mSentinel)
+	if (!x->isSentinel())
+	{
 		x->Parent = y;
+		ORDER_STATISTICS::update(x);
+	}
+	if (!y->isSentinel())
+		ORDER_STATISTICS::update(static_cast<RedBlackNode*>(y));
 }
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::rotateRight(typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::RedBlackNode* x)
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::rotateRight(typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* x, node_link& root)
 {
-	RedBlackNode* y = x->Left;
+	if (OPERATION_COUNTERS::IsCounting)
+		OPERATION_COUNTERS::countRotation();
+	node_guard xGuard(x);
+	node_link y = x->Left;
 	x->Left = y->Right;
-	if (y->Right != mSentinel)
+	if (!y->Right->isSentinel())
 		y->Right->Parent = x;
-	if (y != mSentinel)
+	if (!y->isSentinel())
 		y->Parent = x->Parent;
 	if (x->Parent != NULL)
 	{
@@ -265,17 +606,22 @@ void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::rotateRight(typename RedBlackTree<KEY_
 			x->Parent->Left = y;
 	}
 	else
-		mRoot = y;
+		root = y;
 	y->Right = x;
-	if (x != mSentinel)
+	if (!x->isSentinel())
+	{
 		x->Parent = y;
+		ORDER_STATISTICS::update(x);
+	}
+	if (!y->isSentinel())
+		ORDER_STATISTICS::update(static_cast<RedBlackNode*>(y));
 }
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::restoreAfterInsert(typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::RedBlackNode* x)
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+bool RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::restoreAfterInsert(typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* x, node_link& root)
 {
 	RedBlackNode* y;
-	while (x != mRoot && x->Parent != NULL && x->Parent->IsRed)
+	while (x != root && x->Parent != NULL && x->Parent->IsRed)
 	{
 		if (x->Parent == x->Parent->Parent->Left)
 		{
@@ -285,6 +631,8 @@ void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::restoreAfterInsert(typename RedBlackTr
 				x->Parent->IsRed = false;
 				y->IsRed = false;
 				x->Parent->Parent->IsRed = true;
+				if (OPERATION_COUNTERS::IsCounting)
+					OPERATION_COUNTERS::countRecolorings(3);
 				x = x->Parent->Parent;
 			}
 			else
@@ -292,11 +640,13 @@ void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::restoreAfterInsert(typename RedBlackTr
 				if (x == x->Parent->Right)
 				{
 					x = x->Parent;
-					rotateLeft(x);
+					rotateLeft(x, root);
 				}
 				x->Parent->IsRed = false;
 				x->Parent->Parent->IsRed = true;
-				rotateRight(x->Parent->Parent);
+				if (OPERATION_COUNTERS::IsCounting)
+					OPERATION_COUNTERS::countRecolorings(2);
+				rotateRight(x->Parent->Parent, root);
 			}
 		}
 		else
@@ -307,6 +657,8 @@ void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::restoreAfterInsert(typename RedBlackTr
 				x->Parent->IsRed = false;
 				y->IsRed = false;
 				x->Parent->Parent->IsRed = true;
+				if (OPERATION_COUNTERS::IsCounting)
+					OPERATION_COUNTERS::countRecolorings(3);
 				x = x->Parent->Parent;
 			}
 			else
@@ -314,37 +666,48 @@ void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::restoreAfterInsert(typename RedBlackTr
 				if (x == x->Parent->Left)
 				{
 					x = x->Parent;
-					rotateRight(x);
+					rotateRight(x, root);
 				}
 				x->Parent->IsRed = false;
 				x->Parent->Parent->IsRed = true;
-				rotateLeft(x->Parent->Parent);
+				if (OPERATION_COUNTERS::IsCounting)
+					OPERATION_COUNTERS::countRecolorings(2);
+				rotateLeft(x->Parent->Parent, root);
 			}
 		}
 	}
-	mRoot->IsRed = false;
+	bool isRecolored = root->IsRed;
+	root->IsRed = false;
+	if (OPERATION_COUNTERS::IsCounting)
+		OPERATION_COUNTERS::countRecolorings(isRecolored ? 1 : 0);
+	return isRecolored;
 }
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::restoreAfterDelete(typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::RedBlackNode* x)
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::restoreAfterDelete(typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* x, typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* parent)
 {
 	RedBlackNode* y;
 	while (x != mRoot && !x->IsRed)
 	{
-		if (x == x->Parent->Left)
+		if (x == parent->Left)
 		{
-			y = x->Parent->Right;
+			y = parent->Right;
 			if (y->IsRed)
 			{
 				y->IsRed = false;
-				x->Parent->IsRed = true;
-				rotateLeft(x->Parent);
-				y = x->Parent->Right;
+				parent->IsRed = true;
+				if (OPERATION_COUNTERS::IsCounting)
+					OPERATION_COUNTERS::countRecolorings(2);
+				rotateLeft(parent);
+				y = parent->Right;
 			}
 			if (!y->Left->IsRed && !y->Right->IsRed)
 			{
 				y->IsRed = true;
-				x = x->Parent;
+				if (OPERATION_COUNTERS::IsCounting)
+					OPERATION_COUNTERS::countRecolorings(1);
+				x = parent;
+				parent = x->Parent;
 			}
 			else
 			{
@@ -352,30 +715,39 @@ void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::restoreAfterDelete(typename RedBlackTr
 				{
 					y->Left->IsRed = false;
 					y->IsRed = true;
+					if (OPERATION_COUNTERS::IsCounting)
+						OPERATION_COUNTERS::countRecolorings(2);
 					rotateRight(y);
-					y = x->Parent->Right;
+					y = parent->Right;
 				}
-				y->IsRed = x->Parent->IsRed;
-				x->Parent->IsRed = false;
+				y->IsRed = parent->IsRed;
+				parent->IsRed = false;
 				y->Right->IsRed = false;
-				rotateLeft(x->Parent);
+				if (OPERATION_COUNTERS::IsCounting)
+					OPERATION_COUNTERS::countRecolorings(3);
+				rotateLeft(parent);
 				x = mRoot;
 			}
 		}
 		else
 		{
-			y = x->Parent->Left;
+			y = parent->Left;
 			if (y->IsRed)
 			{
 				y->IsRed = false;
-				x->Parent->IsRed = true;
-				rotateRight(x->Parent);
-				y = x->Parent->Left;
+				parent->IsRed = true;
+				if (OPERATION_COUNTERS::IsCounting)
+					OPERATION_COUNTERS::countRecolorings(2);
+				rotateRight(parent);
+				y = parent->Left;
 			}
 			if (!y->Right->IsRed && !y->Left->IsRed)
 			{
 				y->IsRed = true;
-				x = x->Parent;
+				if (OPERATION_COUNTERS::IsCounting)
+					OPERATION_COUNTERS::countRecolorings(1);
+				x = parent;
+				parent = x->Parent;
 			}
 			else
 			{
@@ -383,35 +755,57 @@ void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::restoreAfterDelete(typename RedBlackTr
 				{
 					y->Right->IsRed = false;
 					y->IsRed = true;
+					if (OPERATION_COUNTERS::IsCounting)
+						OPERATION_COUNTERS::countRecolorings(2);
 					rotateLeft(y);
-					y = x->Parent->Left;
+					y = parent->Left;
 				}
-				y->IsRed = x->Parent->IsRed;
-				x->Parent->IsRed = false;
+				y->IsRed = parent->IsRed;
+				parent->IsRed = false;
 				y->Left->IsRed = false;
-				rotateRight(x->Parent);
+				if (OPERATION_COUNTERS::IsCounting)
+					OPERATION_COUNTERS::countRecolorings(3);
+				rotateRight(parent);
 				x = mRoot;
 			}
 		}
 	}
-	x->IsRed = false;
+	//a leaf is black and is never written
+	if (x->IsRed)
+	{
+		x->IsRed = false;
+		if (OPERATION_COUNTERS::IsCounting)
+			OPERATION_COUNTERS::countRecolorings(1);
+	}
 }
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::remove(typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::RedBlackNode* node)
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::remove(typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* node)
 {
+	node_guard nodeGuard(node);
+	if (node == mSentinel->Left)
+		mSentinel->Left = node->next();
+	if (node == mSentinel->Right)
+		mSentinel->Right = node->previous();
 	RedBlackNode* x;
 	RedBlackNode* y;
-	if (node->Left == mSentinel || node->Right == mSentinel)
+	if (node->Left->isSentinel() || node->Right->isSentinel())
 		y = node;
 	else
 	{
 		y = node->Left;
-		while (y->Right != mSentinel)
+		while (!y->Right->isSentinel())
 			y = y->Right;
 	}
-	x = y->Left != mSentinel ? y->Left : y->Right;
-	x->Parent = y->Parent;
+	node_guard yGuard(y);
+	for (RedBlackNode* ancestor = y->Parent; ancestor != NULL; ancestor = ancestor->Parent)
+		ORDER_STATISTICS::decrement(ancestor);
+	bool isRemovedRed = y->IsRed;
+	x = !y->Left->isSentinel() ? y->Left : y->Right;
+	//x may be a leaf, so its parent is kept aside
+	RedBlackNode* xParent = y->Parent;
+	if (!x->isSentinel())
+		x->Parent = y->Parent;
 	if (y->Parent != NULL)
 		if (y == y->Parent->Left)
 			y->Parent->Left = x;
@@ -421,112 +815,1470 @@ void RedBlackTree<KEY_TYPE, MAPPED_TYPE>::remove(typename RedBlackTree<KEY_TYPE,
 		mRoot = x;
 	if (y != node)
 	{
-		node->Value = y->Value;
+		//relink predecessor into the place of removed node, values never move between nodes
+		y->Left = node->Left;
+		y->Right = node->Right;
+		y->Parent = node->Parent;
+		y->IsRed = node->IsRed;
+		ORDER_STATISTICS::update(y);
+		if (!y->Left->isSentinel())
+			y->Left->Parent = y;
+		if (!y->Right->isSentinel())
+			y->Right->Parent = y;
+		if (node->Parent != NULL)
+			if (node == node->Parent->Left)
+				node->Parent->Left = y;
+			else
+				node->Parent->Right = y;
+		else
+			mRoot = y;
+		if (xParent == node)
+			xParent = y;
+	}
+	if (!isRemovedRed)
+		restoreAfterDelete(x, xParent);
+	//the sentinel leaf of a removed bound node may have been dropped for a shared one
+	if (!isEmpty())
+	{
+		mSentinel->Left->Left = mSentinel;
+		mSentinel->Right->Right = mSentinel;
 	}
-	if (!y->IsRed)
-		restoreAfterDelete(x);
-	if (x == mSentinel)
-		x->Parent = NULL;
+	if (OPERATION_COUNTERS::IsCounting)
+		OPERATION_COUNTERS::countFree();
+	OWNERSHIP::release(node, mAllocator);
 }
 
-//RED BLACK TREE METHODS
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-RedBlackTree<KEY_TYPE, MAPPED_TYPE>::RedBlackTree() : mCount(0)
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename... ARGS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::createNode(ARGS&&... args)
 {
-	mSentinel = new RedBlackNode();
-	mSentinel->IsRed = false;
-	mRoot = mSentinel;
+	RedBlackNode* node = node_allocator_traits::allocate(mAllocator, 1);
+	if (OPERATION_COUNTERS::IsCounting)
+		OPERATION_COUNTERS::countAllocation();
+	try
+	{
+		node_allocator_traits::construct(mAllocator, node, mAllocator, std::forward<ARGS>(args)...);
+	}
+	catch (...)
+	{
+		node_allocator_traits::deallocate(mAllocator, node, 1);
+		throw;
+	}
+	return node;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::destroyNode(typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* node)
+{
+	node_guard nodeGuard(node);
+	if (OPERATION_COUNTERS::IsCounting)
+		OPERATION_COUNTERS::countFree();
+	OWNERSHIP::release(node, mAllocator);
 }
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator RedBlackTree<KEY_TYPE, MAPPED_TYPE>::insert(const key_type& key, const mapped_type& data)
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::findInsertPosition(const RedBlackNode* start, const key_type& key, RedBlackNode*& parent, bool& isLeft) const
 {
-	RedBlackNode* node = new RedBlackNode(key, data);
-	RedBlackNode* temp = mRoot;
-	while (temp != mSentinel)
+	RedBlackNode* node = const_cast<RedBlackNode*>(start);
+	RedBlackNode* notGreater = NULL;
+	size_t length = 0;
+	parent = NULL;
+	isLeft = false;
+	while (!node->isSentinel())
 	{
-		node->Parent = temp;
-		if (key == temp->Value->first)
-			return iterator(temp, false, false, mSentinel);
-		else if (key > temp->Value->first)
-			temp = temp->Right;
+		parent = node;
+		length++;
+		isLeft = compareKeys(key, node->Value.first);
+		if (isLeft)
+			node = node->Left;
 		else
-			temp = temp->Left;
+		{
+			notGreater = node;
+			node = node->Right;
+		}
 	}
-	node->Left = mSentinel;
-	node->Right = mSentinel;
-	if (node->Parent != NULL)
+	if (OPERATION_COUNTERS::IsCounting)
+		OPERATION_COUNTERS::countSearch(length);
+	//greatest key not greater than searched one lies on the search path,
+	//duplicate key is attached after it, behind the items with equal key
+	if (!KEY_UNIQUENESS::AllowsDuplicates && notGreater != NULL && !compareKeys(notGreater->Value.first, key))
+		return notGreater;
+	return sentinel();
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::coveringSubtree(const RedBlackNode* finger, const key_type& key) const
+{
+	//if finger key is not greater than searched one, climbing stops at the first left turn
+	//whose parent key is greater, keys equal to searched one can only be below;
+	//a greater finger key climbs symmetrically to the first right turn with a less parent key
+	if (finger == NULL)
+		return const_cast<RedBlackNode*>(static_cast<const RedBlackNode*>(mRoot));
+	const RedBlackNode* node = finger;
+	if (!compareKeys(key, finger->Value.first))
 	{
-		if (node->Value->first > node->Parent->Value->first)
-			node->Parent->Right = node;
-		else
-			node->Parent->Left = node;
+		while (node->Parent != NULL && !(node == node->Parent->Left && compareKeys(key, node->Parent->Value.first)))
+			node = node->Parent;
+	}
+	else
+	{
+		while (node->Parent != NULL && !(node == node->Parent->Right && compareKeys(node->Parent->Value.first, key)))
+			node = node->Parent;
+	}
+	return const_cast<RedBlackNode*>(node);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::findHintedPosition(const RedBlackNode* hint, const key_type& key, RedBlackNode*& parent, bool& isLeft) const
+{
+	//hint is the position after the key, a key between the neighbours of hint is attached
+	//without search to whichever of them has the free child; duplicate key equal to hint goes before it
+	if (hint == NULL || isEmpty())
+		return findInsertPosition(key, parent, isLeft);
+	parent = NULL;
+	isLeft = false;
+	RedBlackNode* node = const_cast<RedBlackNode*>(hint);
+	if (node->isSentinel())
+	{
+		node = mSentinel->Right;
+		if (isOrdered(node->Value.first, key))
+		{
+			parent = node;
+			return sentinel();
+		}
+	}
+	else if (isOrdered(key, node->Value.first))
+	{
+		RedBlackNode* before = node->previous();
+		if (before == mSentinel || isOrdered(before->Value.first, key))
+		{
+			isLeft = node->Left->isSentinel();
+			parent = isLeft ? node : before;
+			return sentinel();
+		}
+	}
+	else if (compareKeys(node->Value.first, key))
+	{
+		RedBlackNode* after = node->next();
+		if (after == mSentinel || isOrdered(key, after->Value.first))
+		{
+			isLeft = !node->Right->isSentinel();
+			parent = isLeft ? after : node;
+			return sentinel();
+		}
 	}
 	else
+		return node;
+	return findInsertPosition(coveringSubtree(node, key), key, parent, isLeft);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::findNearNode(const RedBlackNode* hint, const key_type& key) const
+{
+	if (hint == NULL || isEmpty())
+		return findNode(key);
+	if (hint->isSentinel())
+		hint = mSentinel->Right;
+	RedBlackNode* notLess = lowerBoundNode(coveringSubtree(hint, key), key);
+	if (notLess != mSentinel && compareKeys(key, notLess->Value.first))
+		return sentinel();
+	return notLess;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::attachNode(typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* node, typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* parent, bool isLeft)
+{
+	node->Parent = parent;
+	node->Left = leaf();
+	node->Right = leaf();
+	ORDER_STATISTICS::update(node);
+	for (RedBlackNode* ancestor = parent; ancestor != NULL; ancestor = ancestor->Parent)
+		ORDER_STATISTICS::increment(ancestor);
+	if (parent == NULL)
+	{
 		mRoot = node;
+		node->Left = mSentinel;
+		node->Right = mSentinel;
+		mSentinel->Left = node;
+		mSentinel->Right = node;
+	}
+	else if (isLeft)
+	{
+		//node takes over the leaf of its parent, which is the sentinel below the leftmost node
+		node->Left = parent->Left;
+		parent->Left = node;
+		if (parent == mSentinel->Left)
+			mSentinel->Left = node;
+	}
+	else
+	{
+		node->Right = parent->Right;
+		parent->Right = node;
+		if (parent == mSentinel->Right)
+			mSentinel->Right = node;
+	}
 	restoreAfterInsert(node);
-	iterator it = iterator(node, false, false, mSentinel);
 	mCount++;
-	return it;
 }
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-size_t RedBlackTree<KEY_TYPE, MAPPED_TYPE>::remove(const key_type& key)
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::copySubtree(
+	const RedBlackNode* node, RedBlackNode* parent)
 {
-	RedBlackNode* node = mRoot;
-	while (node != mSentinel)
+	RedBlackNode* copy = createNode(node->Value.first, node->Value.second);
+	copy->IsRed = node->IsRed;
+	copy->Parent = parent;
+	copy->Left = leaf();
+	copy->Right = leaf();
+	try
 	{
-		if (key == node->Value->first)
-			break;
-		if (key < node->Value->first)
-			node = node->Left;
-		else
-			node = node->Right;
+		if (!node->Left->isSentinel())
+			copy->Left = copySubtree(node->Left, copy);
+		if (!node->Right->isSentinel())
+			copy->Right = copySubtree(node->Right, copy);
 	}
-	if (node == mSentinel)
-		return 0;
-	mCount--;
-	remove(node);
-	return 1;
+	catch (...)
+	{
+		node_guard copyGuard(copy);
+		destroySubtree(copy);
+		throw;
+	}
+	ORDER_STATISTICS::update(copy);
+	return copy;
 }
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator RedBlackTree<KEY_TYPE, MAPPED_TYPE>::begin()
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::destroySubtree(typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* node)
 {
-	RedBlackNode* node = mRoot;
-	if (node == mSentinel)
-		return iterator(mSentinel, true, true, mSentinel);
-	while (node->Left != mSentinel)
-		node = node->Left;
-	return iterator(node, false, false, mSentinel);
+	if (node->isSentinel())
+		return;
+	destroySubtree(node->Left);
+	destroySubtree(node->Right);
+	if (OPERATION_COUNTERS::IsCounting)
+		OPERATION_COUNTERS::countFree();
+	OWNERSHIP::release(node, mAllocator);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::createSentinel()
+{
+	RedBlackNode* sentinel = createNode();
+	sentinel->Left = sentinel;
+	sentinel->Right = sentinel;
+	return sentinel;
 }
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator RedBlackTree<KEY_TYPE, MAPPED_TYPE>::end()
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::leaf() const
+{
+	//built in static storage and never destroyed, so it outlives every node
+	static RedBlackNode* const node = new (leafAddress()) RedBlackNode(mAllocator);
+	return node;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::leafAddress()
+{
+	static typename std::aligned_storage<sizeof(RedBlackNode), alignof(RedBlackNode)>::type storage;
+	return reinterpret_cast<RedBlackNode*>(&storage);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::destroySentinel()
+{
+	mSentinel->Left = NULL;
+	mSentinel->Right = NULL;
+	if (OPERATION_COUNTERS::IsCounting)
+		OPERATION_COUNTERS::countFree();
+	OWNERSHIP::release(sentinel(), mAllocator);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::updateBounds()
 {
 	RedBlackNode* node = mRoot;
-	if (node == mSentinel)
-		return iterator(mSentinel, true, true, mSentinel);
-	while (node->Right != mSentinel)
+	if (node->isSentinel())
+	{
+		mRoot = mSentinel;
+		mSentinel->Left = mSentinel;
+		mSentinel->Right = mSentinel;
+		return;
+	}
+	while (!node->Left->isSentinel())
+		node = node->Left;
+	node->Left = mSentinel;
+	mSentinel->Left = node;
+	node = mRoot;
+	while (!node->Right->isSentinel())
 		node = node->Right;
-	return iterator(node, true, false, mSentinel);
+	node->Right = mSentinel;
+	mSentinel->Right = node;
 }
 
-template<typename KEY_TYPE, typename MAPPED_TYPE>
-typename RedBlackTree<KEY_TYPE, MAPPED_TYPE>::iterator RedBlackTree<KEY_TYPE, MAPPED_TYPE>::find(const key_type& key)
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::detachBounds()
 {
-	if (mRoot == mSentinel)
-		return iterator(mRoot, true, true, mSentinel);
-	RedBlackNode* node = mRoot;
-	while (node != mSentinel)
+	if (isEmpty())
+		return;
+	mSentinel->Left->Left = leaf();
+	mSentinel->Right->Right = leaf();
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename ITERATOR>
+bool RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::isSorted(ITERATOR first, ITERATOR last, size_t& count) const
+{
+	count = 0;
+	if (first == last)
+		return true;
+	ITERATOR previous = first;
+	count = 1;
+	for (++first; first != last; ++first, ++previous, ++count)
 	{
-		if (key == node->Value->first)
-			return iterator(node, false, false, mSentinel);
-		if (key < node->Value->first)
-			node = node->Left;
-		else
-			node = node->Right;
+		if (!isOrdered(previous->first, first->first))
+			return false;
+	}
+	return true;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename ITERATOR>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::buildFromSorted(ITERATOR first, size_t count)
+{
+	//all levels but the deepest one are full, nodes on the deepest level are red
+	size_t redDepth = 0;
+	while ((size_t(2) << redDepth) <= count + 1)
+		redDepth++;
+	mRoot = buildSubtree(first, count, 0, redDepth);
+	if (!mRoot->isSentinel())
+		mRoot->Parent = NULL;
+	mCount = count;
+	updateBounds();
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename ITERATOR>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::buildSubtree(ITERATOR& it, size_t count, size_t depth, size_t redDepth)
+{
+	if (count == 0)
+		return leaf();
+	size_t leftCount = (count - 1) / 2;
+	RedBlackNode* left = buildSubtree(it, leftCount, depth + 1, redDepth);
+	RedBlackNode* node;
+	try
+	{
+		node = createNode(it->first, it->second);
+	}
+	catch (...)
+	{
+		node_guard leftGuard(left);
+		destroySubtree(left);
+		throw;
+	}
+	++it;
+	node->IsRed = depth == redDepth;
+	node->Left = left;
+	node->Right = leaf();
+	if (!left->isSentinel())
+		left->Parent = node;
+	try
+	{
+		node->Right = buildSubtree(it, count - 1 - leftCount, depth + 1, redDepth);
+	}
+	catch (...)
+	{
+		node_guard nodeGuard(node);
+		destroySubtree(node);
+		throw;
+	}
+	if (!node->Right->isSentinel())
+		node->Right->Parent = node;
+	ORDER_STATISTICS::update(node);
+	return node;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+int RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::checkSubtree(const RedBlackNode* node, const RedBlackNode* parent) const
+{
+	if (node->isSentinel())
+		return 1;
+	if (node->Parent != parent)
+		return -1;
+	if (node->IsRed && (node->Left->IsRed || node->Right->IsRed))
+		return -1;
+	if (!ORDER_STATISTICS::isConsistent(node))
+		return -1;
+	if (!node->Left->isSentinel() && (KEY_UNIQUENESS::AllowsDuplicates ? mCompare(node->Value.first, node->Left->Value.first) : !mCompare(node->Left->Value.first, node->Value.first)))
+		return -1;
+	if (!node->Right->isSentinel() && (KEY_UNIQUENESS::AllowsDuplicates ? mCompare(node->Right->Value.first, node->Value.first) : !mCompare(node->Value.first, node->Right->Value.first)))
+		return -1;
+	int leftHeight = checkSubtree(node->Left, node);
+	int rightHeight = checkSubtree(node->Right, node);
+	if (leftHeight < 0 || leftHeight != rightHeight)
+		return -1;
+	return leftHeight + (node->IsRed ? 0 : 1);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+int RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::blackHeight(const RedBlackNode* root) const
+{
+	int height = 0;
+	for (const RedBlackNode* node = root; !node->isSentinel(); node = node->Left)
+	{
+		if (!node->IsRed)
+			height++;
+	}
+	return height;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::exposeTree(RedBlackNode* root, int height,
+	node_link& left, int& leftHeight, node_link& right, int& rightHeight)
+{
+	//red child becomes black root of its own subtree
+	left = root->Left;
+	right = root->Right;
+	leftHeight = rightHeight = height - 1;
+	if (!left->isSentinel())
+	{
+		left->Parent = NULL;
+		if (left->IsRed)
+		{
+			left->IsRed = false;
+			leftHeight++;
+		}
+	}
+	if (!right->isSentinel())
+	{
+		right->Parent = NULL;
+		if (right->IsRed)
+		{
+			right->IsRed = false;
+			rightHeight++;
+		}
+	}
+	root->Left = leaf();
+	root->Right = leaf();
+	ORDER_STATISTICS::update(root);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::node_link RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::joinTrees(node_link left, int leftHeight,
+	RedBlackNode* middle, node_link right, int rightHeight, int& height)
+{
+	middle->Parent = NULL;
+	if (leftHeight == rightHeight)
+	{
+		middle->Left = left;
+		middle->Right = right;
+		middle->IsRed = false;
+		if (!left->isSentinel())
+			left->Parent = middle;
+		if (!right->isSentinel())
+			right->Parent = middle;
+		ORDER_STATISTICS::update(middle);
+		height = leftHeight + 1;
+		return middle;
+	}
+	//middle becomes red parent of the spine node of the taller tree with the black height
+	//of the shorter one and the shorter tree, then it is restored as an inserted node
+	bool isLeftTaller = leftHeight > rightHeight;
+	node_link root = isLeftTaller ? left : right;
+	int targetHeight = isLeftTaller ? rightHeight : leftHeight;
+	int nodeHeight = isLeftTaller ? leftHeight : rightHeight;
+	RedBlackNode* parent = NULL;
+	RedBlackNode* node = root;
+	while (node->IsRed || nodeHeight != targetHeight)
+	{
+		if (!node->IsRed)
+			nodeHeight--;
+		parent = node;
+		node = isLeftTaller ? node->Right : node->Left;
+	}
+	middle->IsRed = true;
+	middle->Parent = parent;
+	if (isLeftTaller)
+	{
+		middle->Left = node;
+		middle->Right = right;
+		parent->Right = middle;
+	}
+	else
+	{
+		middle->Left = left;
+		middle->Right = node;
+		parent->Left = middle;
+	}
+	if (!middle->Left->isSentinel())
+		middle->Left->Parent = middle;
+	if (!middle->Right->isSentinel())
+		middle->Right->Parent = middle;
+	ORDER_STATISTICS::update(middle);
+	for (RedBlackNode* ancestor = parent; ancestor != NULL; ancestor = ancestor->Parent)
+		ORDER_STATISTICS::update(ancestor);
+	height = (isLeftTaller ? leftHeight : rightHeight) + (restoreAfterInsert(middle, root) ? 1 : 0);
+	return root;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::node_link RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::concatTrees(node_link left, int leftHeight,
+	node_link right, int rightHeight, int& height)
+{
+	if (right->isSentinel())
+	{
+		height = leftHeight;
+		return left;
+	}
+	if (left->isSentinel())
+	{
+		height = rightHeight;
+		return right;
+	}
+	node_link rest;
+	int restHeight;
+	node_link last = splitLast(left, leftHeight, rest, restHeight);
+	return joinTrees(rest, restHeight, last, right, rightHeight, height);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::splitTree(node_link root, int height, const key_type& key,
+	node_link& left, int& leftHeight, node_link& found, node_link& right, int& rightHeight)
+{
+	found = NULL;
+	if (root->isSentinel())
+	{
+		left = leaf();
+		right = leaf();
+		leftHeight = rightHeight = 0;
+		return;
 	}
-	return end();
+	node_link rootLeft, rootRight;
+	int rootLeftHeight, rootRightHeight;
+	exposeTree(root, height, rootLeft, rootLeftHeight, rootRight, rootRightHeight);
+	//duplicates of the key may lie in both subtrees, so an equal root goes right and nothing is found
+	if (isOrdered(key, root->Value.first))
+	{
+		node_link between;
+		int betweenHeight;
+		splitTree(rootLeft, rootLeftHeight, key, left, leftHeight, found, between, betweenHeight);
+		right = joinTrees(between, betweenHeight, root, rootRight, rootRightHeight, rightHeight);
+	}
+	else if (compareKeys(root->Value.first, key))
+	{
+		node_link between;
+		int betweenHeight;
+		splitTree(rootRight, rootRightHeight, key, between, betweenHeight, found, right, rightHeight);
+		left = joinTrees(rootLeft, rootLeftHeight, root, between, betweenHeight, leftHeight);
+	}
+	else
+	{
+		left = rootLeft;
+		leftHeight = rootLeftHeight;
+		right = rootRight;
+		rightHeight = rootRightHeight;
+		found = root;
+	}
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::node_link RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::splitLast(node_link root, int height, node_link& rest, int& restHeight)
+{
+	node_link rootLeft, rootRight;
+	int rootLeftHeight, rootRightHeight;
+	exposeTree(root, height, rootLeft, rootLeftHeight, rootRight, rootRightHeight);
+	if (rootRight->isSentinel())
+	{
+		rest = rootLeft;
+		restHeight = rootLeftHeight;
+		return root;
+	}
+	node_link rightRest;
+	int rightRestHeight;
+	node_link last = splitLast(rootRight, rootRightHeight, rightRest, rightRestHeight);
+	rest = joinTrees(rootLeft, rootLeftHeight, root, rightRest, rightRestHeight, restHeight);
+	return last;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::node_link RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::adoptNodes(RedBlackTree& other)
+{
+	other.detachBounds();
+	node_link root = other.isEmpty() ? leaf() : static_cast<RedBlackNode*>(other.mRoot);
+	other.mRoot = other.mSentinel;
+	other.mCount = 0;
+	other.updateBounds();
+	return root;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::checkExchange(const RedBlackTree& other) const
+{
+	if (&other == this || !(mAllocator == other.mAllocator))
+		throw std::invalid_argument("Trees cannot exchange nodes.");
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::applySetOperation(const RedBlackTree& other, ThreadPool& pool, set_operation_type operation)
+{
+	static_assert(!KEY_UNIQUENESS::AllowsDuplicates, "set operations need UniqueKeys policy");
+	//only nodes of this tree are split, so a tree combined with itself is read from a copy
+	if (&other == this)
+	{
+		RedBlackTree copy(other);
+		applySetOperation(copy, pool, operation);
+		return;
+	}
+	detachBounds();
+	node_link first = mRoot;
+	mRoot = mSentinel;
+	SetOperation setOperation(pool);
+	int height;
+	first = (this->*operation)(first, blackHeight(first), other.mRoot, blackHeight(other.mRoot), height, setOperation, 0);
+	size_t count = mCount + setOperation.Added.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < setOperation.Discarded.size(); i++)
+	{
+		RedBlackNode* node = setOperation.Discarded[i];
+		count -= countSubtree(node);
+		destroySubtree(node);
+	}
+	mRoot = first;
+	mCount = count;
+	updateBounds();
+	if (setOperation.Failure)
+		std::rethrow_exception(setOperation.Failure);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::copyForOperation(const RedBlackNode* node, bool isSubtree, SetOperation& operation)
+{
+	if (operation.IsFailed.load(std::memory_order_relaxed))
+		return NULL;
+	std::unique_lock<std::mutex> lock(operation.Mutex, std::defer_lock);
+	if (SetOperation::IsAllocationLocked)
+		lock.lock();
+	try
+	{
+		RedBlackNode* copy;
+		if (isSubtree)
+		{
+			copy = copySubtree(node, NULL);
+			operation.Added.fetch_add(countSubtree(copy), std::memory_order_relaxed);
+		}
+		else
+		{
+			copy = createNode(node->Value.first, node->Value.second);
+			operation.Added.fetch_add(1, std::memory_order_relaxed);
+		}
+		copy->IsRed = false;
+		return copy;
+	}
+	catch (...)
+	{
+		if (!lock.owns_lock())
+			lock.lock();
+		if (!operation.Failure)
+			operation.Failure = std::current_exception();
+		operation.IsFailed.store(true, std::memory_order_relaxed);
+		return NULL;
+	}
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::node_link RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::unionTrees(node_link first, int firstHeight,
+	const RedBlackNode* second, int secondHeight, int& height, SetOperation& operation, int depth)
+{
+	if (second->isSentinel())
+	{
+		height = firstHeight;
+		return first;
+	}
+	if (first->isSentinel())
+	{
+		//nothing of this tree lies within second, so it is copied whole
+		RedBlackNode* copy = copyForOperation(second, true, operation);
+		height = copy != NULL ? secondHeight : 0;
+		return copy != NULL ? copy : leaf();
+	}
+	node_link firstLeft, found, firstRight;
+	int firstLeftHeight, firstRightHeight;
+	splitTree(first, firstHeight, second->Value.first, firstLeft, firstLeftHeight, found, firstRight, firstRightHeight);
+	//a red child of second is taken as the black root of its subtree, as exposeTree does
+	int secondLeftHeight = second->Left->IsRed ? secondHeight : secondHeight - 1;
+	int secondRightHeight = second->Right->IsRed ? secondHeight : secondHeight - 1;
+	node_link left, right;
+	int leftHeight, rightHeight;
+	operation.fork(depth,
+		[&]() { left = unionTrees(firstLeft, firstLeftHeight, second->Left, secondLeftHeight, leftHeight, operation, depth + 1); },
+		[&]() { right = unionTrees(firstRight, firstRightHeight, second->Right, secondRightHeight, rightHeight, operation, depth + 1); });
+	RedBlackNode* middle = found ? static_cast<RedBlackNode*>(found) : copyForOperation(second, false, operation);
+	if (middle == NULL)
+		return concatTrees(left, leftHeight, right, rightHeight, height);
+	return joinTrees(left, leftHeight, middle, right, rightHeight, height);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::node_link RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::intersectTrees(node_link first, int firstHeight,
+	const RedBlackNode* second, int secondHeight, int& height, SetOperation& operation, int depth)
+{
+	if (first->isSentinel() || second->isSentinel())
+	{
+		if (!first->isSentinel())
+			operation.discard(first);
+		height = 0;
+		return leaf();
+	}
+	node_link firstLeft, found, firstRight;
+	int firstLeftHeight, firstRightHeight;
+	splitTree(first, firstHeight, second->Value.first, firstLeft, firstLeftHeight, found, firstRight, firstRightHeight);
+	int secondLeftHeight = second->Left->IsRed ? secondHeight : secondHeight - 1;
+	int secondRightHeight = second->Right->IsRed ? secondHeight : secondHeight - 1;
+	node_link left, right;
+	int leftHeight, rightHeight;
+	operation.fork(depth,
+		[&]() { left = intersectTrees(firstLeft, firstLeftHeight, second->Left, secondLeftHeight, leftHeight, operation, depth + 1); },
+		[&]() { right = intersectTrees(firstRight, firstRightHeight, second->Right, secondRightHeight, rightHeight, operation, depth + 1); });
+	if (found)
+		return joinTrees(left, leftHeight, found, right, rightHeight, height);
+	return concatTrees(left, leftHeight, right, rightHeight, height);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::node_link RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::differenceTrees(node_link first, int firstHeight,
+	const RedBlackNode* second, int secondHeight, int& height, SetOperation& operation, int depth)
+{
+	if (first->isSentinel() || second->isSentinel())
+	{
+		height = firstHeight;
+		return first;
+	}
+	node_link firstLeft, found, firstRight;
+	int firstLeftHeight, firstRightHeight;
+	splitTree(first, firstHeight, second->Value.first, firstLeft, firstLeftHeight, found, firstRight, firstRightHeight);
+	if (found)
+		operation.discard(found);
+	int secondLeftHeight = second->Left->IsRed ? secondHeight : secondHeight - 1;
+	int secondRightHeight = second->Right->IsRed ? secondHeight : secondHeight - 1;
+	node_link left, right;
+	int leftHeight, rightHeight;
+	operation.fork(depth,
+		[&]() { left = differenceTrees(firstLeft, firstLeftHeight, second->Left, secondLeftHeight, leftHeight, operation, depth + 1); },
+		[&]() { right = differenceTrees(firstRight, firstRightHeight, second->Right, secondRightHeight, rightHeight, operation, depth + 1); });
+	return concatTrees(left, leftHeight, right, rightHeight, height);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+size_t RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::countSubtree(const RedBlackNode* node) const
+{
+	if (node->isSentinel())
+		return 0;
+	return countSubtree(node->Left) + countSubtree(node->Right) + 1;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+size_t RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::subtreeHeight(const RedBlackNode* node) const
+{
+	if (node->isSentinel())
+		return 0;
+	return std::max(subtreeHeight(node->Left), subtreeHeight(node->Right)) + 1;
+}
+
+//RED BLACK TREE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackTree() : mAllocator(allocator_type()), mCompare(), mCount(0)
+{
+	mSentinel = createSentinel();
+	mRoot = mSentinel;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackTree(const key_compare& compare, const allocator_type& allocator)
+	: mAllocator(allocator), mCompare(compare), mCount(0)
+{
+	mSentinel = createSentinel();
+	mRoot = mSentinel;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackTree(const allocator_type& allocator) : mAllocator(allocator), mCompare(), mCount(0)
+{
+	mSentinel = createSentinel();
+	mRoot = mSentinel;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename ITERATOR>
+RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackTree(ITERATOR first, ITERATOR last, const key_compare& compare, const allocator_type& allocator)
+	: mAllocator(allocator), mCompare(compare), mCount(0)
+{
+	mSentinel = createSentinel();
+	mRoot = mSentinel;
+	try
+	{
+		size_t count;
+		if (isSorted(first, last, count))
+			buildFromSorted(first, count);
+		else
+			for (; first != last; ++first)
+				insert(first->first, first->second);
+	}
+	catch (...)
+	{
+		clear();
+		destroySentinel();
+		throw;
+	}
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackTree(const RedBlackTree& other)
+	: OPERATION_COUNTERS(), mAllocator(node_allocator_traits::select_on_container_copy_construction(other.mAllocator)), mCompare(other.mCompare), mCount(other.mCount)
+{
+	mSentinel = createSentinel();
+	mRoot = mSentinel;
+	try
+	{
+		if (!other.isEmpty())
+			mRoot = copySubtree(other.mRoot, NULL);
+		updateBounds();
+	}
+	catch (...)
+	{
+		destroySentinel();
+		throw;
+	}
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>& RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::operator=(const RedBlackTree& other)
+{
+	if (this != &other)
+	{
+		RedBlackTree copy(other);
+		swap(copy);
+	}
+	return *this;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::~RedBlackTree()
+{
+	clear();
+	destroySentinel();
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::swap(RedBlackTree& other)
+{
+	std::swap(mAllocator, other.mAllocator);
+	std::swap(mCompare, other.mCompare);
+	std::swap(mCount, other.mCount);
+	std::swap(mSentinel, other.mSentinel);
+	std::swap(mRoot, other.mRoot);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename... ARGS>
+std::pair<typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::iterator, bool> RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::emplace(ARGS&&... args)
+{
+	RedBlackNode* node = createNode(std::forward<ARGS>(args)...);
+	RedBlackNode* parent;
+	bool isLeft;
+	RedBlackNode* found = findInsertPosition(node->Value.first, parent, isLeft);
+	if (found != mSentinel)
+	{
+		destroyNode(node);
+		return std::make_pair(iterator(found), false);
+	}
+	attachNode(node, parent, isLeft);
+	return std::make_pair(iterator(node), true);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename K, typename... ARGS>
+std::pair<typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::iterator, bool> RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::tryEmplace(K&& key, ARGS&&... args)
+{
+	RedBlackNode* parent;
+	bool isLeft;
+	RedBlackNode* found = findInsertPosition(key, parent, isLeft);
+	if (found != mSentinel)
+		return std::make_pair(iterator(found), false);
+	RedBlackNode* node = createNode(std::piecewise_construct,
+		std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<ARGS>(args)...));
+	attachNode(node, parent, isLeft);
+	return std::make_pair(iterator(node), true);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename K, typename M>
+std::pair<typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::iterator, bool> RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::insertOrAssign(K&& key, M&& data)
+{
+	static_assert(!KEY_UNIQUENESS::AllowsDuplicates, "insert_or_assign needs UniqueKeys policy");
+	RedBlackNode* parent;
+	bool isLeft;
+	RedBlackNode* found = findInsertPosition(key, parent, isLeft);
+	if (found != mSentinel)
+	{
+		found->Value.second = std::forward<M>(data);
+		return std::make_pair(iterator(found), false);
+	}
+	RedBlackNode* node = createNode(std::forward<K>(key), std::forward<M>(data));
+	attachNode(node, parent, isLeft);
+	return std::make_pair(iterator(node), true);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename K, typename M>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::iterator RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::insertHinted(const_iterator hint, K&& key, M&& data)
+{
+	RedBlackNode* parent;
+	bool isLeft;
+	RedBlackNode* found = findHintedPosition(hint.node(), key, parent, isLeft);
+	if (found != mSentinel)
+		return iterator(found);
+	RedBlackNode* node = createNode(std::forward<K>(key), std::forward<M>(data));
+	attachNode(node, parent, isLeft);
+	return iterator(node);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename K>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::mapped_type& RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::subscript(K&& key)
+{
+	static_assert(!KEY_UNIQUENESS::AllowsDuplicates, "operator[] needs UniqueKeys policy");
+	return try_emplace(std::forward<K>(key)).first->second;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename... ARGS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::iterator RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::emplace_hint(const_iterator hint, ARGS&&... args)
+{
+	RedBlackNode* node = createNode(std::forward<ARGS>(args)...);
+	RedBlackNode* parent;
+	bool isLeft;
+	RedBlackNode* found = findHintedPosition(hint.node(), node->Value.first, parent, isLeft);
+	if (found != mSentinel)
+	{
+		destroyNode(node);
+		return iterator(found);
+	}
+	attachNode(node, parent, isLeft);
+	return iterator(node);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename K>
+size_t RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::removeKey(const K& key)
+{
+	RedBlackNode* node = findNode(key);
+	if (node == mSentinel)
+		return 0;
+	if (KEY_UNIQUENESS::AllowsDuplicates)
+		return removeDuplicates(node, key);
+	mCount--;
+	remove(node);
+	return 1;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename K>
+size_t RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::removeDuplicates(RedBlackNode* node, const K& key)
+{
+	size_t removed = 0;
+	do
+	{
+		RedBlackNode* next = node->next();
+		mCount--;
+		remove(node);
+		node = next;
+		removed++;
+	} while (node != mSentinel && !compareKeys(key, node->Value.first));
+	return removed;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::iterator RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::erase(const_iterator position)
+{
+	RedBlackNode* node = position.node();
+	if (!node || node->isSentinel())
+		throw std::out_of_range("Iterator cannot be erased.");
+	RedBlackNode* next = node->next();
+	mCount--;
+	remove(node);
+	return iterator(next);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::iterator RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::erase(const_iterator first, const_iterator last)
+{
+	if (first == begin() && last == end())
+	{
+		clear();
+		return end();
+	}
+	RedBlackNode* node = first.node();
+	RedBlackNode* stop = last.node();
+	while (node != stop)
+	{
+		RedBlackNode* next = node->next();
+		mCount--;
+		remove(node);
+		node = next;
+	}
+	return iterator(stop);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+size_t RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::rank(const key_type& key) const
+{
+	static_assert(ORDER_STATISTICS::HasSubtreeSize, "rank needs WithOrderStatistics policy");
+	const RedBlackNode* node = mRoot;
+	size_t less = 0;
+	while (!node->isSentinel())
+	{
+		if (compareKeys(node->Value.first, key))
+		{
+			less += node->Left->SubtreeSize + 1;
+			node = node->Right;
+		}
+		else
+			node = node->Left;
+	}
+	return less;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+size_t RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::countRange(const key_type& low, const key_type& high) const
+{
+	if (!compareKeys(low, high))
+		return 0;
+	return rank(high) - rank(low);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+size_t RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::count(const key_type& key) const
+{
+	size_t count = 0;
+	for (RedBlackNode* node = findNode(key); node != mSentinel && !compareKeys(key, node->Value.first); node = node->next())
+	{
+		count++;
+		if (!KEY_UNIQUENESS::AllowsDuplicates)
+			break;
+	}
+	return count;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::frozen_map_type RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::freeze() const
+{
+	static_assert(!KEY_UNIQUENESS::AllowsDuplicates, "freeze needs UniqueKeys policy");
+	return frozen_map_type(begin(), end(), mCompare, get_allocator());
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::save(const std::string& path) const
+{
+	static_assert(!KEY_UNIQUENESS::AllowsDuplicates, "save needs UniqueKeys policy");
+	frozen_map_type::saveImage(path, begin(), mCount);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+TreeStatistics RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::stats() const
+{
+	TreeStatistics statistics;
+	statistics.Count = mCount;
+	statistics.Height = subtreeHeight(mRoot);
+	statistics.BlackHeight = size_t(blackHeight(mRoot));
+	if (mCount > 0)
+		statistics.BytesPerEntry = double(sizeof(RedBlackTree) + (mCount + 1) * sizeof(RedBlackNode)) / double(mCount);
+	statistics.Operations = OPERATION_COUNTERS::counts();
+	return statistics;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename ITERATOR>
+size_t RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::insertBatch(ITERATOR first, ITERATOR last)
+{
+	std::vector<ITERATOR> items;
+	for (; first != last; ++first)
+		items.push_back(first);
+	auto isLess = [this](const ITERATOR& left, const ITERATOR& right) { return compareKeys(left->first, right->first); };
+	//stable order keeps the first of equal keys, as insert does, or the order of duplicates
+	if (!std::is_sorted(items.begin(), items.end(), isLess))
+		std::stable_sort(items.begin(), items.end(), isLess);
+	RedBlackNode* finger = NULL;
+	size_t inserted = 0;
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		RedBlackNode* parent;
+		bool isLeft;
+		RedBlackNode* found = findInsertPosition(coveringSubtree(finger, items[i]->first), items[i]->first, parent, isLeft);
+		if (found != mSentinel)
+		{
+			finger = found;
+			continue;
+		}
+		RedBlackNode* node = createNode(items[i]->first, items[i]->second);
+		attachNode(node, parent, isLeft);
+		finger = node;
+		inserted++;
+	}
+	return inserted;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename ITERATOR>
+size_t RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::removeBatch(ITERATOR first, ITERATOR last)
+{
+	std::vector<ITERATOR> keys;
+	for (; first != last; ++first)
+		keys.push_back(first);
+	auto isLess = [this](const ITERATOR& left, const ITERATOR& right) { return compareKeys(*left, *right); };
+	if (!std::is_sorted(keys.begin(), keys.end(), isLess))
+		std::sort(keys.begin(), keys.end(), isLess);
+	//predecessor of removed node stays in the tree, so it serves as the next finger
+	RedBlackNode* finger = NULL;
+	size_t removed = 0;
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		RedBlackNode* node = lowerBoundNode(coveringSubtree(finger, *keys[i]), *keys[i]);
+		if (node == mSentinel || compareKeys(*keys[i], node->Value.first))
+			continue;
+		RedBlackNode* previous = node->previous();
+		if (KEY_UNIQUENESS::AllowsDuplicates)
+			removed += removeDuplicates(node, *keys[i]);
+		else
+		{
+			mCount--;
+			remove(node);
+			removed++;
+		}
+		finger = previous != mSentinel ? previous : NULL;
+	}
+	return removed;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::join(const key_type& key, const mapped_type& data, RedBlackTree& right)
+{
+	checkExchange(right);
+	if ((!isEmpty() && !isOrdered(mSentinel->Right->Value.first, key)) || (!right.isEmpty() && !isOrdered(key, right.mSentinel->Left->Value.first)))
+		throw std::invalid_argument("Keys are not in strictly ascending order.");
+	node_link middle = createNode(key, data);
+	size_t rightCount = right.mCount;
+	detachBounds();
+	node_link rightRoot = adoptNodes(right);
+	int height;
+	mRoot = joinTrees(mRoot, blackHeight(mRoot), middle, rightRoot, blackHeight(rightRoot), height);
+	mCount += rightCount + 1;
+	updateBounds();
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::join(RedBlackTree& right)
+{
+	checkExchange(right);
+	if (!isEmpty() && !right.isEmpty() && !isOrdered(mSentinel->Right->Value.first, right.mSentinel->Left->Value.first))
+		throw std::invalid_argument("Keys are not in strictly ascending order.");
+	size_t rightCount = right.mCount;
+	detachBounds();
+	node_link rightRoot = adoptNodes(right);
+	int height;
+	mRoot = concatTrees(mRoot, blackHeight(mRoot), rightRoot, blackHeight(rightRoot), height);
+	mCount += rightCount;
+	updateBounds();
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::split(const key_type& key, RedBlackTree& right)
+{
+	checkExchange(right);
+	right.clear();
+	node_link left, found, greater;
+	int leftHeight, greaterHeight;
+	detachBounds();
+	node_link root = mRoot;
+	mRoot = mSentinel;
+	splitTree(root, blackHeight(root), key, left, leftHeight, found, greater, greaterHeight);
+	if (found)
+		greater = joinTrees(leaf(), 0, found, greater, greaterHeight, greaterHeight);
+	mRoot = left;
+	right.mRoot = greater;
+	updateBounds();
+	right.updateBounds();
+	size_t moved;
+	if (ORDER_STATISTICS::HasSubtreeSize)
+		moved = ORDER_STATISTICS::size(static_cast<RedBlackNode*>(greater));
+	else
+	{
+		//both sides are walked together, so only the smaller one is counted
+		RedBlackNode* kept = mSentinel->Left;
+		RedBlackNode* moving = right.mSentinel->Left;
+		size_t steps = 0;
+		for (; kept != mSentinel && moving != right.mSentinel; steps++)
+		{
+			kept = kept->next();
+			moving = moving->next();
+		}
+		moved = moving == right.mSentinel ? steps : mCount - steps;
+	}
+	right.mCount = moved;
+	mCount -= moved;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::clear()
+{
+	if (!OWNERSHIP::IsRefCounted)
+		destroySubtree(mRoot);
+	mRoot = mSentinel;
+	mSentinel->Left = mSentinel;
+	mSentinel->Right = mSentinel;
+	mCount = 0;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename ITERATOR>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::assignSorted(ITERATOR first, ITERATOR last)
+{
+	size_t count;
+	if (!isSorted(first, last, count))
+		throw std::invalid_argument("Keys are not in strictly ascending order.");
+	clear();
+	buildFromSorted(first, count);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+bool RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::isValid() const
+{
+	if (mRoot->IsRed || mSentinel->IsRed || !mSentinel->isSentinel())
+		return false;
+	if (!isEmpty() && mRoot->Parent != NULL)
+		return false;
+	if (checkSubtree(mRoot, NULL) < 0)
+		return false;
+	if (!isEmpty() && (mSentinel->Left->Left != mSentinel || mSentinel->Right->Right != mSentinel))
+		return false;
+	size_t count = 0;
+	for (const_iterator it = begin(); it != end(); ++it)
+		count++;
+	return count == mCount;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename K>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::findNode(const K& key) const
+{
+	RedBlackNode* notLess = lowerBoundNode(key);
+	if (notLess != mSentinel && compareKeys(key, notLess->Value.first))
+		return sentinel();
+	return notLess;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename ITERATOR, typename KEY_ITERATOR, typename OUTPUT_ITERATOR>
+OUTPUT_ITERATOR RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::findMany(KEY_ITERATOR first, KEY_ITERATOR last, OUTPUT_ITERATOR out) const
+{
+	KEY_ITERATOR keys[FindGroupSize];
+	RedBlackNode* nodes[FindGroupSize];
+	RedBlackNode* notLess[FindGroupSize];
+	size_t lengths[FindGroupSize];
+	while (first != last)
+	{
+		size_t count = 0;
+		for (; count < FindGroupSize && first != last; ++first, count++)
+		{
+			keys[count] = first;
+			nodes[count] = const_cast<RedBlackNode*>(static_cast<const RedBlackNode*>(mRoot));
+			notLess[count] = sentinel();
+			lengths[count] = 0;
+		}
+		//each round takes every unfinished search one level down, so the loads of a round do not depend on each other
+		for (bool isActive = true; isActive;)
+		{
+			isActive = false;
+			for (size_t i = 0; i < count; i++)
+			{
+				RedBlackNode* node = nodes[i];
+				if (node->isSentinel())
+					continue;
+				lengths[i]++;
+				if (compareKeys(node->Value.first, *keys[i]))
+					node = node->Right;
+				else
+				{
+					notLess[i] = node;
+					node = node->Left;
+				}
+				prefetchRead(reinterpret_cast<std::uintptr_t>(node));
+				prefetchRead(reinterpret_cast<std::uintptr_t>(&node->Value));
+				nodes[i] = node;
+				isActive = isActive || !node->isSentinel();
+			}
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			if (OPERATION_COUNTERS::IsCounting)
+				OPERATION_COUNTERS::countSearch(lengths[i]);
+			RedBlackNode* found = notLess[i];
+			if (found != mSentinel && compareKeys(*keys[i], found->Value.first))
+				found = sentinel();
+			*out = ITERATOR(found);
+			++out;
+		}
+	}
+	return out;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename K>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::lowerBoundNode(const RedBlackNode* start, const K& key) const
+{
+	RedBlackNode* node = const_cast<RedBlackNode*>(start);
+	RedBlackNode* notLess = sentinel();
+	size_t length = 0;
+	while (!node->isSentinel())
+	{
+		length++;
+		if (compareKeys(node->Value.first, key))
+			node = node->Right;
+		else
+		{
+			notLess = node;
+			node = node->Left;
+		}
+	}
+	if (OPERATION_COUNTERS::IsCounting)
+		OPERATION_COUNTERS::countSearch(length);
+	return notLess;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename K>
+typename RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::RedBlackNode* RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::upperBoundNode(const K& key) const
+{
+	RedBlackNode* node = const_cast<RedBlackNode*>(static_cast<const RedBlackNode*>(mRoot));
+	RedBlackNode* greater = sentinel();
+	size_t length = 0;
+	while (!node->isSentinel())
+	{
+		length++;
+		if (compareKeys(key, node->Value.first))
+		{
+			greater = node;
+			node = node->Left;
+		}
+		else
+			node = node->Right;
+	}
+	if (OPERATION_COUNTERS::IsCounting)
+		OPERATION_COUNTERS::countSearch(length);
+	return greater;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename ITERATOR, typename K>
+std::pair<ITERATOR, ITERATOR> RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::equalRange(const K& key) const
+{
+	RedBlackNode* first = lowerBoundNode(key);
+	RedBlackNode* last = first;
+	if (KEY_UNIQUENESS::AllowsDuplicates)
+		last = upperBoundNode(key);
+	else if (first != mSentinel && !compareKeys(key, first->Value.first))
+		last = first->next();
+	return std::make_pair(ITERATOR(first), ITERATOR(last));
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename VALUE, typename FUNCTION>
+bool RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::visitRange(const key_type& low, const key_type& high, FUNCTION& function) const
+{
+	for (RedBlackNode* node = lowerBoundNode(low); node != mSentinel && compareKeys(node->Value.first, high); node = node->next())
+	{
+		VALUE& value = node->Value;
+		if (!function(value))
+			return false;
+	}
+	return true;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename T, typename MAP, typename COMBINE>
+T RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::parallel_reduce(T init, MAP map, COMBINE combine, ThreadPool& pool) const
+{
+	ParallelRecursion recursion(pool, mCount);
+	return reduceSubtree(mRoot, init, map, combine, recursion, 0);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename VALUE, typename FUNCTION>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::visitParallel(FUNCTION& function, ThreadPool& pool) const
+{
+	ParallelRecursion recursion(pool, mCount);
+	visitSubtree<VALUE>(mRoot, NULL, NULL, function, recursion, 0);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename VALUE, typename FUNCTION>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::visitRangeParallel(const key_type& low, const key_type& high, FUNCTION& function, ThreadPool& pool) const
+{
+	ParallelRecursion recursion(pool, mCount);
+	visitSubtree<VALUE>(mRoot, &low, &high, function, recursion, 0);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename VALUE, typename FUNCTION>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::visitSubtree(RedBlackNode* node, const key_type* low, const key_type* high, FUNCTION& function, ParallelRecursion& recursion, int depth) const
+{
+	//subtrees out of the range are skipped, below a node within it one bound is known to hold
+	while (!node->isSentinel())
+	{
+		if (low != NULL && compareKeys(node->Value.first, *low))
+			node = node->Right;
+		else if (high != NULL && !compareKeys(node->Value.first, *high))
+			node = node->Left;
+		else
+			break;
+	}
+	if (node->isSentinel())
+		return;
+	recursion.fork(depth,
+		[&]() { visitSubtree<VALUE>(node->Left, low, NULL, function, recursion, depth + 1); },
+		[&]()
+		{
+			VALUE& value = node->Value;
+			function(value);
+			visitSubtree<VALUE>(node->Right, NULL, high, function, recursion, depth + 1);
+		});
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename T, typename MAP, typename COMBINE>
+T RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::reduceSubtree(const RedBlackNode* node, const T& init, MAP& map, COMBINE& combine, ParallelRecursion& recursion, int depth) const
+{
+	if (depth >= recursion.ForkDepth)
+	{
+		T result(init);
+		accumulateSubtree(node, result, map, combine);
+		return result;
+	}
+	if (node->isSentinel())
+		return init;
+	T left(init);
+	T right(init);
+	recursion.fork(depth,
+		[&]() { left = reduceSubtree(node->Left, init, map, combine, recursion, depth + 1); },
+		[&]() { right = reduceSubtree(node->Right, init, map, combine, recursion, depth + 1); });
+	return combine(combine(std::move(left), map(node->Value)), std::move(right));
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR, typename OWNERSHIP, typename ORDER_STATISTICS, typename OPERATION_COUNTERS, typename KEY_UNIQUENESS>
+template<typename T, typename MAP, typename COMBINE>
+void RedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR, OWNERSHIP, ORDER_STATISTICS, OPERATION_COUNTERS, KEY_UNIQUENESS>::accumulateSubtree(const RedBlackNode* node, T& result, MAP& map, COMBINE& combine) const
+{
+	if (node->isSentinel())
+		return;
+	accumulateSubtree(node->Left, result, map, combine);
+	result = combine(std::move(result), map(node->Value));
+	accumulateSubtree(node->Right, result, map, combine);
 }
 #endif // !RED_BLACK_TREE_H
@@ -0,0 +1,738 @@
+#pragma once
+#ifndef SEQ_LOCK_RED_BLACK_TREE_H
+#define SEQ_LOCK_RED_BLACK_TREE_H
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//STRUCTURES
+/// Red-black tree for one writer and many readers. Readers run find without locks: they read
+/// the tree optimistically and retry when the sequence counter shows that a write overlapped.
+/// Writers are serialized by a mutex readers never touch, every structural change is done between
+/// two increments of the sequence counter. Child links are atomic and a published node is never
+/// changed but by its links, a value is replaced by a new node. Unlinked nodes are retired and freed
+/// only when every reader announced an epoch later than the one they were retired in.
+template<typename KEY_TYPE, typename MAPPED_TYPE,
+	typename COMPARE = std::less<KEY_TYPE>,
+	typename ALLOCATOR = std::allocator<std::pair<const KEY_TYPE, MAPPED_TYPE> > >
+class SeqLockRedBlackTree
+{
+	struct SeqLockNode;
+public:
+	typedef KEY_TYPE key_type;
+	typedef MAPPED_TYPE mapped_type;
+	typedef std::pair<const key_type, mapped_type> value_type;
+	typedef COMPARE key_compare;
+	typedef ALLOCATOR allocator_type;
+	typedef typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<SeqLockNode> node_allocator_type;
+	/// readers running at once, more readers wait for a free slot
+	static const size_t ReaderSlotsCount = 64;
+	/// retired nodes collected before the writer tries to free them
+	static const size_t ReclaimThreshold = 64;
+	explicit SeqLockRedBlackTree(const key_compare& compare = key_compare(), const allocator_type& allocator = allocator_type());
+	/// no reader may run during destruction
+	~SeqLockRedBlackTree();
+	size_t size() const { return mCount.load(std::memory_order_relaxed); }
+	bool isEmpty() const { return size() == 0; }
+	allocator_type get_allocator() const { return allocator_type(mAllocator); }
+	key_compare key_comp() const { return mCompare; }
+	/// insert item if key is not present, return true if it was inserted
+	bool insert(const key_type& key, const mapped_type& data);
+	/// insert item or replace node of present key by a node with new value, return true if it was inserted
+	bool insert_or_assign(const key_type& key, const mapped_type& data);
+	size_t remove(const key_type& key);
+	void clear();
+	/// copy value of key to data, return false if key is not present; lock free
+	bool find(const key_type& key, mapped_type& data) const;
+	bool contains(const key_type& key) const;
+	/// true if ordering, colors, black height and parent links hold, writers must not run
+	bool isValid() const;
+	/// count of removed nodes not freed yet, writers must not run
+	size_t retiredCount() const { return mRetired.size(); }
+private:
+	typedef std::allocator_traits<node_allocator_type> node_allocator_traits;
+	static const size_t CacheLineSize = 64;
+	/// longer search meets a cycle of a concurrent rotation and is retried
+	static const size_t MaxSearchLength = 2 * 8 * sizeof(size_t);
+	/// announced epoch of a running reader, 0 in a free slot; one slot per cache line
+	struct alignas(CacheLineSize) ReaderSlot
+	{
+		std::atomic<size_t> Epoch;
+	};
+	class ReadGuard;
+	node_allocator_type mAllocator;
+	key_compare mCompare;
+	SeqLockNode* mNil;
+	std::atomic<SeqLockNode*> mRoot;
+	std::atomic<size_t> mCount;
+	/// odd while a write is in progress
+	std::atomic<size_t> mSequence;
+	std::atomic<size_t> mEpoch;
+	std::mutex mWriterMutex;
+	/// nodes with the epoch they were retired in
+	std::vector<std::pair<size_t, SeqLockNode*> > mRetired;
+	mutable std::array<ReaderSlot, ReaderSlotsCount> mSlots;
+
+	//writer side, the writer alone changes links, so it reads them relaxed
+	SeqLockNode* left(const SeqLockNode* node) const { return node->Left.load(std::memory_order_relaxed); }
+	SeqLockNode* right(const SeqLockNode* node) const { return node->Right.load(std::memory_order_relaxed); }
+	void setLeft(SeqLockNode* node, SeqLockNode* child) { node->Left.store(child, std::memory_order_release); }
+	void setRight(SeqLockNode* node, SeqLockNode* child) { node->Right.store(child, std::memory_order_release); }
+	SeqLockNode* root() const { return mRoot.load(std::memory_order_relaxed); }
+	void setRoot(SeqLockNode* node) { mRoot.store(node, std::memory_order_release); }
+	void beginWrite();
+	void endWrite();
+	template<typename... ARGS>
+	SeqLockNode* createNode(ARGS&&... args);
+	void destroyNode(SeqLockNode* node);
+	void retireNode(SeqLockNode* node);
+	/// free retired nodes no reader can reach any more
+	void reclaim();
+	void retireSubtree(SeqLockNode* node);
+	void destroySubtree(SeqLockNode* node);
+	SeqLockNode* minimum(SeqLockNode* node) const;
+	void rotateLeft(SeqLockNode* x);
+	void rotateRight(SeqLockNode* x);
+	void attachNode(SeqLockNode* z, SeqLockNode* parent, bool isLeft);
+	void restoreAfterInsert(SeqLockNode* z);
+	void replaceChild(SeqLockNode* parent, SeqLockNode* child, SeqLockNode* replacement);
+	void transplant(SeqLockNode* u, SeqLockNode* v);
+	void removeNode(SeqLockNode* z);
+	void restoreAfterDelete(SeqLockNode* x);
+	void replaceNode(SeqLockNode* node, SeqLockNode* replacement);
+	SeqLockNode* findInsertPosition(const key_type& key, SeqLockNode*& parent, bool& isLeft) const;
+	int checkSubtree(const SeqLockNode* node, const SeqLockNode* parent, size_t& count) const;
+
+	//reader side
+	/// announce the current epoch in a free slot
+	std::atomic<size_t>* enterReader() const;
+	/// node with given key or NULL, isComplete is false if the search was cut off
+	const SeqLockNode* searchNode(const key_type& key, bool& isComplete) const;
+	/// node with given key or NULL found by a search no write overlapped, the caller holds a slot
+	const SeqLockNode* readNode(const key_type& key) const;
+
+	SeqLockRedBlackTree(const SeqLockRedBlackTree&);
+	void operator=(const SeqLockRedBlackTree&);
+};
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+const size_t SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::ReaderSlotsCount;
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+const size_t SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::ReclaimThreshold;
+
+/// Key and value are written before the node is published and never after. Parent and color
+/// belong to the writer, readers follow Left and Right only. The leaf mNil has no value.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+struct SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::SeqLockNode
+{
+	std::atomic<SeqLockNode*> Left;
+	std::atomic<SeqLockNode*> Right;
+	SeqLockNode* Parent;
+	bool IsRed;
+	bool IsNil;
+	union { value_type Value; };
+
+	SeqLockNode() : Left(NULL), Right(NULL), Parent(NULL), IsRed(false), IsNil(true) {}
+	template<typename... ARGS>
+	SeqLockNode(ARGS&&... args) : Left(NULL), Right(NULL), Parent(NULL), IsRed(true), IsNil(false), Value(std::forward<ARGS>(args)...) {}
+	~SeqLockNode()
+	{
+		if (!IsNil)
+			Value.~value_type();
+	}
+};
+
+/// Slot of the running reader, released when the read ends.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+class SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::ReadGuard
+{
+public:
+	explicit ReadGuard(const SeqLockRedBlackTree& tree) : mSlot(tree.enterReader()) {}
+	~ReadGuard() { mSlot->store(0, std::memory_order_release); }
+private:
+	std::atomic<size_t>* mSlot;
+
+	ReadGuard(const ReadGuard&);
+	void operator=(const ReadGuard&);
+};
+
+//PRIVATE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::beginWrite()
+{
+	mSequence.store(mSequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::endWrite()
+{
+	mSequence.store(mSequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename... ARGS>
+typename SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::SeqLockNode* SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::createNode(ARGS&&... args)
+{
+	SeqLockNode* node = node_allocator_traits::allocate(mAllocator, 1);
+	try
+	{
+		node_allocator_traits::construct(mAllocator, node, std::forward<ARGS>(args)...);
+	}
+	catch (...)
+	{
+		node_allocator_traits::deallocate(mAllocator, node, 1);
+		throw;
+	}
+	return node;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::destroyNode(SeqLockNode* node)
+{
+	node_allocator_traits::destroy(mAllocator, node);
+	node_allocator_traits::deallocate(mAllocator, node, 1);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::retireNode(SeqLockNode* node)
+{
+	mRetired.push_back(std::make_pair(mEpoch.load(std::memory_order_relaxed), node));
+	if (mRetired.size() >= ReclaimThreshold)
+		reclaim();
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::reclaim()
+{
+	//readers announcing the new epoch see the tree without retired nodes, a reader whose
+	//announcement of an older epoch is not seen here fails to validate it in enterReader
+	size_t epoch = mEpoch.load(std::memory_order_relaxed) + 1;
+	mEpoch.store(epoch, std::memory_order_seq_cst);
+	size_t oldest = epoch;
+	for (size_t i = 0; i < ReaderSlotsCount; i++)
+	{
+		size_t announced = mSlots[i].Epoch.load(std::memory_order_seq_cst);
+		if (announced != 0 && announced < oldest)
+			oldest = announced;
+	}
+	size_t kept = 0;
+	for (size_t i = 0; i < mRetired.size(); i++)
+	{
+		if (mRetired[i].first < oldest)
+			destroyNode(mRetired[i].second);
+		else
+			mRetired[kept++] = mRetired[i];
+	}
+	mRetired.resize(kept);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::retireSubtree(SeqLockNode* node)
+{
+	if (node == mNil)
+		return;
+	retireSubtree(left(node));
+	retireSubtree(right(node));
+	mRetired.push_back(std::make_pair(mEpoch.load(std::memory_order_relaxed), node));
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::destroySubtree(SeqLockNode* node)
+{
+	if (node == mNil)
+		return;
+	destroySubtree(left(node));
+	destroySubtree(right(node));
+	destroyNode(node);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::SeqLockNode* SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::minimum(SeqLockNode* node) const
+{
+	while (left(node) != mNil)
+		node = left(node);
+	return node;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::rotateLeft(SeqLockNode* x)
+{
+	SeqLockNode* y = right(x);
+	setRight(x, left(y));
+	if (left(y) != mNil)
+		left(y)->Parent = x;
+	y->Parent = x->Parent;
+	replaceChild(x->Parent, x, y);
+	setLeft(y, x);
+	x->Parent = y;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::rotateRight(SeqLockNode* x)
+{
+	SeqLockNode* y = left(x);
+	setLeft(x, right(y));
+	if (right(y) != mNil)
+		right(y)->Parent = x;
+	y->Parent = x->Parent;
+	replaceChild(x->Parent, x, y);
+	setRight(y, x);
+	x->Parent = y;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::attachNode(SeqLockNode* z, SeqLockNode* parent, bool isLeft)
+{
+	//node is complete before the release store publishes it
+	z->Parent = parent;
+	z->Left.store(mNil, std::memory_order_relaxed);
+	z->Right.store(mNil, std::memory_order_relaxed);
+	if (parent == mNil)
+		setRoot(z);
+	else if (isLeft)
+		setLeft(parent, z);
+	else
+		setRight(parent, z);
+	restoreAfterInsert(z);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::restoreAfterInsert(SeqLockNode* z)
+{
+	//leaf is black, so the parent of the root stops the loop
+	while (z->Parent->IsRed)
+	{
+		SeqLockNode* p = z->Parent;
+		SeqLockNode* g = p->Parent;
+		if (p == left(g))
+		{
+			SeqLockNode* y = right(g);
+			if (y->IsRed)
+			{
+				p->IsRed = false;
+				y->IsRed = false;
+				g->IsRed = true;
+				z = g;
+			}
+			else
+			{
+				if (z == right(p))
+				{
+					z = p;
+					rotateLeft(z);
+					p = z->Parent;
+				}
+				p->IsRed = false;
+				g->IsRed = true;
+				rotateRight(g);
+			}
+		}
+		else
+		{
+			SeqLockNode* y = left(g);
+			if (y->IsRed)
+			{
+				p->IsRed = false;
+				y->IsRed = false;
+				g->IsRed = true;
+				z = g;
+			}
+			else
+			{
+				if (z == left(p))
+				{
+					z = p;
+					rotateRight(z);
+					p = z->Parent;
+				}
+				p->IsRed = false;
+				g->IsRed = true;
+				rotateLeft(g);
+			}
+		}
+	}
+	root()->IsRed = false;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::replaceChild(SeqLockNode* parent, SeqLockNode* child, SeqLockNode* replacement)
+{
+	if (parent == mNil)
+		setRoot(replacement);
+	else if (child == left(parent))
+		setLeft(parent, replacement);
+	else
+		setRight(parent, replacement);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::transplant(SeqLockNode* u, SeqLockNode* v)
+{
+	//parent of the leaf is set too, removal climbs from it
+	replaceChild(u->Parent, u, v);
+	v->Parent = u->Parent;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::removeNode(SeqLockNode* z)
+{
+	SeqLockNode* x;
+	bool isRemovedRed = z->IsRed;
+	if (left(z) == mNil)
+	{
+		x = right(z);
+		transplant(z, x);
+	}
+	else if (right(z) == mNil)
+	{
+		x = left(z);
+		transplant(z, x);
+	}
+	else
+	{
+		//successor takes the place of removed node, values never move between nodes
+		SeqLockNode* y = minimum(right(z));
+		isRemovedRed = y->IsRed;
+		x = right(y);
+		if (y->Parent == z)
+			x->Parent = y;
+		else
+		{
+			transplant(y, x);
+			setRight(y, right(z));
+			right(y)->Parent = y;
+		}
+		setLeft(y, left(z));
+		left(y)->Parent = y;
+		y->IsRed = z->IsRed;
+		transplant(z, y);
+	}
+	if (!isRemovedRed)
+		restoreAfterDelete(x);
+	mNil->Parent = NULL;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::restoreAfterDelete(SeqLockNode* x)
+{
+	while (x != root() && !x->IsRed)
+	{
+		SeqLockNode* p = x->Parent;
+		if (x == left(p))
+		{
+			SeqLockNode* w = right(p);
+			if (w->IsRed)
+			{
+				w->IsRed = false;
+				p->IsRed = true;
+				rotateLeft(p);
+				w = right(p);
+			}
+			if (!left(w)->IsRed && !right(w)->IsRed)
+			{
+				w->IsRed = true;
+				x = p;
+			}
+			else
+			{
+				if (!right(w)->IsRed)
+				{
+					left(w)->IsRed = false;
+					w->IsRed = true;
+					rotateRight(w);
+					w = right(p);
+				}
+				w->IsRed = p->IsRed;
+				p->IsRed = false;
+				right(w)->IsRed = false;
+				rotateLeft(p);
+				x = root();
+			}
+		}
+		else
+		{
+			SeqLockNode* w = left(p);
+			if (w->IsRed)
+			{
+				w->IsRed = false;
+				p->IsRed = true;
+				rotateRight(p);
+				w = left(p);
+			}
+			if (!right(w)->IsRed && !left(w)->IsRed)
+			{
+				w->IsRed = true;
+				x = p;
+			}
+			else
+			{
+				if (!left(w)->IsRed)
+				{
+					right(w)->IsRed = false;
+					w->IsRed = true;
+					rotateLeft(w);
+					w = left(p);
+				}
+				w->IsRed = p->IsRed;
+				p->IsRed = false;
+				left(w)->IsRed = false;
+				rotateRight(p);
+				x = root();
+			}
+		}
+	}
+	x->IsRed = false;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::replaceNode(SeqLockNode* node, SeqLockNode* replacement)
+{
+	//one release store swaps the nodes, readers find either of them with the same children
+	replacement->Left.store(left(node), std::memory_order_relaxed);
+	replacement->Right.store(right(node), std::memory_order_relaxed);
+	replacement->Parent = node->Parent;
+	replacement->IsRed = node->IsRed;
+	replaceChild(node->Parent, node, replacement);
+	if (left(node) != mNil)
+		left(node)->Parent = replacement;
+	if (right(node) != mNil)
+		right(node)->Parent = replacement;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::SeqLockNode* SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::findInsertPosition(const key_type& key, SeqLockNode*& parent, bool& isLeft) const
+{
+	SeqLockNode* node = root();
+	SeqLockNode* notGreater = NULL;
+	parent = mNil;
+	isLeft = false;
+	while (node != mNil)
+	{
+		parent = node;
+		isLeft = mCompare(key, node->Value.first);
+		if (isLeft)
+			node = left(node);
+		else
+		{
+			notGreater = node;
+			node = right(node);
+		}
+	}
+	if (notGreater != NULL && !mCompare(notGreater->Value.first, key))
+		return notGreater;
+	return NULL;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+int SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::checkSubtree(const SeqLockNode* node, const SeqLockNode* parent, size_t& count) const
+{
+	if (node == mNil)
+		return 1;
+	if (node->Parent != parent)
+		return -1;
+	if (node->IsRed && (left(node)->IsRed || right(node)->IsRed))
+		return -1;
+	if (left(node) != mNil && !mCompare(left(node)->Value.first, node->Value.first))
+		return -1;
+	if (right(node) != mNil && !mCompare(node->Value.first, right(node)->Value.first))
+		return -1;
+	count++;
+	int leftHeight = checkSubtree(left(node), node, count);
+	int rightHeight = checkSubtree(right(node), node, count);
+	if (leftHeight < 0 || leftHeight != rightHeight)
+		return -1;
+	return leftHeight + (node->IsRed ? 0 : 1);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+std::atomic<size_t>* SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::enterReader() const
+{
+	//threads start at different slots, so readers do not share cache lines
+	size_t index = std::hash<std::thread::id>()(std::this_thread::get_id());
+	for (;; index++)
+	{
+		std::atomic<size_t>& slot = mSlots[index % ReaderSlotsCount].Epoch;
+		size_t epoch = mEpoch.load(std::memory_order_acquire);
+		size_t free = 0;
+		if (slot.load(std::memory_order_relaxed) == 0
+			&& slot.compare_exchange_strong(free, epoch, std::memory_order_seq_cst))
+		{
+			//announcement holds once no reclaim advanced the epoch after it
+			for (size_t current = mEpoch.load(std::memory_order_seq_cst); current != epoch; current = mEpoch.load(std::memory_order_seq_cst))
+			{
+				epoch = current;
+				slot.store(epoch, std::memory_order_seq_cst);
+			}
+			return &slot;
+		}
+		if (index % ReaderSlotsCount == ReaderSlotsCount - 1)
+			std::this_thread::yield();
+	}
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+const typename SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::SeqLockNode* SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::searchNode(const key_type& key, bool& isComplete) const
+{
+	const SeqLockNode* node = mRoot.load(std::memory_order_acquire);
+	const SeqLockNode* notLess = NULL;
+	isComplete = true;
+	for (size_t length = 0; node != mNil; length++)
+	{
+		if (length == MaxSearchLength)
+		{
+			isComplete = false;
+			return NULL;
+		}
+		if (mCompare(node->Value.first, key))
+			node = node->Right.load(std::memory_order_acquire);
+		else
+		{
+			notLess = node;
+			node = node->Left.load(std::memory_order_acquire);
+		}
+	}
+	if (notLess != NULL && !mCompare(key, notLess->Value.first))
+		return notLess;
+	return NULL;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+const typename SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::SeqLockNode* SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::readNode(const key_type& key) const
+{
+	for (;;)
+	{
+		size_t sequence = mSequence.load(std::memory_order_acquire);
+		if (sequence % 2 != 0)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		bool isComplete;
+		const SeqLockNode* node = searchNode(key, isComplete);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (isComplete && mSequence.load(std::memory_order_relaxed) == sequence)
+			return node;
+	}
+}
+
+//SEQ LOCK RED BLACK TREE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::SeqLockRedBlackTree(const key_compare& compare, const allocator_type& allocator)
+	: mAllocator(allocator), mCompare(compare), mNil(NULL), mRoot(NULL), mCount(0), mSequence(0), mEpoch(1)
+{
+	for (size_t i = 0; i < ReaderSlotsCount; i++)
+		mSlots[i].Epoch.store(0, std::memory_order_relaxed);
+	mNil = createNode();
+	mRoot.store(mNil, std::memory_order_relaxed);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::~SeqLockRedBlackTree()
+{
+	destroySubtree(root());
+	for (size_t i = 0; i < mRetired.size(); i++)
+		destroyNode(mRetired[i].second);
+	destroyNode(mNil);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+bool SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::insert(const key_type& key, const mapped_type& data)
+{
+	std::lock_guard<std::mutex> lock(mWriterMutex);
+	SeqLockNode* parent;
+	bool isLeft;
+	if (findInsertPosition(key, parent, isLeft) != NULL)
+		return false;
+	SeqLockNode* node = createNode(key, data);
+	beginWrite();
+	attachNode(node, parent, isLeft);
+	endWrite();
+	mCount.store(mCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	return true;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+bool SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::insert_or_assign(const key_type& key, const mapped_type& data)
+{
+	std::lock_guard<std::mutex> lock(mWriterMutex);
+	SeqLockNode* parent;
+	bool isLeft;
+	SeqLockNode* found = findInsertPosition(key, parent, isLeft);
+	if (found != NULL)
+	{
+		replaceNode(found, createNode(found->Value.first, data));
+		retireNode(found);
+		return false;
+	}
+	SeqLockNode* node = createNode(key, data);
+	beginWrite();
+	attachNode(node, parent, isLeft);
+	endWrite();
+	mCount.store(mCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	return true;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+size_t SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::remove(const key_type& key)
+{
+	std::lock_guard<std::mutex> lock(mWriterMutex);
+	SeqLockNode* parent;
+	bool isLeft;
+	SeqLockNode* found = findInsertPosition(key, parent, isLeft);
+	if (found == NULL)
+		return 0;
+	beginWrite();
+	removeNode(found);
+	endWrite();
+	mCount.store(mCount.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+	retireNode(found);
+	return 1;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::clear()
+{
+	std::lock_guard<std::mutex> lock(mWriterMutex);
+	SeqLockNode* oldRoot = root();
+	setRoot(mNil);
+	mCount.store(0, std::memory_order_relaxed);
+	retireSubtree(oldRoot);
+	reclaim();
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+bool SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::find(const key_type& key, mapped_type& data) const
+{
+	//node is not freed while the slot is held and never changes its value,
+	//so the value is copied only once the search was validated
+	ReadGuard guard(*this);
+	const SeqLockNode* node = readNode(key);
+	if (node == NULL)
+		return false;
+	data = node->Value.second;
+	return true;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+bool SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::contains(const key_type& key) const
+{
+	ReadGuard guard(*this);
+	return readNode(key) != NULL;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+bool SeqLockRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::isValid() const
+{
+	if (root()->IsRed || mNil->IsRed)
+		return false;
+	size_t count = 0;
+	return checkSubtree(root(), mNil, count) >= 0 && count == size();
+}
+#endif // !SEQ_LOCK_RED_BLACK_TREE_H
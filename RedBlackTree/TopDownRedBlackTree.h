@@ -0,0 +1,626 @@
+#pragma once
+#ifndef TOP_DOWN_RED_BLACK_TREE_H
+#define TOP_DOWN_RED_BLACK_TREE_H
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+
+//STRUCTURES
+/// Red-black tree with the interface of RedBlackTree whose nodes have no parent pointer. Insert and remove
+/// fix colors in a single pass from the root, splitting red pairs on the way down and pushing a red node
+/// towards the removed leaf, so they never walk back up. Iterators keep the path from the root on a bounded
+/// stack instead; every insert or remove may rotate nodes of that path, so it invalidates all iterators.
+template<typename KEY_TYPE, typename MAPPED_TYPE,
+	typename COMPARE = std::less<KEY_TYPE>,
+	typename ALLOCATOR = std::allocator<std::pair<const KEY_TYPE, MAPPED_TYPE> > >
+class TopDownRedBlackTree
+{
+	struct TopDownNode;
+public:
+	typedef KEY_TYPE key_type;
+	typedef MAPPED_TYPE mapped_type;
+	typedef std::pair<const key_type, mapped_type> value_type;
+	typedef COMPARE key_compare;
+	typedef ALLOCATOR allocator_type;
+	typedef typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<TopDownNode> node_allocator_type;
+	class const_iterator;
+	class iterator;
+	/// entries of an iterator path, red-black height is at most twice the bits of the items count
+	static const size_t MaxHeight = 2 * 8 * sizeof(size_t);
+	TopDownRedBlackTree();
+	explicit TopDownRedBlackTree(const key_compare& compare, const allocator_type& allocator = allocator_type());
+	TopDownRedBlackTree(const TopDownRedBlackTree& other);
+	TopDownRedBlackTree& operator=(const TopDownRedBlackTree& other);
+	~TopDownRedBlackTree();
+	void swap(TopDownRedBlackTree& other);
+	bool isEmpty() const { return mCount == 0; }
+	size_t size() const { return mCount; }
+	allocator_type get_allocator() const { return allocator_type(mAllocator); }
+	key_compare key_comp() const { return mCompare; }
+	/// bytes of one node, the item included
+	static size_t nodeSize() { return sizeof(TopDownNode); }
+	iterator insert(const key_type& key, const mapped_type& data) { return try_emplace(key, data).first; }
+	iterator insert(key_type&& key, mapped_type&& data) { return try_emplace(std::move(key), std::move(data)).first; }
+	/// mapped value is constructed from args only if the key is not present
+	template<typename... ARGS>
+	std::pair<iterator, bool> try_emplace(const key_type& key, ARGS&&... args) { return tryEmplace(key, std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	std::pair<iterator, bool> try_emplace(key_type&& key, ARGS&&... args) { return tryEmplace(std::move(key), std::forward<ARGS>(args)...); }
+	template<typename M>
+	std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& data);
+	mapped_type& operator[](const key_type& key) { return try_emplace(key).first->second; }
+	mapped_type& operator[](key_type&& key) { return try_emplace(std::move(key)).first->second; }
+	size_t remove(const key_type& key);
+	/// remove item at position, return iterator to the next one
+	iterator erase(const_iterator position);
+	void clear();
+	/// true if ordering, colors and black height hold
+	bool isValid() const;
+	iterator begin() { iterator position(this); position.descend(mRoot, 0); return position; }
+	iterator end() { return iterator(this); }
+	const_iterator begin() const { const_iterator position(this); position.descend(mRoot, 0); return position; }
+	const_iterator end() const { return const_iterator(this); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+	iterator find(const key_type& key) { iterator position(this); findPath(key, position); return position; }
+	const_iterator find(const key_type& key) const { const_iterator position(this); findPath(key, position); return position; }
+	/// first item with key not less than given one
+	iterator lower_bound(const key_type& key) { iterator position(this); boundPath<false>(key, position); return position; }
+	const_iterator lower_bound(const key_type& key) const { const_iterator position(this); boundPath<false>(key, position); return position; }
+	/// first item with key greater than given one
+	iterator upper_bound(const key_type& key) { iterator position(this); boundPath<true>(key, position); return position; }
+	const_iterator upper_bound(const key_type& key) const { const_iterator position(this); boundPath<true>(key, position); return position; }
+private:
+	typedef std::allocator_traits<node_allocator_type> node_allocator_traits;
+	node_allocator_type mAllocator;
+	key_compare mCompare;
+	size_t mCount;
+	TopDownNode* mRoot;
+
+	static bool isRed(const TopDownNode* node) { return node != NULL && node->IsRed; }
+	/// child on the other side than direction becomes the top, it turns black and the old top red
+	static TopDownNode* rotate(TopDownNode* node, int direction);
+	/// grandchild on the other side than direction becomes the top
+	static TopDownNode* rotateTwice(TopDownNode* node, int direction);
+	template<typename... ARGS>
+	TopDownNode* createNode(ARGS&&... args);
+	void destroyNode(TopDownNode* node);
+	void destroySubtree(TopDownNode* node);
+	TopDownNode* copySubtree(const TopDownNode* node);
+	void replaceChild(TopDownNode* parent, TopDownNode* child, TopDownNode* replacement);
+	/// rotate at the grandparent of the last path node whose parent is red too, the path follows the node
+	void restoreRedParent(TopDownNode** path, size_t& depth);
+	void findPath(const key_type& key, const_iterator& position) const;
+	template<bool IS_UPPER>
+	void boundPath(const key_type& key, const_iterator& position) const;
+	/// path to a node of the tree, found by its key
+	void pathTo(const TopDownNode* target, const_iterator& position) const;
+	template<typename K, typename... ARGS>
+	std::pair<iterator, bool> tryEmplace(K&& key, ARGS&&... args);
+	int checkSubtree(const TopDownNode* node, size_t& count) const;
+};
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+const size_t TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::MaxHeight;
+
+/// Node is two child links and the color followed by the item, which is left unconstructed in a path head.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+struct TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::TopDownNode
+{
+	TopDownNode* Link[2];
+	bool IsRed;
+	union { value_type Value; };
+
+	TopDownNode() : IsRed(true) { Link[0] = Link[1] = NULL; }
+	~TopDownNode() {}
+};
+
+/// Iterator is the tree and the nodes from the root to the current one, end() is the empty path.
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+class TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator
+	: public std::iterator<std::bidirectional_iterator_tag,
+	typename TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::value_type,
+	std::ptrdiff_t,
+	const typename TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::value_type*,
+	const typename TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::value_type&>
+{
+public:
+	const_iterator() : mTree(NULL), mDepth(0) {}
+	const_iterator(const const_iterator& other) : mTree(other.mTree), mDepth(other.mDepth) { copyPath(other); }
+	const_iterator& operator=(const const_iterator& other) { mTree = other.mTree; mDepth = other.mDepth; copyPath(other); return *this; }
+	const value_type& operator*() const
+	{
+		if (!mTree || mDepth == 0)
+			throw std::runtime_error(std::string("Cannot be dereferenced"));
+		return mPath[mDepth - 1]->Value;
+	}
+	const value_type* operator->() const
+	{
+		if (!mTree || mDepth == 0)
+			throw std::runtime_error(std::string("Cannot be referenced"));
+		return &mPath[mDepth - 1]->Value;
+	}
+	const_iterator& operator++() { increment(); return *this; }
+	const_iterator operator++(int) { const_iterator retIt = *this; increment(); return retIt; }
+	const_iterator& operator--() { decrement(); return *this; }
+	const_iterator operator--(int) { const_iterator retIt = *this; decrement(); return retIt; }
+	bool operator==(const const_iterator& right) const
+	{
+		return mTree == right.mTree && mDepth == right.mDepth && (mDepth == 0 || mPath[mDepth - 1] == right.mPath[mDepth - 1]);
+	}
+	bool operator!=(const const_iterator& right) const { return !(*this == right); }
+protected:
+	const TopDownRedBlackTree* mTree;
+	/// entries above mDepth are not initialized and are not copied
+	TopDownNode* mPath[MaxHeight];
+	size_t mDepth;
+	friend TopDownRedBlackTree;
+	explicit const_iterator(const TopDownRedBlackTree* tree) : mTree(tree), mDepth(0) {}
+	void copyPath(const const_iterator& other) { std::copy(other.mPath, other.mPath + other.mDepth, mPath); }
+	/// push node and its descendants in direction down to the last one
+	void descend(TopDownNode* node, int direction);
+	void increment();
+	void decrement();
+};
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+class TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::iterator : public TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator
+{
+public:
+	typedef value_type* pointer;
+	typedef value_type& reference;
+	iterator() {}
+	value_type& operator*() const { return const_cast<value_type&>(const_iterator::operator*()); }
+	value_type* operator->() const { return const_cast<value_type*>(const_iterator::operator->()); }
+	iterator& operator++() { this->increment(); return *this; }
+	iterator operator++(int) { iterator retIt = *this; this->increment(); return retIt; }
+	iterator& operator--() { this->decrement(); return *this; }
+	iterator operator--(int) { iterator retIt = *this; this->decrement(); return retIt; }
+private:
+	friend TopDownRedBlackTree;
+	explicit iterator(const TopDownRedBlackTree* tree) : const_iterator(tree) {}
+};
+
+//ITERATOR METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator::descend(TopDownNode* node, int direction)
+{
+	for (; node != NULL; node = node->Link[direction])
+		mPath[mDepth++] = node;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator::increment()
+{
+	if (!mTree || mDepth == 0)
+		throw std::out_of_range("Iterator cannot be increment.");
+	TopDownNode* node = mPath[mDepth - 1];
+	if (node->Link[1] != NULL)
+	{
+		descend(node->Link[1], 0);
+		return;
+	}
+	//climb over ancestors whose right subtree is done, the next one is the first entered from the left
+	while (mDepth > 1 && mPath[mDepth - 2]->Link[1] == mPath[mDepth - 1])
+		mDepth--;
+	mDepth--;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::const_iterator::decrement()
+{
+	if (!mTree || (mDepth == 0 && mTree->mRoot == NULL))
+		throw std::out_of_range("Iterator cannot be decrement.");
+	if (mDepth == 0)
+	{
+		descend(mTree->mRoot, 1);
+		return;
+	}
+	TopDownNode* node = mPath[mDepth - 1];
+	if (node->Link[0] != NULL)
+	{
+		descend(node->Link[0], 1);
+		return;
+	}
+	size_t depth = mDepth;
+	while (depth > 1 && mPath[depth - 2]->Link[0] == mPath[depth - 1])
+		depth--;
+	if (depth == 1)
+		throw std::out_of_range("Iterator cannot be decrement.");
+	mDepth = depth - 1;
+}
+
+//PRIVATE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::TopDownNode* TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::rotate(TopDownNode* node, int direction)
+{
+	TopDownNode* top = node->Link[!direction];
+	node->Link[!direction] = top->Link[direction];
+	top->Link[direction] = node;
+	node->IsRed = true;
+	top->IsRed = false;
+	return top;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::TopDownNode* TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::rotateTwice(TopDownNode* node, int direction)
+{
+	node->Link[!direction] = rotate(node->Link[!direction], !direction);
+	return rotate(node, direction);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename... ARGS>
+typename TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::TopDownNode* TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::createNode(ARGS&&... args)
+{
+	TopDownNode* node = node_allocator_traits::allocate(mAllocator, 1);
+	node_allocator_traits::construct(mAllocator, node);
+	try
+	{
+		node_allocator_traits::construct(mAllocator, &node->Value, std::forward<ARGS>(args)...);
+	}
+	catch (...)
+	{
+		node_allocator_traits::destroy(mAllocator, node);
+		node_allocator_traits::deallocate(mAllocator, node, 1);
+		throw;
+	}
+	return node;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::destroyNode(TopDownNode* node)
+{
+	node_allocator_traits::destroy(mAllocator, &node->Value);
+	node_allocator_traits::destroy(mAllocator, node);
+	node_allocator_traits::deallocate(mAllocator, node, 1);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::destroySubtree(TopDownNode* node)
+{
+	if (node == NULL)
+		return;
+	destroySubtree(node->Link[0]);
+	destroySubtree(node->Link[1]);
+	destroyNode(node);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::TopDownNode* TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::copySubtree(const TopDownNode* node)
+{
+	if (node == NULL)
+		return NULL;
+	TopDownNode* copy = createNode(node->Value);
+	copy->IsRed = node->IsRed;
+	try
+	{
+		copy->Link[0] = copySubtree(node->Link[0]);
+		copy->Link[1] = copySubtree(node->Link[1]);
+	}
+	catch (...)
+	{
+		destroySubtree(copy);
+		throw;
+	}
+	return copy;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::replaceChild(TopDownNode* parent, TopDownNode* child, TopDownNode* replacement)
+{
+	if (parent == NULL)
+		mRoot = replacement;
+	else
+		parent->Link[parent->Link[1] == child] = replacement;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::restoreRedParent(TopDownNode** path, size_t& depth)
+{
+	//root is black, so a red parent has a black parent of its own
+	size_t topDepth = depth - 2;
+	TopDownNode* node = path[depth];
+	TopDownNode* parent = path[depth - 1];
+	TopDownNode* grandparent = path[topDepth];
+	int side = grandparent->Link[1] == parent;
+	TopDownNode* top;
+	if (parent->Link[side] == node)
+	{
+		top = rotate(grandparent, !side);
+		path[topDepth] = parent;
+		path[topDepth + 1] = node;
+		depth = topDepth + 1;
+	}
+	else
+	{
+		top = rotateTwice(grandparent, !side);
+		path[topDepth] = node;
+		depth = topDepth;
+	}
+	replaceChild(topDepth != 0 ? path[topDepth - 1] : NULL, grandparent, top);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::findPath(const key_type& key, const_iterator& position) const
+{
+	boundPath<false>(key, position);
+	if (position.mDepth != 0 && mCompare(key, position.mPath[position.mDepth - 1]->Value.first))
+		position.mDepth = 0;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<bool IS_UPPER>
+void TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::boundPath(const key_type& key, const_iterator& position) const
+{
+	//bound is the last node left on the way down, the path to it is a prefix of the search path
+	size_t depth = 0;
+	size_t boundDepth = 0;
+	for (TopDownNode* node = mRoot; node != NULL; depth++)
+	{
+		position.mPath[depth] = node;
+		bool isRight = IS_UPPER ? !mCompare(key, node->Value.first) : mCompare(node->Value.first, key);
+		if (!isRight)
+			boundDepth = depth + 1;
+		node = node->Link[isRight];
+	}
+	position.mDepth = boundDepth;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::pathTo(const TopDownNode* target, const_iterator& position) const
+{
+	position.mDepth = 0;
+	TopDownNode* node = mRoot;
+	for (; node != target; node = node->Link[mCompare(node->Value.first, target->Value.first)])
+		position.mPath[position.mDepth++] = node;
+	position.mPath[position.mDepth++] = node;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename K, typename... ARGS>
+std::pair<typename TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::iterator, bool> TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::tryEmplace(K&& searched, ARGS&&... args)
+{
+	iterator position(this);
+	TopDownNode** path = position.mPath;
+	if (mRoot == NULL)
+	{
+		mRoot = createNode(std::piecewise_construct,
+			std::forward_as_tuple(std::forward<K>(searched)), std::forward_as_tuple(std::forward<ARGS>(args)...));
+		mRoot->IsRed = false;
+		mCount++;
+		position.descend(mRoot, 0);
+		return std::make_pair(position, true);
+	}
+	size_t depth = 0;
+	path[0] = mRoot;
+	for (;;)
+	{
+		TopDownNode* node = path[depth];
+		//split node with two red children, so the new leaf never gets a red sibling to recolor upwards
+		if (isRed(node->Link[0]) && isRed(node->Link[1]))
+		{
+			node->IsRed = depth != 0;
+			node->Link[0]->IsRed = false;
+			node->Link[1]->IsRed = false;
+			if (node->IsRed && path[depth - 1]->IsRed)
+				restoreRedParent(path, depth);
+		}
+		bool isRight = mCompare(node->Value.first, searched);
+		if (!isRight && !mCompare(searched, node->Value.first))
+		{
+			position.mDepth = depth + 1;
+			return std::make_pair(position, false);
+		}
+		TopDownNode* child = node->Link[isRight];
+		if (child == NULL)
+		{
+			child = createNode(std::piecewise_construct,
+				std::forward_as_tuple(std::forward<K>(searched)), std::forward_as_tuple(std::forward<ARGS>(args)...));
+			node->Link[isRight] = child;
+			path[++depth] = child;
+			if (node->IsRed)
+				restoreRedParent(path, depth);
+			mCount++;
+			position.mDepth = depth + 1;
+			return std::make_pair(position, true);
+		}
+		path[++depth] = child;
+	}
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+int TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::checkSubtree(const TopDownNode* node, size_t& count) const
+{
+	if (node == NULL)
+		return 1;
+	if (node->IsRed && (isRed(node->Link[0]) || isRed(node->Link[1])))
+		return -1;
+	if (node->Link[0] != NULL && !mCompare(node->Link[0]->Value.first, node->Value.first))
+		return -1;
+	if (node->Link[1] != NULL && !mCompare(node->Value.first, node->Link[1]->Value.first))
+		return -1;
+	count++;
+	int leftHeight = checkSubtree(node->Link[0], count);
+	int rightHeight = checkSubtree(node->Link[1], count);
+	if (leftHeight < 0 || leftHeight != rightHeight)
+		return -1;
+	return leftHeight + (node->IsRed ? 0 : 1);
+}
+
+//TOP DOWN RED BLACK TREE METHODS
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::TopDownRedBlackTree()
+	: mAllocator(allocator_type()), mCompare(), mCount(0), mRoot(NULL)
+{
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::TopDownRedBlackTree(const key_compare& compare, const allocator_type& allocator)
+	: mAllocator(allocator), mCompare(compare), mCount(0), mRoot(NULL)
+{
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::TopDownRedBlackTree(const TopDownRedBlackTree& other)
+	: mAllocator(node_allocator_traits::select_on_container_copy_construction(other.mAllocator)), mCompare(other.mCompare),
+	mCount(other.mCount), mRoot(NULL)
+{
+	//shape and colors are copied, so the copy needs no rebalancing
+	mRoot = copySubtree(other.mRoot);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>& TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::operator=(const TopDownRedBlackTree& other)
+{
+	if (this != &other)
+	{
+		TopDownRedBlackTree copy(other);
+		swap(copy);
+	}
+	return *this;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::~TopDownRedBlackTree()
+{
+	destroySubtree(mRoot);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::swap(TopDownRedBlackTree& other)
+{
+	std::swap(mAllocator, other.mAllocator);
+	std::swap(mCompare, other.mCompare);
+	std::swap(mCount, other.mCount);
+	std::swap(mRoot, other.mRoot);
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+template<typename M>
+std::pair<typename TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::iterator, bool> TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::insert_or_assign(const key_type& searched, M&& data)
+{
+	//data is not consumed when the key is present
+	std::pair<iterator, bool> result = tryEmplace(searched, std::forward<M>(data));
+	if (!result.second)
+		result.first->second = std::forward<M>(data);
+	return result;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+size_t TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::remove(const key_type& searched)
+{
+	if (mRoot == NULL)
+		return 0;
+	//head holds the root as its right child, so the root has a parent to rotate under
+	TopDownNode head;
+	head.Link[1] = mRoot;
+	TopDownNode* grandparent = NULL;
+	TopDownNode* parent = NULL;
+	TopDownNode* node = &head;
+	TopDownNode* found = NULL;
+	TopDownNode* foundParent = NULL;
+	int direction = 1;
+	while (node->Link[direction] != NULL)
+	{
+		int last = direction;
+		grandparent = parent;
+		parent = node;
+		node = node->Link[direction];
+		direction = mCompare(node->Value.first, searched);
+		if (found == NULL && !direction && !mCompare(searched, node->Value.first))
+		{
+			found = node;
+			foundParent = parent;
+		}
+		//make node or its child on the way red, so the removed leaf is red when the search ends
+		if (isRed(node) || isRed(node->Link[direction]))
+			continue;
+		if (isRed(node->Link[!direction]))
+		{
+			parent->Link[last] = rotate(node, direction);
+			parent = parent->Link[last];
+			if (found == node)
+				foundParent = parent;
+			continue;
+		}
+		TopDownNode* sibling = parent->Link[!last];
+		if (sibling == NULL)
+			continue;
+		if (!isRed(sibling->Link[0]) && !isRed(sibling->Link[1]))
+		{
+			parent->IsRed = false;
+			sibling->IsRed = true;
+			node->IsRed = true;
+		}
+		else
+		{
+			int side = grandparent->Link[1] == parent;
+			TopDownNode* top = isRed(sibling->Link[last]) ? rotateTwice(parent, last) : rotate(parent, last);
+			grandparent->Link[side] = top;
+			node->IsRed = true;
+			top->IsRed = true;
+			top->Link[0]->IsRed = false;
+			top->Link[1]->IsRed = false;
+			if (found == parent)
+				foundParent = top;
+		}
+	}
+	if (found != NULL)
+	{
+		//node is found one or its predecessor, it has one child at most; it takes the place of found one
+		parent->Link[parent->Link[1] == node] = node->Link[node->Link[0] == NULL];
+		if (found != node)
+		{
+			node->Link[0] = found->Link[0];
+			node->Link[1] = found->Link[1];
+			node->IsRed = found->IsRed;
+			foundParent->Link[foundParent->Link[1] == found] = node;
+		}
+		destroyNode(found);
+		mCount--;
+	}
+	mRoot = head.Link[1];
+	if (mRoot != NULL)
+		mRoot->IsRed = false;
+	return found != NULL ? 1 : 0;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+typename TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::iterator TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::erase(const_iterator position)
+{
+	if (position.mTree != this || position.mDepth == 0)
+		throw std::out_of_range("Iterator cannot be erased.");
+	//removal rotates the path, so the next item is found again by its key
+	const_iterator next = position;
+	++next;
+	remove(position->first);
+	iterator nextPosition(this);
+	if (next.mDepth != 0)
+		pathTo(next.mPath[next.mDepth - 1], nextPosition);
+	return nextPosition;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+void TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::clear()
+{
+	destroySubtree(mRoot);
+	mRoot = NULL;
+	mCount = 0;
+}
+
+template<typename KEY_TYPE, typename MAPPED_TYPE, typename COMPARE, typename ALLOCATOR>
+bool TopDownRedBlackTree<KEY_TYPE, MAPPED_TYPE, COMPARE, ALLOCATOR>::isValid() const
+{
+	if (isRed(mRoot))
+		return false;
+	size_t count = 0;
+	return checkSubtree(mRoot, count) >= 0 && count == mCount;
+}
+#endif // !TOP_DOWN_RED_BLACK_TREE_H